@@ -0,0 +1,29 @@
+#pragma once
+//  Pierce Kyaw, Aye Thwe Tun
+//
+//  Read only view of an array that is owned somewhere else: a vector, or a
+//  file mapped into memory (see TerrainPack).  Copying a view does not copy
+//  the data.
+//
+
+#include <stddef.h>
+#include <vector>
+
+template <class T>
+class ArrayView {
+public:
+	ArrayView() { }
+	ArrayView(const T* data, size_t size) : ptr(data), count(size) { }
+	ArrayView(const std::vector<T>& v) : ptr(v.data()), count(v.size()) { }
+
+	const T& operator[](size_t i) const { return ptr[i]; }
+	const T* data() const { return ptr; }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	const T* begin() const { return ptr; }
+	const T* end() const { return ptr + count; }
+
+private:
+	const T* ptr = nullptr;
+	size_t count = 0;
+};
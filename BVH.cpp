@@ -0,0 +1,363 @@
+//  Pierce Kyaw, Aye Thwe Tun
+//
+//  Bounding volume hierarchy built with binned SAH.  See BVH.h.
+//
+
+#include "BVH.h"
+#include <cfloat>
+
+// definitions of the constants std::min takes by reference
+//
+const int BVH::MaxDepth;
+const int BVH::MaxBins;
+
+static float surfaceArea(const glm::vec3& min, const glm::vec3& max) {
+	glm::vec3 d = max - min;
+	return 2 * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+//  Faces binned by center during the SAH split:  their bounds and count.
+//
+class Bin {
+public:
+	glm::vec3 min = glm::vec3(FLT_MAX);
+	glm::vec3 max = glm::vec3(-FLT_MAX);
+	int count = 0;
+};
+
+// bounds of the faces indices[begin] to indices[end - 1]
+//
+Box BVH::faceBounds(int begin, int end) const {
+	glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+	for (int i = begin; i < end; i++) {
+		glm::vec3 v[3];
+		getFace(indices[i], v);
+		min = glm::min(min, glm::min(v[0], glm::min(v[1], v[2])));
+		max = glm::max(max, glm::max(v[0], glm::max(v[1], v[2])));
+	}
+	return Box(Vector3(min.x, min.y, min.z), Vector3(max.x, max.y, max.z));
+}
+
+void BVH::create(const ofMesh& geo) {
+	colors = std::vector<ofColor>{ ofColor::red, ofColor::green, ofColor::blue, ofColor::yellow, ofColor::cyan, ofColor::magenta };
+
+	mesh = geo;
+	vertices = ArrayView<glm::vec3>(mesh.getVertices());
+	meshIndices = ArrayView<ofIndexType>(mesh.getIndices());
+	invalidateLines();
+
+	uint64_t start = ofGetElapsedTimeMicros();
+	int count = getNumFaces();
+	vector<glm::vec3> centers(count);
+	indices.resize(count);
+	for (int i = 0; i < count; i++) {
+		glm::vec3 v[3];
+		getFace(i, v);
+		centers[i] = (v[0] + v[1] + v[2]) / 3.0f;
+		indices[i] = i;
+	}
+
+	nodes.clear();
+	nodes.reserve(2 * count / std::max(settings.minFacesToSplit, 1) + 1);
+	nodes.push_back(BVHNode());
+	nodes[0].begin = 0;
+	nodes[0].end = count;
+	nodes[0].box = faceBounds(0, count);
+	if (count > 0) subdivide(centers, 0, 0);
+	buildMillis = (ofGetElapsedTimeMicros() - start) / 1000.0f;
+}
+
+//  Split a node in two with binned SAH.  The faces are put in numBins bins
+//  by their center along each axis; sweeping the bins from both ends gives
+//  the bounds and face count on either side of every bin boundary, so all
+//  candidate planes of an axis are scored in two passes over the bins.
+//
+void BVH::subdivide(const vector<glm::vec3>& centers, int node, int depth) {
+	int begin = nodes[node].begin;
+	int end = nodes[node].end;
+	int count = end - begin;
+	if (count < settings.minFacesToSplit || depth >= MaxDepth - 1) return;
+
+	glm::vec3 cmin(FLT_MAX), cmax(-FLT_MAX);
+	for (int i = begin; i < end; i++) {
+		cmin = glm::min(cmin, centers[indices[i]]);
+		cmax = glm::max(cmax, centers[indices[i]]);
+	}
+
+	int numBins = std::max(2, std::min(settings.numBins, MaxBins));
+	const Box& box = nodes[node].box;
+	float area = surfaceArea(glm::vec3(box.min().x(), box.min().y(), box.min().z()),
+		glm::vec3(box.max().x(), box.max().y(), box.max().z()));
+
+	float bestCost = FLT_MAX;
+	int bestAxis = -1, bestSplit = 0;
+	for (int axis = 0; axis < 3; axis++) {
+		float extent = cmax[axis] - cmin[axis];
+		if (extent <= 0) continue;
+
+		Bin bins[MaxBins];
+		float scale = numBins / extent;
+		for (int i = begin; i < end; i++) {
+			int f = indices[i];
+			int b = std::min(numBins - 1, (int)((centers[f][axis] - cmin[axis]) * scale));
+			glm::vec3 v[3];
+			getFace(f, v);
+			bins[b].min = glm::min(bins[b].min, glm::min(v[0], glm::min(v[1], v[2])));
+			bins[b].max = glm::max(bins[b].max, glm::max(v[0], glm::max(v[1], v[2])));
+			bins[b].count++;
+		}
+
+		// rightCost[s] is area * count of bins s .. numBins - 1
+		//
+		float rightCost[MaxBins];
+		Bin right;
+		for (int s = numBins - 1; s > 0; s--) {
+			right.min = glm::min(right.min, bins[s].min);
+			right.max = glm::max(right.max, bins[s].max);
+			right.count += bins[s].count;
+			rightCost[s] = right.count ? surfaceArea(right.min, right.max) * right.count : 0;
+		}
+		Bin left;
+		for (int s = 1; s < numBins; s++) {
+			left.min = glm::min(left.min, bins[s - 1].min);
+			left.max = glm::max(left.max, bins[s - 1].max);
+			left.count += bins[s - 1].count;
+			if (left.count == 0 || left.count == count) continue;
+			float cost = surfaceArea(left.min, left.max) * left.count + rightCost[s];
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = s;
+			}
+		}
+	}
+
+	// every face has the same center:  no plane separates them
+	//
+	if (bestAxis < 0) return;
+
+	float splitCost = settings.traversalCost +
+		(area > 0 ? bestCost / area : count) * settings.intersectCost;
+	if (splitCost >= settings.intersectCost * count && count <= settings.maxFacesPerLeaf) return;
+
+	float extent = cmax[bestAxis] - cmin[bestAxis];
+	float scale = numBins / extent;
+	int* mid = std::partition(indices.data() + begin, indices.data() + end, [&](int f) {
+		return std::min(numBins - 1, (int)((centers[f][bestAxis] - cmin[bestAxis]) * scale)) < bestSplit;
+	});
+	int split = mid - indices.data();
+
+	int first = nodes.size();
+	nodes[node].firstChild = first;
+	nodes.push_back(BVHNode());
+	nodes.push_back(BVHNode());
+	nodes[first].begin = begin;
+	nodes[first].end = split;
+	nodes[first].box = faceBounds(begin, split);
+	nodes[first + 1].begin = split;
+	nodes[first + 1].end = end;
+	nodes[first + 1].box = faceBounds(split, end);
+
+	subdivide(centers, first, depth + 1);
+	subdivide(centers, first + 1, depth + 1);
+}
+
+//  Nearest-hit ray query.  Front to back with an explicit stack:  of the two
+//  children the nearer one is visited first, and a node the ray enters
+//  beyond the nearest hit so far is skipped.
+//
+bool BVH::intersect(const Ray& ray, RayHit& hitRtn) const {
+	if (nodes.empty()) return false;
+
+	QueryCounters count;        // kept in locals, added to counters at the end
+	count.queries++;
+	count.boxesTested++;
+
+	float tEnter;
+	bool found = false;
+	if (nodes[0].box.intersect(ray, 0, INFINITE, tEnter)) {
+		int stack[MaxDepth * 2];
+		float stackT[MaxDepth * 2];
+		int top = 0;
+		stack[top] = 0;
+		stackT[top++] = tEnter;
+		float tNearest = INFINITE;
+
+		while (top > 0) {
+			top--;
+			if (stackT[top] > tNearest) continue;
+
+			int node = stack[top];
+			const BVHNode& n = nodes[node];
+			count.nodesVisited++;
+			if (n.isLeaf()) {
+				count.leavesReached++;
+				count.primitivesTested += n.numPoints();
+				for (int i = n.begin; i < n.end; i++) {
+					glm::vec3 v[3];
+					float t;
+					getFace(indices[i], v);
+					if (rayIntersectTriangle(ray, v, t) && t < tNearest) {
+						tNearest = t;
+						hitRtn.t = t;
+						hitRtn.leaf = node;
+						hitRtn.index = indices[i];
+						found = true;
+					}
+				}
+				continue;
+			}
+
+			// push the farther child first so the nearer one is visited next
+			//
+			int a = n.firstChild, b = n.firstChild + 1;
+			float tA, tB;
+			bool hitA = nodes[a].box.intersect(ray, 0, tNearest, tA);
+			bool hitB = nodes[b].box.intersect(ray, 0, tNearest, tB);
+			count.boxesTested += 2;
+			if (hitA && hitB && tB > tA) {
+				std::swap(a, b);
+				std::swap(tA, tB);
+			}
+			if (hitA) {
+				stack[top] = a;
+				stackT[top++] = tA;
+			}
+			if (hitB) {
+				stack[top] = b;
+				stackT[top++] = tB;
+			}
+		}
+	}
+
+	if (bCountQueries) counters.add(count);
+	if (found) {
+		Vector3 p = ray.origin + ray.direction * hitRtn.t;
+		hitRtn.point = glm::vec3(p.x(), p.y(), p.z());
+	}
+	return found;
+}
+
+bool BVH::overlap(const Box& box) const {
+	if (nodes.empty()) return false;
+
+	int stack[MaxDepth * 2];
+	int top = 0;
+	stack[top++] = 0;
+	bool found = false;
+	QueryCounters count;
+	count.queries++;
+	while (top > 0) {
+		const BVHNode& n = nodes[stack[--top]];
+		count.nodesVisited++;
+		count.boxesTested++;
+		if (!n.box.overlap(box)) continue;
+		if (n.isLeaf()) {
+			count.leavesReached++;
+			found = true;
+			break;
+		}
+		stack[top++] = n.firstChild;
+		stack[top++] = n.firstChild + 1;
+	}
+	if (bCountQueries) counters.add(count);
+	return found;
+}
+
+bool BVH::intersect(const Box& box, vector<Box>& boxListRtn) const {
+	if (nodes.empty()) return false;
+
+	int stack[MaxDepth * 2];
+	int top = 0;
+	stack[top++] = 0;
+	bool found = false;
+	QueryCounters count;
+	count.queries++;
+	while (top > 0) {
+		const BVHNode& n = nodes[stack[--top]];
+		count.nodesVisited++;
+		count.boxesTested++;
+		if (!n.box.overlap(box)) continue;
+		if (n.isLeaf()) {
+			count.leavesReached++;
+			boxListRtn.push_back(n.box);
+			found = true;
+			continue;
+		}
+		stack[top++] = n.firstChild;
+		stack[top++] = n.firstChild + 1;
+	}
+	if (bCountQueries) counters.add(count);
+	return found;
+}
+
+int BVH::getIndicesInBox(const Box& box, vector<int>& indicesRtn) const {
+	indicesRtn.clear();
+	if (nodes.empty()) return 0;
+
+	Vector3 min = box.min(), max = box.max();
+	int stack[MaxDepth * 2];
+	int top = 0;
+	stack[top++] = 0;
+	QueryCounters count;
+	count.queries++;
+	while (top > 0) {
+		const BVHNode& n = nodes[stack[--top]];
+		count.nodesVisited++;
+		count.boxesTested++;
+		if (!n.box.overlap(box)) continue;
+		if (!n.isLeaf()) {
+			stack[top++] = n.firstChild;
+			stack[top++] = n.firstChild + 1;
+			continue;
+		}
+		count.leavesReached++;
+		count.primitivesTested += n.numPoints();
+		for (int i = n.begin; i < n.end; i++) {
+			glm::vec3 v[3];
+			getFace(indices[i], v);
+			glm::vec3 lo = glm::min(v[0], glm::min(v[1], v[2]));
+			glm::vec3 hi = glm::max(v[0], glm::max(v[1], v[2]));
+			if (hi.x >= min.x() && lo.x <= max.x() && hi.y >= min.y() && lo.y <= max.y() &&
+				hi.z >= min.z() && lo.z <= max.z()) {
+				indicesRtn.push_back(indices[i]);
+			}
+		}
+	}
+	if (bCountQueries) counters.add(count);
+	return indicesRtn.size();
+}
+
+IndexStats BVH::getStats() const {
+	IndexStats stats;
+	stats.nodeBytes = nodes.size() * sizeof(BVHNode);
+	stats.indexBytes = indices.size() * sizeof(int);
+	stats.meshBytes = vertices.size() * sizeof(glm::vec3) + meshIndices.size() * sizeof(ofIndexType);
+	stats.buildMillis = buildMillis;
+
+	vector<int> depth;
+	nodeDepths(nodes.size(), [this](int i) { return std::make_pair(nodes[i].firstChild, nodes[i].isLeaf() ? 0 : 2); }, depth);
+	for (int i = 0; i < nodes.size(); i++) {
+		stats.addNode(depth[i], nodes[i].isLeaf(), nodes[i].numPoints());
+	}
+	stats.finish();
+	return stats;
+}
+
+void BVH::getNodeLines(int node, int numLevels, int level, ofMesh& linesRtn) const {
+	if (level >= numLevels) return;
+
+	const BVHNode& n = nodes[node];
+	addBoxLines(n.box, colors[level % colors.size()], linesRtn);
+	if (n.isLeaf()) return;
+	getNodeLines(n.firstChild, numLevels, level + 1, linesRtn);
+	getNodeLines(n.firstChild + 1, numLevels, level + 1, linesRtn);
+}
+
+void BVH::getLeafLines(ofMesh& linesRtn) const {
+	vector<int> depth;
+	nodeDepths(nodes.size(), [this](int i) { return std::make_pair(nodes[i].firstChild, nodes[i].isLeaf() ? 0 : 2); }, depth);
+	for (int i = 0; i < nodes.size(); i++) {
+		if (nodes[i].isLeaf()) addBoxLines(nodes[i].box, colors[depth[i] % colors.size()], linesRtn);
+	}
+}
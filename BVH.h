@@ -0,0 +1,89 @@
+#pragma once
+//  Pierce Kyaw, Aye Thwe Tun
+//
+//  Bounding volume hierarchy over the triangles of the terrain mesh.  Each
+//  node is split in two along the plane the surface area heuristic (SAH)
+//  says is cheapest for rays, so large flat areas end up in a few large
+//  leaves instead of many equal size octants.
+//
+
+#include "SpatialIndex.h"
+
+//  BVH nodes are stored in one contiguous array (BVH::nodes).  The two
+//  children of an inner node are nodes[firstChild] and nodes[firstChild + 1];
+//  children are always stored after their parent.  The faces in a node are
+//  BVH::indices[begin] to BVH::indices[end - 1].
+//
+class BVHNode {
+public:
+	Box box;
+	int begin = 0;
+	int end = 0;
+	int firstChild = -1;
+
+	bool isLeaf() const { return firstChild < 0; }
+	int numPoints() const { return end - begin; }
+};
+
+//  When BVH::create stops splitting a node.  Candidate split planes are the
+//  bin boundaries of numBins equal bins along each axis of the face centers.
+//  The expected cost of a ray that reaches the node is
+//
+//     as a leaf:   intersectCost * n
+//     split:       traversalCost + sum over the 2 children of
+//                  area(child) / area(node) * intersectCost * n(child)
+//
+//  A node is split at the cheapest plane if that is cheaper than a leaf,
+//  and always if it holds more than maxFacesPerLeaf faces.
+//
+class BVHSettings {
+public:
+	int minFacesToSplit = 2;    // nodes with fewer faces are always leaves
+	int maxFacesPerLeaf = 16;
+	int numBins = 16;           // up to BVH::MaxBins
+	float traversalCost = 1;    // cost of visiting a node (testing its 2
+	float intersectCost = 1;    // children), relative to testing one face
+};
+
+class BVH : public SpatialIndex {
+public:
+
+	// the build stops splitting at MaxDepth levels, so the traversal stacks
+	// (two nodes per level) can be MaxDepth * 2 entries.  MaxBins caps
+	// settings.numBins.
+	//
+	static const int MaxDepth = 64;
+	static const int MaxBins = 32;
+
+	BVH() { }
+	BVH(const BVH&) = delete;               // the views would point into the
+	BVH& operator=(const BVH&) = delete;    // copied BVH's mesh
+
+	void create(const ofMesh& mesh) override;
+	void subdivide(const vector<glm::vec3>& centers, int node, int depth);
+	Box faceBounds(int begin, int end) const;
+
+	bool intersect(const Ray& ray, RayHit& hitRtn) const override;
+	bool intersect(const Box& box, vector<Box>& boxListRtn) const override;
+	bool overlap(const Box& box) const override;
+	int getIndicesInBox(const Box& box, vector<int>& indicesRtn) const override;
+	using SpatialIndex::intersect;
+
+	IndexStats getStats() const override;
+	Box bounds() const override { return nodes.empty() ? Box() : nodes[0].box; }
+	const char* name() const override { return "bvh"; }
+
+	void getNodeLines(int node, int numLevels, int level, ofMesh& linesRtn) const;
+	void getNodeLines(int numLevels, int level, ofMesh& linesRtn) const override {
+		if (!nodes.empty()) getNodeLines(0, numLevels, level, linesRtn);
+	}
+	void getLeafLines(ofMesh& linesRtn) const override;
+
+	const BVHNode& root() const { return nodes[0]; }
+
+	vector<BVHNode> nodes;      // nodes[0] is the root
+	vector<int> indices;        // face indices, grouped by node
+	ofMesh mesh;                // copy of the mesh given to create()
+
+	BVHSettings settings;
+};
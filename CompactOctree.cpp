@@ -0,0 +1,383 @@
+//  Pierce Kyaw, Aye Thwe Tun
+//
+//  Octree with quantized node boxes.  See CompactOctree.h.
+//
+
+#include "CompactOctree.h"
+
+CompactBounds CompactBounds::of(const Box& box) {
+	CompactBounds b;
+	for (int a = 0; a < 3; a++) {
+		b.min[a] = box.min()[a];
+		b.max[a] = box.max()[a];
+	}
+	return b;
+}
+
+//  Decodes the children of one node.  A min is counted up from the
+//  parent's min and a max down from the parent's max, so 0 and 255 decode
+//  to the parent's box exactly and a child that touches it is not cut
+//  short by rounding.  The steps are worked out once per parent.
+//
+class BoxDecoder {
+public:
+	CompactBounds parent;
+	float step[3];
+
+	BoxDecoder(const CompactBounds& parent) : parent(parent) {
+		for (int a = 0; a < 3; a++) step[a] = (parent.max[a] - parent.min[a]) / 255;
+	}
+	float lo(int a, int q) const { return parent.min[a] + q * step[a]; }
+	float hi(int a, int q) const { return parent.max[a] - (255 - q) * step[a]; }
+
+	CompactBounds decode(const CompactNode& node) const {
+		CompactBounds b;
+		for (int a = 0; a < 3; a++) {
+			b.min[a] = lo(a, node.lo[a]);
+			b.max[a] = hi(a, node.hi[a]);
+		}
+		return b;
+	}
+};
+
+Box CompactOctree::childBox(const Box& parent, const CompactNode& node) {
+	return BoxDecoder(CompactBounds::of(parent)).decode(node).toBox();
+}
+
+//  Round to the nearest step, then step outwards until the decoded value
+//  (computed exactly as childBox() does) is outside the box.
+//
+void CompactOctree::encodeBox(const Box& parent, const Box& box, CompactNode& nodeRtn) {
+	BoxDecoder d(CompactBounds::of(parent));
+	for (int a = 0; a < 3; a++) {
+		if (d.step[a] <= 0) {
+			nodeRtn.lo[a] = 0;
+			nodeRtn.hi[a] = 255;
+			continue;
+		}
+		float min = box.min()[a], max = box.max()[a];
+		int lo = std::max(0, std::min(255, (int)floorf((min - d.parent.min[a]) / d.step[a])));
+		while (lo > 0 && d.lo(a, lo) > min) lo--;
+		int hi = std::max(lo, std::min(255, (int)ceilf((max - d.parent.min[a]) / d.step[a])));
+		while (hi < 255 && d.hi(a, hi) < max) hi++;
+		nodeRtn.lo[a] = lo;
+		nodeRtn.hi[a] = hi;
+	}
+}
+
+void CompactOctree::create(const ofMesh& mesh) {
+	Octree octree;
+	octree.bUseFaces = true;
+	octree.settings = settings;
+	octree.create(mesh, levels);
+	create(octree);
+}
+
+bool CompactOctree::create(const Octree& octree) {
+	if (octree.nodes.empty() || !octree.bUseFaces) return false;
+
+	uint64_t start = ofGetElapsedTimeMicros();
+	colors = std::vector<ofColor>{ ofColor::red, ofColor::green, ofColor::blue, ofColor::yellow, ofColor::cyan, ofColor::magenta };
+	mesh.clear();
+	mesh.addVertices(octree.vertices.data(), octree.vertices.size());
+	mesh.addIndices(octree.meshIndices.data(), octree.meshIndices.size());
+	vertices = ArrayView<glm::vec3>(mesh.getVertices());
+	meshIndices = ArrayView<ofIndexType>(mesh.getIndices());
+	indices.assign(octree.indices.data(), octree.indices.data() + octree.indices.size());
+	levels = octree.levels;
+	settings = octree.settings;
+	invalidateLines();
+
+	// a child's box can stick out of its parent's by float rounding (in
+	// subDivideBox8()), so first grow every box to contain its children's.
+	// Children come after their parent:  backwards, they are done first.
+	//
+	int numNodes = octree.nodes.size();
+	vector<CompactBounds> nested(numNodes);
+	for (int i = numNodes - 1; i >= 0; i--) {
+		const TreeNode& n = octree.nodes[i];
+		CompactBounds& b = nested[i] = CompactBounds::of(n.box);
+		int numChildren = n.numChildren();
+		for (int k = 0; k < numChildren; k++) {
+			const CompactBounds& child = nested[n.firstChild + k];
+			for (int a = 0; a < 3; a++) {
+				b.min[a] = std::min(b.min[a], child.min[a]);
+				b.max[a] = std::max(b.max[a], child.max[a]);
+			}
+		}
+	}
+
+	// same nodes in the same order.  The parent's decoded box is known when
+	// a child is encoded.
+	//
+	nodes.assign(numNodes, CompactNode());
+	vector<Box> decoded(numNodes);
+	rootBox = decoded[0] = nested[0].toBox();
+	for (int i = 0; i < numNodes; i++) {
+		const TreeNode& n = octree.nodes[i];
+		CompactNode& c = nodes[i];
+		c.numChildren = n.numChildren();
+		c.first = n.isLeaf() ? n.begin : n.firstChild;
+		c.count = n.numPoints();
+		for (int k = 0; k < c.numChildren; k++) {
+			int child = n.firstChild + k;
+			encodeBox(decoded[i], nested[child].toBox(), nodes[child]);
+			decoded[child] = childBox(decoded[i], nodes[child]);
+		}
+	}
+	buildMillis = octree.buildMillis + (ofGetElapsedTimeMicros() - start) / 1000.0f;
+	return true;
+}
+
+IndexStats CompactOctree::getStats() const {
+	IndexStats stats;
+	stats.nodeBytes = nodes.size() * sizeof(CompactNode);
+	stats.indexBytes = indices.size() * sizeof(int);
+	stats.meshBytes = vertices.size() * sizeof(glm::vec3) + meshIndices.size() * sizeof(ofIndexType);
+	stats.buildMillis = buildMillis;
+
+	vector<int> depth;
+	nodeDepths(nodes.size(), [this](int i) { return std::make_pair(nodes[i].first, (int)nodes[i].numChildren); }, depth);
+	for (int i = 0; i < nodes.size(); i++) {
+		stats.addNode(depth[i], nodes[i].isLeaf(), nodes[i].count);
+	}
+	stats.finish();
+	return stats;
+}
+
+//  Nearest-hit ray query, front to back like Octree::intersect (face mode).
+//  Every stack entry carries its node's decoded box, so the boxes of a
+//  node's children are decoded from it when the node is visited.
+//
+bool CompactOctree::intersect(const Ray& ray, RayHit& hitRtn) const {
+	if (nodes.empty()) return false;
+
+	float tEnter;
+	QueryCounters count;
+	count.queries++;
+	count.boxesTested++;
+	if (!rootBox.intersect(ray, 0, INFINITE, tEnter)) {
+		if (bCountQueries) counters.add(count);
+		return false;
+	}
+
+	int stack[MaxLevels * 8];
+	float stackT[MaxLevels * 8];
+	CompactBounds stackBox[MaxLevels * 8];
+	int top = 0;
+	stack[top] = 0;
+	stackT[top] = tEnter;
+	stackBox[top++] = CompactBounds::of(rootBox);
+
+	float tNearest = INFINITE;
+	bool found = false;
+	while (top > 0) {
+		top--;
+		if (stackT[top] > tNearest) continue;
+
+		int node = stack[top];
+		const CompactNode& n = nodes[node];
+		count.nodesVisited++;
+		if (n.isLeaf()) {
+			count.leavesReached++;
+			count.primitivesTested += n.count;
+			for (int i = n.first; i < n.first + n.count; i++) {
+				glm::vec3 v[3];
+				float t;
+				getFace(indices[i], v);
+				if (rayIntersectTriangle(ray, v, t) && t < tNearest) {
+					tNearest = t;
+					hitRtn.t = t;
+					hitRtn.leaf = node;
+					hitRtn.index = indices[i];
+					found = true;
+				}
+			}
+			continue;
+		}
+
+		// decode the children and sort the ones the ray passes through by
+		// entry distance
+		//
+		BoxDecoder d(stackBox[top]);
+		CompactBounds boxes[8];
+		Box8 boxes8;
+		for (int i = 0; i < n.numChildren; i++) {
+			const CompactBounds& b = boxes[i] = d.decode(nodes[n.first + i]);
+			boxes8.set(i, Vector3(b.min[0], b.min[1], b.min[2]), Vector3(b.max[0], b.max[1], b.max[2]));
+		}
+		count.boxesTested += n.numChildren;
+		float tChildren[8], childT[8];
+		int child[8];
+		int numHit = 0;
+		unsigned int hits = slabTest8(ray, boxes8, n.numChildren, 0, tNearest, tChildren);
+		for (int i = 0; hits; i++, hits >>= 1) {
+			if (!(hits & 1)) continue;
+			int j = numHit++;
+			for (; j > 0 && childT[j - 1] > tChildren[i]; j--) {
+				child[j] = child[j - 1];
+				childT[j] = childT[j - 1];
+			}
+			child[j] = i;
+			childT[j] = tChildren[i];
+		}
+
+		// push farthest first so the nearest child is visited next
+		//
+		for (int i = numHit - 1; i >= 0; i--) {
+			stack[top] = n.first + child[i];
+			stackT[top] = childT[i];
+			stackBox[top++] = boxes[child[i]];
+		}
+	}
+
+	if (bCountQueries) counters.add(count);
+	if (found) {
+		Vector3 p = ray.origin + ray.direction * hitRtn.t;
+		hitRtn.point = glm::vec3(p.x(), p.y(), p.z());
+	}
+	return found;
+}
+
+//  Box queries test a node's children as they are decoded and push only
+//  the ones that overlap the box, with their decoded boxes.  Returns the
+//  new top of the stack.  nodeBox is a copy:  the node's own stack entry
+//  is overwritten by its first child.
+//
+int CompactOctree::pushOverlapping(const CompactNode& n, CompactBounds nodeBox, const Box& box,
+	int stack[], CompactBounds stackBox[], int top, QueryCounters& count) const {
+	BoxDecoder d(nodeBox);
+	count.boxesTested += n.numChildren;
+	for (int i = 0; i < n.numChildren; i++) {
+		CompactBounds b = d.decode(nodes[n.first + i]);
+		if (!b.overlap(box)) continue;
+		stack[top] = n.first + i;
+		stackBox[top++] = b;
+	}
+	return top;
+}
+
+bool CompactOctree::overlap(const Box& box) const {
+	if (nodes.empty()) return false;
+
+	int stack[MaxLevels * 8];
+	CompactBounds stackBox[MaxLevels * 8];
+	int top = 0;
+	stack[top] = 0;
+	stackBox[top] = CompactBounds::of(rootBox);
+	if (rootBox.overlap(box)) top++;
+	bool found = false;
+	QueryCounters count;
+	count.queries++;
+	count.boxesTested++;
+	while (top > 0) {
+		top--;
+		const CompactNode& n = nodes[stack[top]];
+		count.nodesVisited++;
+		if (n.isLeaf()) {
+			count.leavesReached++;
+			found = true;
+			break;
+		}
+		top = pushOverlapping(n, stackBox[top], box, stack, stackBox, top, count);
+	}
+	if (bCountQueries) counters.add(count);
+	return found;
+}
+
+// decoded boxes of the leaves that overlap the box
+//
+bool CompactOctree::intersect(const Box& box, vector<Box>& boxListRtn) const {
+	if (nodes.empty()) return false;
+
+	int stack[MaxLevels * 8];
+	CompactBounds stackBox[MaxLevels * 8];
+	int top = 0;
+	stack[top] = 0;
+	stackBox[top] = CompactBounds::of(rootBox);
+	if (rootBox.overlap(box)) top++;
+	bool found = false;
+	QueryCounters count;
+	count.queries++;
+	count.boxesTested++;
+	while (top > 0) {
+		top--;
+		const CompactNode& n = nodes[stack[top]];
+		count.nodesVisited++;
+		if (n.isLeaf()) {
+			count.leavesReached++;
+			boxListRtn.push_back(stackBox[top].toBox());
+			found = true;
+			continue;
+		}
+		top = pushOverlapping(n, stackBox[top], box, stack, stackBox, top, count);
+	}
+	if (bCountQueries) counters.add(count);
+	return found;
+}
+
+int CompactOctree::getIndicesInBox(const Box& box, vector<int>& indicesRtn) const {
+	indicesRtn.clear();
+	if (nodes.empty()) return 0;
+
+	Vector3 min = box.min(), max = box.max();
+	int stack[MaxLevels * 8];
+	CompactBounds stackBox[MaxLevels * 8];
+	int top = 0;
+	stack[top] = 0;
+	stackBox[top] = CompactBounds::of(rootBox);
+	if (rootBox.overlap(box)) top++;
+	QueryCounters count;
+	count.queries++;
+	count.boxesTested++;
+	while (top > 0) {
+		top--;
+		const CompactNode& n = nodes[stack[top]];
+		count.nodesVisited++;
+		if (!n.isLeaf()) {
+			top = pushOverlapping(n, stackBox[top], box, stack, stackBox, top, count);
+			continue;
+		}
+		count.leavesReached++;
+		count.primitivesTested += n.count;
+		for (int i = n.first; i < n.first + n.count; i++) {
+			glm::vec3 v[3];
+			getFace(indices[i], v);
+			glm::vec3 lo = glm::min(v[0], glm::min(v[1], v[2]));
+			glm::vec3 hi = glm::max(v[0], glm::max(v[1], v[2]));
+			if (hi.x >= min.x() && lo.x <= max.x() && hi.y >= min.y() && lo.y <= max.y() &&
+				hi.z >= min.z() && lo.z <= max.z()) {
+				indicesRtn.push_back(indices[i]);
+			}
+		}
+	}
+	if (bCountQueries) counters.add(count);
+	return indicesRtn.size();
+}
+
+void CompactOctree::getNodeLines(int node, const Box& box, int numLevels, int level, ofMesh& linesRtn) const {
+	if (level >= numLevels) return;
+
+	const CompactNode& n = nodes[node];
+	addBoxLines(box, colors[level % colors.size()], linesRtn);
+	for (int i = 0; i < n.numChildren; i++) {
+		getNodeLines(n.first + i, childBox(box, nodes[n.first + i]), numLevels, level + 1, linesRtn);
+	}
+}
+
+void CompactOctree::getLeafLines(ofMesh& linesRtn) const {
+	vector<Box> decoded(nodes.size());
+	vector<int> depth;
+	nodeDepths(nodes.size(), [this](int i) { return std::make_pair(nodes[i].first, (int)nodes[i].numChildren); }, depth);
+	if (!nodes.empty()) decoded[0] = rootBox;
+	for (int i = 0; i < nodes.size(); i++) {
+		const CompactNode& n = nodes[i];
+		if (n.isLeaf()) {
+			addBoxLines(decoded[i], colors[depth[i] % colors.size()], linesRtn);
+			continue;
+		}
+		for (int c = 0; c < n.numChildren; c++) {
+			decoded[n.first + c] = childBox(decoded[i], nodes[n.first + c]);
+		}
+	}
+}
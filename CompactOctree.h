@@ -0,0 +1,107 @@
+#pragma once
+//  Pierce Kyaw, Aye Thwe Tun
+//
+//  Octree with compact nodes, for large terrains.  A TreeNode keeps its
+//  box as two 16 byte aligned Vector3s (32 of its sizeof(TreeNode) = 48
+//  bytes), but a child's box always lies inside its parent's, so here each
+//  node stores its box as 8 bit offsets in 1/255ths of its parent's box.
+//  Boxes are decoded on the way down during traversal, starting from the
+//  root box, which is kept exactly.
+//
+//  Offsets are rounded outwards (min down, max up), so a decoded box always
+//  contains the node's true box:  queries may visit a few more nodes but
+//  never miss a hit.  Ray queries return the same hits as the octree the
+//  nodes were made from.  Box queries test the decoded leaf boxes, so they
+//  are conservative:  they report every overlap the octree does and a few
+//  more where a box passes just outside a leaf, and with box collisions
+//  (--box-collisions) the rocket can touch down slightly earlier.
+//
+//  The tree has the same nodes in the same order as the Octree it is made
+//  from (face mode only).
+//
+
+#include "ofMain.h"
+#include "Octree.h"
+
+//  16 bytes.  For an inner node "first" is the index of the first child in
+//  CompactOctree::nodes (children are stored next to each other, after
+//  their parent), for a leaf the first face in CompactOctree::indices.
+//  "count" is the number of faces in the node's subtree.
+//
+class CompactNode {
+public:
+	unsigned char lo[3] = { 0, 0, 0 };         // box, in 1/255ths of the
+	unsigned char hi[3] = { 255, 255, 255 };   // parent's box
+	unsigned char numChildren = 0;
+	unsigned char unused = 0;
+	int first = 0;
+	int count = 0;
+
+	bool isLeaf() const { return numChildren == 0; }
+};
+
+//  A decoded node box.  Plain floats with no constructor, so the traversal
+//  stacks of them cost nothing to set up.
+//
+class CompactBounds {
+public:
+	float min[3], max[3];
+
+	static CompactBounds of(const Box& box);
+	Box toBox() const { return Box(Vector3(min[0], min[1], min[2]), Vector3(max[0], max[1], max[2])); }
+	bool overlap(const Box& box) const {
+		return min[0] <= box.max().x() && max[0] >= box.min().x() &&
+			min[1] <= box.max().y() && max[1] >= box.min().y() &&
+			min[2] <= box.max().z() && max[2] >= box.min().z();
+	}
+};
+
+class CompactOctree : public SpatialIndex {
+public:
+
+	static const int MaxLevels = Octree::MaxLevels;
+
+	CompactOctree() { }
+	CompactOctree(const CompactOctree&) = delete;               // the views would point into
+	CompactOctree& operator=(const CompactOctree&) = delete;    // the copied mesh
+
+	// build an octree in face mode with "levels" and "settings" and compress it
+	//
+	void create(const ofMesh& mesh) override;
+
+	// compress a built octree (copies its mesh and indices, so the octree can
+	// be freed).  False if it is empty or not in face mode.
+	//
+	bool create(const Octree& octree);
+
+	// decode / encode a node's box inside its parent's decoded box
+	//
+	static Box childBox(const Box& parent, const CompactNode& node);
+	static void encodeBox(const Box& parent, const Box& box, CompactNode& nodeRtn);
+
+	bool intersect(const Ray& ray, RayHit& hitRtn) const override;
+	bool intersect(const Box& box, vector<Box>& boxListRtn) const override;
+	bool overlap(const Box& box) const override;
+	int getIndicesInBox(const Box& box, vector<int>& indicesRtn) const override;
+	int pushOverlapping(const CompactNode& n, CompactBounds nodeBox, const Box& box,
+		int stack[], CompactBounds stackBox[], int top, QueryCounters& count) const;
+	using SpatialIndex::intersect;
+
+	IndexStats getStats() const override;
+	Box bounds() const override { return rootBox; }
+	const char* name() const override { return "compact octree"; }
+
+	void getNodeLines(int node, const Box& box, int numLevels, int level, ofMesh& linesRtn) const;
+	void getNodeLines(int numLevels, int level, ofMesh& linesRtn) const override {
+		if (!nodes.empty()) getNodeLines(0, rootBox, numLevels, level, linesRtn);
+	}
+	void getLeafLines(ofMesh& linesRtn) const override;
+
+	vector<CompactNode> nodes;      // nodes[0] is the root
+	vector<int> indices;            // face indices, grouped by node
+	ofMesh mesh;
+	Box rootBox;                    // exact box of the root
+
+	int levels = 20;                // used by create(mesh)
+	OctreeSettings settings;
+};
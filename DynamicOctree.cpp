@@ -0,0 +1,237 @@
+//  Pierce Kyaw, Aye Thwe Tun
+//
+//  Dynamic loose octree.  See DynamicOctree.h.
+//
+
+#include "DynamicOctree.h"
+
+void DynamicOctree::create(const Box& bounds, int maxDepth) {
+	this->bounds = bounds;
+	this->maxDepth = std::max(0, std::min(maxDepth, MaxDepth - 1));
+	clear();
+}
+
+void DynamicOctree::clear() {
+	Vector3 size = bounds.max() - bounds.min();
+	DynamicNode root;
+	root.center = bounds.center();
+	root.halfSize = std::max(size.x(), std::max(size.y(), size.z())) / 2;
+	Vector3 half(2 * root.halfSize, 2 * root.halfSize, 2 * root.halfSize);
+	root.box = Box(root.center - half, root.center + half);
+
+	nodes.clear();
+	nodes.push_back(root);
+	objects.clear();
+	slots.clear();
+	freeNodes.clear();
+	freeObjects.clear();
+}
+
+int DynamicOctree::newNode(int parent, int octant) {
+	DynamicNode n;
+	const DynamicNode& p = nodes[parent];
+	n.halfSize = p.halfSize / 2;
+	n.center = p.center + Vector3(octant & 1 ? n.halfSize : -n.halfSize,
+		octant & 2 ? n.halfSize : -n.halfSize, octant & 4 ? n.halfSize : -n.halfSize);
+	Vector3 half(2 * n.halfSize, 2 * n.halfSize, 2 * n.halfSize);
+	n.box = Box(n.center - half, n.center + half);
+	n.depth = p.depth + 1;
+	n.parent = parent;
+
+	int node;
+	if (!freeNodes.empty()) {
+		node = freeNodes.back();
+		freeNodes.pop_back();
+		nodes[node] = n;
+	}
+	else {
+		node = nodes.size();
+		nodes.push_back(n);
+	}
+	nodes[parent].child[octant] = node;
+	return node;
+}
+
+//  The node an object with this box belongs in:  go down from the root
+//  while the box is no bigger than a child's cube and its center is inside
+//  the current cube.  Missing nodes on the way are created.
+//
+int DynamicOctree::findNode(const Box& box) {
+	Vector3 c = box.center();
+	Vector3 size = box.max() - box.min();
+	float radius = std::max(size.x(), std::max(size.y(), size.z())) / 2;
+
+	int node = 0;
+	while (nodes[node].depth < maxDepth) {
+		const DynamicNode& n = nodes[node];
+		float childHalf = n.halfSize / 2;
+		if (radius > childHalf) break;
+		Vector3 d = c - n.center;
+		if (fabs(d.x()) > n.halfSize || fabs(d.y()) > n.halfSize || fabs(d.z()) > n.halfSize) break;
+
+		int octant = (d.x() >= 0) | (d.y() >= 0) << 1 | (d.z() >= 0) << 2;
+		int next = n.child[octant];
+		node = next >= 0 ? next : newNode(node, octant);
+	}
+	return node;
+}
+
+void DynamicOctree::link(int slot, int node) {
+	DynamicObject& o = objects[slot];
+	o.node = node;
+	o.prev = -1;
+	o.next = nodes[node].firstObject;
+	if (o.next >= 0) objects[o.next].prev = slot;
+	nodes[node].firstObject = slot;
+	for (int n = node; n >= 0; n = nodes[n].parent) nodes[n].count++;
+}
+
+// take the object out of its node, and free the nodes left empty
+//
+void DynamicOctree::unlink(int slot) {
+	DynamicObject& o = objects[slot];
+	if (o.prev >= 0) objects[o.prev].next = o.next;
+	else nodes[o.node].firstObject = o.next;
+	if (o.next >= 0) objects[o.next].prev = o.prev;
+
+	for (int n = o.node; n >= 0;) {
+		int parent = nodes[n].parent;
+		if (--nodes[n].count == 0 && parent >= 0) {
+			for (int i = 0; i < 8; i++) {
+				if (nodes[parent].child[i] == n) nodes[parent].child[i] = -1;
+			}
+			freeNodes.push_back(n);
+		}
+		n = parent;
+	}
+	o.node = -1;
+}
+
+void DynamicOctree::insert(int id, const Box& box) {
+	auto it = slots.find(id);
+	if (it != slots.end()) {
+		move(id, box);
+		return;
+	}
+
+	int slot;
+	if (!freeObjects.empty()) {
+		slot = freeObjects.back();
+		freeObjects.pop_back();
+	}
+	else {
+		slot = objects.size();
+		objects.push_back(DynamicObject());
+	}
+	objects[slot].id = id;
+	objects[slot].box = box;
+	slots[id] = slot;
+	link(slot, findNode(box));
+}
+
+//  True if findNode() would stop at "node" for this box:  the box is in
+//  the node's cube (any box is in the root's) and does not fit a child.
+//
+bool DynamicOctree::fits(int node, const Box& box) const {
+	const DynamicNode& n = nodes[node];
+	Vector3 c = box.center();
+	Vector3 size = box.max() - box.min();
+	float radius = std::max(size.x(), std::max(size.y(), size.z())) / 2;
+	Vector3 d = c - n.center;
+	bool inCube = fabs(d.x()) <= n.halfSize && fabs(d.y()) <= n.halfSize && fabs(d.z()) <= n.halfSize;
+	if (n.parent >= 0 && (!inCube || radius > n.halfSize)) return false;
+	return n.depth >= maxDepth || !inCube || radius > n.halfSize / 2;
+}
+
+//  Most moves between frames are small, so first check whether the object
+//  still belongs in the same node; then only its box changes.
+//
+void DynamicOctree::move(int id, const Box& box) {
+	auto it = slots.find(id);
+	if (it == slots.end()) return;
+
+	int slot = it->second;
+	objects[slot].box = box;
+	if (fits(objects[slot].node, box)) return;
+	unlink(slot);
+	link(slot, findNode(box));
+}
+
+void DynamicOctree::remove(int id) {
+	auto it = slots.find(id);
+	if (it == slots.end()) return;
+
+	int slot = it->second;
+	unlink(slot);
+	objects[slot].id = -1;
+	freeObjects.push_back(slot);
+	slots.erase(it);
+}
+
+int DynamicOctree::query(const Box& box, vector<int>& idsRtn) const {
+	idsRtn.clear();
+	int stack[MaxDepth * 8];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		const DynamicNode& n = nodes[stack[--top]];
+
+		// the root also holds objects outside its box, so it is never culled
+		//
+		if (n.parent >= 0 && !n.box.overlap(box)) continue;
+		for (int o = n.firstObject; o >= 0; o = objects[o].next) {
+			if (objects[o].box.overlap(box)) idsRtn.push_back(objects[o].id);
+		}
+		for (int i = 0; i < 8; i++) {
+			if (n.child[i] >= 0) stack[top++] = n.child[i];
+		}
+	}
+	return idsRtn.size();
+}
+
+bool DynamicOctree::intersect(const Ray& ray, RayHit& hitRtn) const {
+	int stack[MaxDepth * 8];
+	float stackT[MaxDepth * 8];
+	int top = 0;
+	stack[top] = 0;
+	stackT[top++] = 0;
+	float tNearest = INFINITE;
+	bool found = false;
+
+	while (top > 0) {
+		top--;
+		if (stackT[top] > tNearest) continue;
+
+		int node = stack[top];
+		const DynamicNode& n = nodes[node];
+		float t;
+		for (int o = n.firstObject; o >= 0; o = objects[o].next) {
+			if (objects[o].box.intersect(ray, 0, tNearest, t)) {
+				tNearest = t;
+				hitRtn.t = t;
+				hitRtn.leaf = node;
+				hitRtn.index = objects[o].id;
+				found = true;
+			}
+		}
+		for (int i = 0; i < 8; i++) {
+			int c = n.child[i];
+			if (c >= 0 && nodes[c].box.intersect(ray, 0, tNearest, t)) {
+				stack[top] = c;
+				stackT[top++] = t;
+			}
+		}
+	}
+
+	if (found) {
+		Vector3 p = ray.origin + ray.direction * hitRtn.t;
+		hitRtn.point = glm::vec3(p.x(), p.y(), p.z());
+	}
+	return found;
+}
+
+void DynamicOctree::draw() {
+	for (int i = 0; i < objects.size(); i++) {
+		if (objects[i].id >= 0) SpatialIndex::drawBox(objects[i].box);
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+//  Pierce Kyaw, Aye Thwe Tun
+//
+//  Dynamic (loose) octree of moving objects:  the rocket, particles,
+//  debris.  Objects are an id and a bounding box; they can be inserted,
+//  moved and removed one at a time, in time proportional to the depth of
+//  the tree, without rebuilding it.
+//
+//  Each node covers a cube (center +- halfSize) and holds the objects whose
+//  center is in the cube and that are too big for its children.  Node
+//  boxes are loose:  twice the size of the cube, so every object stays
+//  inside the box of its node and queries only visit nodes whose box they
+//  overlap.  Nodes are created as objects move in and freed when the last
+//  object in their subtree leaves.  Objects outside the bounds given to
+//  create() are kept in the root.
+//
+//  Results are RayHit / object ids like the SpatialIndex queries of the
+//  static terrain, so the two can be queried side by side.
+//
+
+#include "ofMain.h"
+#include "SpatialIndex.h"
+#include <unordered_map>
+
+class DynamicNode {
+public:
+	Vector3 center;
+	float halfSize = 0;
+	Box box;                    // loose box, center +- 2 * halfSize
+	int depth = 0;
+	int parent = -1;
+	int child[8] = { -1, -1, -1, -1, -1, -1, -1, -1 };   // octant = x | y << 1 | z << 2
+	int firstObject = -1;       // list of the objects in this node
+	int count = 0;              // objects in the subtree
+};
+
+class DynamicObject {
+public:
+	int id = -1;
+	Box box;
+	int node = -1;
+	int next = -1, prev = -1;   // objects of the same node
+};
+
+class DynamicOctree {
+public:
+
+	// deepest tree supported by the fixed size traversal stacks
+	//
+	static const int MaxDepth = 16;
+
+	// start an empty tree over "bounds" (made cubic)
+	//
+	void create(const Box& bounds, int maxDepth = 8);
+	void clear();
+
+	// ids are chosen by the caller.  Inserting an id that is already in the
+	// tree moves it; moving or removing an id that is not does nothing.
+	//
+	void insert(int id, const Box& box);
+	void move(int id, const Box& box);
+	void remove(int id);
+	bool contains(int id) const { return slots.count(id) > 0; }
+	int size() const { return slots.size(); }
+
+	// ids of the objects whose boxes overlap the box.  Returns the number
+	// found.
+	//
+	int query(const Box& box, vector<int>& idsRtn) const;
+
+	// nearest object box along the ray.  hitRtn.index is the object id,
+	// hitRtn.leaf the node it is in.
+	//
+	bool intersect(const Ray& ray, RayHit& hitRtn) const;
+
+	int findNode(const Box& box);
+	bool fits(int node, const Box& box) const;
+	int newNode(int parent, int octant);
+	void link(int slot, int node);
+	void unlink(int slot);
+	void draw();
+
+	vector<DynamicNode> nodes;          // nodes[0] is the root
+	vector<DynamicObject> objects;
+	std::unordered_map<int, int> slots; // id -> index in objects
+	vector<int> freeNodes, freeObjects;
+	int maxDepth = 8;
+	Box bounds;
+};
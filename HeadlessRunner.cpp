@@ -0,0 +1,209 @@
+//  Pierce Kyaw, Aye Thwe Tun
+
+#include "HeadlessRunner.h"
+#include <fstream>
+#include <sstream>
+
+// Read the vertices and faces of an .obj file into a triangle mesh
+// (polygons are split into fans).  Normals, texture coordinates, groups and
+// materials are skipped.
+//
+bool HeadlessRunner::loadObj(const string& path, ofMesh& meshRtn) {
+	std::ifstream in(ofToDataPath(path));
+	if (!in) return false;
+
+	meshRtn.clear();
+	meshRtn.setMode(OF_PRIMITIVE_TRIANGLES);
+
+	string line;
+	vector<int> face;
+	while (getline(in, line)) {
+		if (line.size() < 2 || line[1] != ' ') continue;
+		if (line[0] == 'v') {
+			glm::vec3 v;
+			if (sscanf(line.c_str() + 2, "%f %f %f", &v.x, &v.y, &v.z) == 3) meshRtn.addVertex(v);
+		}
+		else if (line[0] == 'f') {
+			// "f v/vt/vn ...", indices from 1, or negative from the end
+			face.clear();
+			std::istringstream tokens(line.substr(2));
+			string token;
+			while (tokens >> token) {
+				int index = atoi(token.c_str());
+				face.push_back(index < 0 ? (int)meshRtn.getNumVertices() + index : index - 1);
+			}
+			for (int i = 1; i + 1 < face.size(); i++) {
+				meshRtn.addIndex(face[0]);
+				meshRtn.addIndex(face[i]);
+				meshRtn.addIndex(face[i + 1]);
+			}
+		}
+	}
+	return meshRtn.getNumVertices() > 0 && meshRtn.getNumIndices() > 0;
+}
+
+bool HeadlessRunner::loadScript(const string& path, vector<ScriptInput>& scriptRtn) {
+	std::ifstream in(path);
+	if (!in) return false;
+
+	scriptRtn.clear();
+	string line;
+	while (getline(in, line)) {
+		line = line.substr(0, line.find('#'));
+		ScriptInput input;
+		int n = sscanf(line.c_str(), "%f %f %f %f %f", &input.time,
+			&input.thrust.x, &input.thrust.y, &input.thrust.z, &input.turn);
+		if (n >= 4) scriptRtn.push_back(input);
+	}
+	std::stable_sort(scriptRtn.begin(), scriptRtn.end(),
+		[](const ScriptInput& a, const ScriptInput& b) { return a.time < b.time; });
+	return !scriptRtn.empty();
+}
+
+// Fall, brake, drift sideways while turning, then fall again
+//
+vector<ScriptInput> HeadlessRunner::defaultScript() {
+	vector<ScriptInput> script(5);
+	script[1].time = 3;
+	script[1].thrust = glm::vec3(0, 2.5, 0);
+	script[2].time = 5;
+	script[2].thrust = glm::vec3(10, 1, 5);
+	script[2].turn = 20;
+	script[3].time = 7;
+	script[3].thrust = glm::vec3(0, 3, 0);
+	script[4].time = 9;
+	return script;
+}
+
+const ScriptInput& HeadlessRunner::inputAt(float time) const {
+	int i = 0;
+	while (i + 1 < script.size() && script[i + 1].time <= time) i++;
+	return script[i];
+}
+
+bool HeadlessRunner::setup(const HeadlessSettings& s) {
+	if (!loadWorld(s)) return false;
+
+	if (settings.scriptPath.empty()) script = defaultScript();
+	else if (!loadScript(settings.scriptPath, script)) {
+		cout << "could not read script " << settings.scriptPath << endl;
+		return false;
+	}
+
+	if (settings.bParticles) {
+		LanderSim::setupEmitters(engine, explosion);
+		lander.engine = &engine;
+		lander.explosion = &explosion;
+		engine.sys->integrator = settings.integrator;
+		explosion.sys->integrator = settings.integrator;
+	}
+	return true;
+}
+
+bool HeadlessRunner::loadWorld(const HeadlessSettings& s) {
+	settings = s;
+
+	// the terrain's spatial index, the same way the game builds it
+	octree.bUseFaces = true;
+	octree.levels = 20;
+	uint64_t terrainHash = TerrainPack::hashFile(ofToDataPath(settings.terrainPath));
+	string packPath = ofToDataPath(ofFilePath::removeExt(settings.terrainPath) + ".pack");
+	if (settings.indexType != BVHIndex && terrainPack.load(packPath, terrainHash, octree)) {
+		terrainPack.attach(octree);
+		cout << "octree mapped from " << packPath << endl;
+	}
+	else {
+		ofMesh mesh;
+		if (!loadObj(settings.terrainPath, mesh)) {
+			cout << "could not read terrain " << settings.terrainPath << endl;
+			return false;
+		}
+		uint64_t t1 = ofGetElapsedTimeMicros();
+		if (settings.indexType == BVHIndex) bvh.create(mesh);
+		else octree.create(mesh, octree.levels);
+		uint64_t t2 = ofGetElapsedTimeMicros();
+		cout << (settings.indexType == BVHIndex ? "bvh" : "octree") << " built from "
+			<< mesh.getNumIndices() / 3 << " faces in " << (t2 - t1) / 1000.0 << " ms" << endl;
+	}
+	if (settings.indexType == BVHIndex) terrainIndex = &bvh;
+	else if (settings.indexType == CompactOctreeIndex) {
+		compactOctree.create(octree);
+		octree = Octree();
+		terrainIndex = &compactOctree;
+	}
+	else terrainIndex = &octree;
+	heightField.create(*terrainIndex);
+
+	// the rocket's bounds, and its triangles for the collider
+	ofMesh rocketMesh;
+	if (!loadObj(settings.rocketPath, rocketMesh)) {
+		cout << "could not read rocket " << settings.rocketPath << endl;
+		return false;
+	}
+	glm::vec3 min = rocketMesh.getVertex(0), max = min;
+	for (int i = 1; i < rocketMesh.getNumVertices(); i++) {
+		min = glm::min(min, rocketMesh.getVertex(i));
+		max = glm::max(max, rocketMesh.getVertex(i));
+	}
+	rocketBounds = Box(Vector3(min.x, min.y, min.z), Vector3(max.x, max.y, max.z));
+	if (settings.bMeshCollisions) rocketCollider.create(rocketMesh);
+
+	ofSeedRandom(settings.seed);
+	lander.terrain = terrainIndex;
+	lander.heightField = &heightField;
+	lander.localBounds = rocketBounds;
+	lander.collider = settings.bMeshCollisions ? &rocketCollider : nullptr;
+	lander.settings.integrator = settings.integrator;
+	lander.placeLandingZones();
+	return true;
+}
+
+void HeadlessRunner::run() {
+	float dt = 1.0 / settings.rate;
+	int flights = 0, landed = 0, crashed = 0, outOfFuel = 0, timedOut = 0;
+	double simSeconds = 0;
+
+	lander.reset(settings.start);
+	const ScriptInput* input = nullptr;
+
+	uint64_t t1 = ofGetElapsedTimeMicros();
+	for (int i = 0; i < settings.steps; i++) {
+		// inputs only change at script lines, like key presses
+		const ScriptInput& next = inputAt(lander.time);
+		if (&next != input) {
+			input = &next;
+			lander.setThrust(input->thrust);
+			lander.angularForce = input->turn;
+		}
+
+		lander.step(dt);
+		simSeconds += dt;
+
+		if (lander.bOver || lander.time >= settings.maxFlightTime) {
+			flights++;
+			if (lander.bWin) landed++;
+			else if (lander.bNoFuel) outOfFuel++;
+			else if (lander.bOver) crashed++;
+			else timedOut++;
+			lander.reset(settings.start);
+			input = nullptr;
+		}
+	}
+	uint64_t t2 = ofGetElapsedTimeMicros();
+
+	double seconds = (t2 - t1) / 1000000.0;
+	double rate = seconds > 0 ? settings.steps / seconds : 0;
+	cout << "headless: " << terrainIndex->name() << ", " << settings.steps << " steps of "
+		<< dt * 1000 << " ms" << (settings.bParticles ? ", with particles" : "") << endl;
+	cout << "  flights: " << flights << " (landed " << landed << ", crashed " << crashed
+		<< ", out of fuel " << outOfFuel << ", timed out " << timedOut << "), score " << lander.score << endl;
+	cout << "  " << simSeconds << " simulated sec in " << seconds << " sec:  "
+		<< rate << " steps/sec, " << (seconds > 0 ? simSeconds / seconds : 0) << "x real time" << endl;
+}
+
+int runHeadless(const HeadlessSettings& settings) {
+	HeadlessRunner runner;
+	if (!runner.setup(settings)) return 1;
+	runner.run();
+	return 0;
+}
@@ -0,0 +1,101 @@
+#pragma once
+//  Pierce Kyaw, Aye Thwe Tun
+//
+//  Runs the lander simulation (LanderSim) with no window and no GL context,
+//  as fast as it goes, so it can be timed on machines without a GPU.
+//  main.cpp runs it for --headless instead of opening the game.
+//
+//  The terrain's octree is mapped from the terrain pack when the game has
+//  written one, and otherwise built from the .obj file, which is read with
+//  a small reader here (the Assimp model loader makes GL buffers).
+//
+//  The rocket flies a script of timed inputs, one per line (# starts a
+//  comment):
+//
+//     <time> <thrust x> <thrust y> <thrust z> [<turn>]
+//
+//  From <time> seconds after the start of a flight the thrust and the
+//  turning force are the given ones, until the next line.  A flight ends
+//  when the rocket lands, crashes, runs out of fuel or has flown
+//  maxFlightTime seconds, and the next one starts.
+//
+
+#include "ofMain.h"
+#include "Octree.h"
+#include "BVH.h"
+#include "CompactOctree.h"
+#include "TerrainPack.h"
+#include "HeightField.h"
+#include "LanderSim.h"
+
+class ScriptInput {
+public:
+	float time = 0;
+	glm::vec3 thrust = glm::vec3(0, 0, 0);
+	float turn = 0;
+};
+
+class HeadlessSettings {
+public:
+	string terrainPath = "geo/moonterrain.obj";     // relative to the data folder
+	string rocketPath = "geo/rocket.obj";
+	string scriptPath;                              // built in script if empty
+	SpatialIndexType indexType = OctreeIndex;
+	int steps = 100000;
+	float rate = 60;                                // steps per simulated second
+	float maxFlightTime = 60;                       // sec
+	glm::vec3 start = glm::vec3(0, 30, 0);
+	bool bParticles = true;                         // update the engine and explosion
+	bool bMeshCollisions = true;                    // collide the rocket's mesh, not its box
+	IntegratorType integrator = ExplicitEulerIntegrator;    // the rocket's and the particles'
+	unsigned int seed = 1;                          // for the landing zones
+};
+
+class HeadlessRunner {
+public:
+	HeadlessRunner() { }
+	HeadlessRunner(const HeadlessRunner&) = delete;
+	HeadlessRunner& operator=(const HeadlessRunner&) = delete;
+
+	// load the terrain and the rocket, build the spatial index and the
+	// height field, and read the script
+	//
+	bool setup(const HeadlessSettings& settings);
+
+	// the part of setup() that other drivers (MonteCarloLanding.h) share:
+	// the terrain index, the height field, the rocket's bounds and collider
+	// and the landing zones (in lander)
+	//
+	bool loadWorld(const HeadlessSettings& settings);
+
+	// fly settings.steps steps and print the results to cout
+	//
+	void run();
+
+	// the script input in effect "time" seconds into a flight
+	//
+	const ScriptInput& inputAt(float time) const;
+
+	static bool loadObj(const string& path, ofMesh& meshRtn);
+	static bool loadScript(const string& path, vector<ScriptInput>& scriptRtn);
+	static vector<ScriptInput> defaultScript();
+
+	HeadlessSettings settings;
+	TerrainPack terrainPack;        // must outlive octree, which may point into it
+	Octree octree;
+	BVH bvh;
+	CompactOctree compactOctree;
+	SpatialIndex* terrainIndex = &octree;
+	HeightField heightField;
+	Box rocketBounds;               // relative to the rocket's position
+	RocketCollider rocketCollider;  // the rocket's mesh
+	vector<ScriptInput> script;     // sorted by time
+
+	LanderSim lander;
+	ParticleEmitter engine, explosion;
+};
+
+//  Run the headless simulation:  setup() and run().  Returns the program's
+//  exit code.
+//
+int runHeadless(const HeadlessSettings& settings);
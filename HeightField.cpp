@@ -0,0 +1,169 @@
+//  Pierce Kyaw, Aye Thwe Tun
+//
+//  Height field of the terrain.  See HeightField.h.
+//
+
+#include "HeightField.h"
+#include <cfloat>
+
+// faces steeper than this (|normal.y| below it) make their cells overhangs
+//
+static const float steepNormalY = 0.01f;
+
+// unit normal of a triangle, flipped to face up
+//
+glm::vec3 HeightField::upNormal(const glm::vec3 v[3]) {
+	glm::vec3 n = glm::cross(v[1] - v[0], v[2] - v[0]);
+	float len = glm::length(n);
+	if (len == 0) return glm::vec3(0, 1, 0);
+	n = n / len;
+	return n.y < 0 ? -n : n;
+}
+
+void HeightField::create(const SpatialIndex& index, float facesPerCell) {
+	uint64_t start = ofGetElapsedTimeMicros();
+	this->index = &index;
+	Box bounds = index.bounds();
+	minX = bounds.min().x();
+	minZ = bounds.min().z();
+	topY = bounds.max().y();
+	float sizeX = bounds.max().x() - minX;
+	float sizeZ = bounds.max().z() - minZ;
+	int numFaces = index.getNumFaces();
+
+	// square cells, about facesPerCell faces each
+	//
+	float area = std::max(sizeX * sizeZ, 1e-6f);
+	cellSize = sqrtf(area * facesPerCell / std::max(numFaces, 1));
+	if (cellSize <= 0) cellSize = 1;
+	numCellsX = std::max(1, (int)ceilf(sizeX / cellSize));
+	numCellsZ = std::max(1, (int)ceilf(sizeZ / cellSize));
+	int numCells = numCellsX * numCellsZ;
+
+	// two passes over the faces:  count the faces of each cell, then fill
+	// the cells.  "sign" is the sign of normal.y of the faces in a cell
+	// (wound the same way); a cell whose faces disagree is an overhang.
+	//
+	cellStart.assign(numCells + 1, 0);
+	overhang.assign(numCells, 0);
+	cellTop.assign(numCells, -FLT_MAX);
+	vector<signed char> sign(numCells, 0);
+	for (int pass = 0; pass < 2; pass++) {
+		vector<int> next;
+		if (pass == 1) {
+			for (int c = 0; c < numCells; c++) cellStart[c + 1] += cellStart[c];
+			cellFaces.resize(cellStart[numCells]);
+			next.assign(cellStart.begin(), cellStart.end() - 1);
+		}
+		for (int f = 0; f < numFaces; f++) {
+			glm::vec3 v[3];
+			index.getFace(f, v);
+			glm::vec3 lo = glm::min(v[0], glm::min(v[1], v[2]));
+			glm::vec3 hi = glm::max(v[0], glm::max(v[1], v[2]));
+			int x0 = std::max(0, (int)((lo.x - minX) / cellSize));
+			int x1 = std::min(numCellsX - 1, (int)((hi.x - minX) / cellSize));
+			int z0 = std::max(0, (int)((lo.z - minZ) / cellSize));
+			int z1 = std::min(numCellsZ - 1, (int)((hi.z - minZ) / cellSize));
+			glm::vec3 n = glm::cross(v[1] - v[0], v[2] - v[0]);
+			float len = glm::length(n);
+			bool steep = len == 0 || fabs(n.y) < steepNormalY * len;
+			signed char s = n.y < 0 ? -1 : 1;
+			for (int z = z0; z <= z1; z++) {
+				for (int x = x0; x <= x1; x++) {
+					int c = x + z * numCellsX;
+					if (pass == 0) {
+						cellStart[c + 1]++;
+						cellTop[c] = std::max(cellTop[c], hi.y);
+						if (len == 0) continue;     // degenerate faces are never hit
+						if (steep || (sign[c] && sign[c] != s)) overhang[c] = 1;
+						sign[c] = s;
+					}
+					else cellFaces[next[c]++] = f;
+				}
+			}
+		}
+	}
+
+	numOverhangs = 0;
+	for (int c = 0; c < numCells; c++) numOverhangs += overhang[c];
+	buildMillis = (ofGetElapsedTimeMicros() - start) / 1000.0f;
+}
+
+int HeightField::cellOf(float x, float z) const {
+	int cx = (int)floorf((x - minX) / cellSize);
+	int cz = (int)floorf((z - minZ) / cellSize);
+	if (cx < 0 || cz < 0 || cx >= numCellsX || cz >= numCellsZ) return -1;
+	return cx + cz * numCellsX;
+}
+
+float HeightField::maxHeight(float x0, float z0, float x1, float z1) const {
+	int cx0 = std::max(0, (int)floorf((x0 - minX) / cellSize));
+	int cz0 = std::max(0, (int)floorf((z0 - minZ) / cellSize));
+	int cx1 = std::min(numCellsX - 1, (int)floorf((x1 - minX) / cellSize));
+	int cz1 = std::min(numCellsZ - 1, (int)floorf((z1 - minZ) / cellSize));
+	float top = -FLT_MAX;
+	for (int z = cz0; z <= cz1; z++) {
+		for (int x = cx0; x <= cx1; x++) top = std::max(top, cellTop[x + z * numCellsX]);
+	}
+	return top;
+}
+
+bool HeightField::isOverhang(float x, float z) const {
+	int c = cellOf(x, z);
+	return c >= 0 && overhang[c];
+}
+
+//  The faces of the cell whose x / z projection contains (x, z), tested in
+//  2D with barycentric coordinates.  A point on an edge shared by two faces
+//  is inside both, and both give the same height.  Two faces over the
+//  point at different heights (two surfaces of opposite winding are caught
+//  when the field is built; this catches separate pieces of terrain) send
+//  the lookup to the index as well.
+//
+bool HeightField::groundBelow(const glm::vec3& p, GroundHit& hitRtn) const {
+	int c = cellOf(p.x, p.z);
+	if (c < 0) return false;
+	if (overhang[c]) return rayFallback(p, hitRtn);
+
+	const float eps = 1e-5f;
+	bool found = false;
+	float height = 0;
+	for (int i = cellStart[c]; i < cellStart[c + 1]; i++) {
+		glm::vec3 v[3];
+		index->getFace(cellFaces[i], v);
+		float ax = v[1].x - v[0].x, az = v[1].z - v[0].z;
+		float bx = v[2].x - v[0].x, bz = v[2].z - v[0].z;
+		float det = ax * bz - az * bx;
+		if (det == 0) continue;
+		float px = p.x - v[0].x, pz = p.z - v[0].z;
+		float u = (px * bz - pz * bx) / det;
+		float w = (ax * pz - az * px) / det;
+		if (u < -eps || w < -eps || u + w > 1 + eps) continue;
+
+		float h = v[0].y + u * (v[1].y - v[0].y) + w * (v[2].y - v[0].y);
+		if (found && fabs(h - height) > 1e-3f) return rayFallback(p, hitRtn);
+		if (found) continue;
+		found = true;
+		height = h;
+		hitRtn.face = cellFaces[i];
+		hitRtn.normal = upNormal(v);
+	}
+	if (!found || height > p.y) return false;
+	hitRtn.point = glm::vec3(p.x, height, p.z);
+	return true;
+}
+
+bool HeightField::groundAt(float x, float z, GroundHit& hitRtn) const {
+	return groundBelow(glm::vec3(x, topY + 1, z), hitRtn);
+}
+
+bool HeightField::rayFallback(const glm::vec3& p, GroundHit& hitRtn) const {
+	RayHit hit;
+	if (!index->intersect(Ray(Vector3(p.x, p.y, p.z), Vector3(0, -1, 0)), hit)) return false;
+	glm::vec3 v[3];
+	index->getFace(hit.index, v);
+	hitRtn.point = hit.point;
+	hitRtn.normal = upNormal(v);
+	hitRtn.face = hit.index;
+	return true;
+}
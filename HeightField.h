@@ -0,0 +1,81 @@
+#pragma once
+//  Pierce Kyaw, Aye Thwe Tun
+//
+//  Height field of the terrain:  a regular grid over the terrain's x / z
+//  bounds where each cell lists the triangles whose x / z bounds overlap
+//  it.  The ground below a point is found by testing only the few triangles
+//  of its cell, so altitude, hover and landing zone lookups take constant
+//  time instead of a ray query through the spatial index.
+//
+//  Heights and normals are exact:  they come from the triangle the point
+//  is over.  A cell where the surface is not a function of x / z (an
+//  overhang, a vertical wall, or surfaces that face opposite ways) is
+//  flagged when the field is built; lookups there fall back to a downward
+//  ray through the spatial index.
+//
+
+#include "SpatialIndex.h"
+
+//  Ground below a point.
+//
+//    point    where the surface is, straight below the query point
+//    normal   unit normal of the surface there, facing up
+//    face     face index of the triangle
+//
+class GroundHit {
+public:
+	glm::vec3 point;
+	glm::vec3 normal;
+	int face;
+};
+
+class HeightField {
+public:
+
+	// build over the triangles of the index's mesh.  Cells are sized so
+	// there are about facesPerCell faces per cell.  The index must outlive
+	// the height field; it is used for the mesh and for the fallback (an
+	// octree must be in face mode).
+	//
+	void create(const SpatialIndex& index, float facesPerCell = 2);
+
+	// the ground straight below p:  the nearest surface at or below p.y.
+	// False if there is no terrain below p.
+	//
+	bool groundBelow(const glm::vec3& p, GroundHit& hitRtn) const;
+
+	// the top surface at (x, z), for dropping things onto the terrain
+	//
+	bool groundAt(float x, float z, GroundHit& hitRtn) const;
+
+	// highest point of the faces in the cells under the rectangle x0..x1,
+	// z0..z1 (-FLT_MAX where there is no terrain), for culling things
+	// that are above the terrain without a query
+	//
+	float maxHeight(float x0, float z0, float x1, float z1) const;
+
+	// true if lookups in the cell of (x, z) use the spatial index
+	//
+	bool isOverhang(float x, float z) const;
+
+	int cellOf(float x, float z) const;
+	bool rayFallback(const glm::vec3& p, GroundHit& hitRtn) const;
+	static glm::vec3 upNormal(const glm::vec3 v[3]);
+
+	int numCellsX = 0, numCellsZ = 0;
+	float cellSize = 1;
+	float minX = 0, minZ = 0;
+	float topY = 0;                     // top of the terrain bounds
+
+	// cell c (x + z * numCellsX) holds faces cellFaces[cellStart[c]] to
+	// cellFaces[cellStart[c + 1] - 1]
+	//
+	vector<int> cellStart;
+	vector<int> cellFaces;
+	vector<unsigned char> overhang;     // 1 for cells that fall back to the index
+	vector<float> cellTop;              // highest point of the faces in each cell
+	int numOverhangs = 0;
+	float buildMillis = 0;
+
+	const SpatialIndex* index = nullptr;
+};
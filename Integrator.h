@@ -0,0 +1,99 @@
+#pragma once
+//  Pierce Kyaw, Aye Thwe Tun
+//
+//  Integrators for the motion of the lander and the particles, chosen at
+//  run time.  Each one advances a position x and velocity v by dt seconds
+//  given the acceleration as a function of the state, a(x, v):
+//
+//    ExplicitEulerIntegrator       x += v dt, then v += a dt.  First order.
+//                                  The game's original integrator.
+//    SemiImplicitEulerIntegrator   v += a dt, then x += v dt (the new v).
+//                                  First order, one evaluation of a, and
+//                                  does not gain energy like explicit Euler.
+//    VelocityVerletIntegrator      x from v and a, then v from the average of
+//                                  a at both ends.  Second order, two
+//                                  evaluations of a.
+//    RK4Integrator                 classic Runge-Kutta.  Fourth order, four
+//                                  evaluations of a.
+//
+//  The game's damping is a factor the velocity is multiplied by every step,
+//  which slows things down more at higher step rates.  With explicit Euler
+//  it is still applied that way, so the game plays as before; the other
+//  integrators take it as a drag acceleration, -drag v, with the drag that
+//  gives the same slowing at DampingRate steps per second (see drag()), so
+//  their results do not depend on the step.
+//
+//  The acceleration is a function of x and v only:  forces that change with
+//  time (thrust, particle forces) are held for the step.  x and v may be
+//  floats (the rotation) or vectors.  IntegratorBenchmark.h compares the
+//  integrators' accuracy and cost.
+//
+
+#include <cmath>
+
+typedef enum { ExplicitEulerIntegrator, SemiImplicitEulerIntegrator, VelocityVerletIntegrator, RK4Integrator } IntegratorType;
+
+class Integrator {
+public:
+	static const int NumTypes = 4;
+
+	// steps per second the damping factors in the game were tuned at
+	//
+	static constexpr float DampingRate = 60;
+
+	static const char* name(IntegratorType type) {
+		const char* names[NumTypes] = { "explicit euler", "semi-implicit euler", "velocity verlet", "rk4" };
+		return names[type];
+	}
+
+	// evaluations of the acceleration per step
+	//
+	static int evaluations(IntegratorType type) {
+		const int counts[NumTypes] = { 1, 1, 2, 4 };
+		return counts[type];
+	}
+
+	// drag per second that slows the velocity by "damping" every step at
+	// DampingRate steps per second:  exp(-drag / DampingRate) = damping
+	//
+	static float drag(float damping) {
+		return damping > 0 ? -log(damping) * DampingRate : 0;
+	}
+
+	// advance x and v by dt seconds.  accel(x, v) returns the acceleration.
+	//
+	template <class T, class Acceleration>
+	static void step(IntegratorType type, T& x, T& v, float dt, const Acceleration& accel) {
+		switch (type) {
+		case ExplicitEulerIntegrator: {
+			T a = accel(x, v);
+			x += v * dt;
+			v += a * dt;
+			break;
+		}
+		case SemiImplicitEulerIntegrator:
+			v += accel(x, v) * dt;
+			x += v * dt;
+			break;
+		case VelocityVerletIntegrator: {
+			// a at the end is taken at the velocity predicted from a at the
+			// start, since drag depends on the velocity
+			T a1 = accel(x, v);
+			x += v * dt + a1 * (0.5f * dt * dt);
+			T a2 = accel(x, v + a1 * dt);
+			v += (a1 + a2) * (0.5f * dt);
+			break;
+		}
+		case RK4Integrator: {
+			float h = dt * 0.5f;
+			T x1 = x, v1 = v, a1 = accel(x1, v1);
+			T x2 = x + v1 * h, v2 = v + a1 * h, a2 = accel(x2, v2);
+			T x3 = x + v2 * h, v3 = v + a2 * h, a3 = accel(x3, v3);
+			T x4 = x + v3 * dt, v4 = v + a3 * dt, a4 = accel(x4, v4);
+			x += (v1 + v2 * 2.0f + v3 * 2.0f + v4) * (dt / 6);
+			v += (a1 + a2 * 2.0f + a3 * 2.0f + a4) * (dt / 6);
+			break;
+		}
+		}
+	}
+};
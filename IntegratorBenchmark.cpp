@@ -0,0 +1,156 @@
+//  Pierce Kyaw, Aye Thwe Tun
+
+#include "IntegratorBenchmark.h"
+#include <random>
+#include <iomanip>
+
+//  The lander's motion at the end of a second of the flight.
+//
+class FlightSample {
+public:
+	glm::dvec3 position = glm::dvec3(0, 0, 0);
+	glm::dvec3 velocity = glm::dvec3(0, 0, 0);
+	double rotation = 0;
+	double angularVelocity = 0;
+};
+
+//  The inputs, one per second of the flight.
+//
+class FlightInputs {
+public:
+	vector<glm::vec3> thrust;
+	vector<float> turn;
+};
+
+static FlightInputs makeInputs(const IntegratorBenchmarkSettings& settings) {
+	std::mt19937 rng(settings.seed);
+	std::uniform_real_distribution<float> side(-3, 3);
+	std::uniform_real_distribution<float> up(0, 2 * settings.lander.gravity / settings.lander.mass);
+	std::uniform_real_distribution<float> turn(-20, 20);
+	FlightInputs inputs;
+	for (int i = 0; i < (int)settings.flightTime; i++) {
+		inputs.thrust.push_back(glm::vec3(side(rng), up(rng), side(rng)));
+		inputs.turn.push_back(turn(rng));
+	}
+	return inputs;
+}
+
+// x and v after t seconds of a constant acceleration a and drag k, which
+// solve v' = a - k v
+//
+template <class T>
+static void exactMotion(T& x, T& v, const T& a, double k, double t) {
+	if (k == 0) {
+		x += v * t + a * (0.5 * t * t);
+		v += a * t;
+		return;
+	}
+	T terminal = a / k;
+	double decay = exp(-k * t);
+	x += terminal * t + (v - terminal) * ((1 - decay) / k);
+	v = terminal + (v - terminal) * decay;
+}
+
+static void flyExact(const IntegratorBenchmarkSettings& settings, const FlightInputs& inputs, vector<FlightSample>& samplesRtn) {
+	const LanderSettings& lander = settings.lander;
+	double k = Integrator::drag(lander.damping);
+	FlightSample s;
+	samplesRtn.clear();
+	for (int i = 0; i < inputs.thrust.size(); i++) {
+		glm::dvec3 a = glm::dvec3(inputs.thrust[i]) + glm::dvec3(0, -lander.gravity / lander.mass, 0);
+		double turn = inputs.turn[i] / lander.mass;
+		exactMotion(s.position, s.velocity, a, k, 1.0);
+		exactMotion(s.rotation, s.angularVelocity, turn, k, 1.0);
+		samplesRtn.push_back(s);
+	}
+}
+
+// the flight through LanderSim::integrate, as the game steps it
+//
+static void fly(const IntegratorBenchmarkSettings& settings, const FlightInputs& inputs,
+	IntegratorType integrator, float rate, vector<FlightSample>& samplesRtn) {
+	LanderSim sim;
+	sim.settings = settings.lander;
+	sim.settings.integrator = integrator;
+	sim.reset(glm::vec3(0, 0, 0));
+	int stepsPerSecond = (int)round(rate);
+	float dt = 1.0f / stepsPerSecond;
+	samplesRtn.clear();
+	for (int i = 0; i < inputs.thrust.size(); i++) {
+		sim.force = inputs.thrust[i];
+		sim.angularForce = inputs.turn[i];
+		for (int j = 0; j < stepsPerSecond; j++) {
+			sim.integrate(dt);
+		}
+		FlightSample s;
+		s.position = glm::dvec3(sim.position);
+		s.velocity = glm::dvec3(sim.velocity);
+		s.rotation = sim.rotation;
+		s.angularVelocity = sim.angularVelocity;
+		samplesRtn.push_back(s);
+	}
+}
+
+vector<IntegratorResult> benchmarkIntegrators(const IntegratorBenchmarkSettings& settings) {
+	FlightInputs inputs = makeInputs(settings);
+	vector<FlightSample> reference, samples;
+	flyExact(settings, inputs, reference);
+
+	cout << "integrators:  " << inputs.thrust.size() << " sec flight, damping " << settings.lander.damping
+		<< " per step at " << Integrator::DampingRate << " steps/sec (drag " << Integrator::drag(settings.lander.damping)
+		<< "/sec), tolerance " << settings.tolerance << " m" << endl;
+	cout << "  integrator           steps/sec  position err  velocity err  rotation err  ns/step  us/sim sec" << endl;
+
+	vector<IntegratorResult> results;
+	for (int type = 0; type < Integrator::NumTypes; type++) {
+		for (int r = 0; r < settings.rates.size(); r++) {
+			IntegratorResult result;
+			result.integrator = (IntegratorType)type;
+			result.rate = round(settings.rates[r]);
+			fly(settings, inputs, result.integrator, result.rate, samples);
+			for (int i = 0; i < samples.size(); i++) {
+				result.positionError = std::max(result.positionError, (float)glm::distance(samples[i].position, reference[i].position));
+				result.velocityError = std::max(result.velocityError, (float)glm::distance(samples[i].velocity, reference[i].velocity));
+				result.rotationError = std::max(result.rotationError, (float)fabs(samples[i].rotation - reference[i].rotation));
+			}
+
+			// fly it again until enough time has passed to time it
+			int flights = 0;
+			uint64_t t1 = ofGetElapsedTimeMicros();
+			uint64_t t2 = t1;
+			do {
+				fly(settings, inputs, result.integrator, result.rate, samples);
+				flights++;
+				t2 = ofGetElapsedTimeMicros();
+			} while (t2 - t1 < 20000);
+			double steps = (double)flights * samples.size() * result.rate;
+			result.nanosPerStep = (t2 - t1) * 1000.0 / steps;
+			results.push_back(result);
+
+			string name = Integrator::name(result.integrator);
+			cout << "  " << name << string(21 - name.size(), ' ')
+				<< std::setw(9) << result.rate
+				<< std::setw(14) << result.positionError
+				<< std::setw(14) << result.velocityError
+				<< std::setw(14) << result.rotationError
+				<< std::setw(9) << std::setprecision(3) << result.nanosPerStep
+				<< std::setw(12) << result.nanosPerStep * result.rate / 1000.0
+				<< std::setprecision(6) << (result.positionError <= settings.tolerance ? "" : "  x") << endl;
+		}
+	}
+
+	// the cheapest per simulated second within the tolerance
+	int best = -1;
+	for (int i = 0; i < results.size(); i++) {
+		if (results[i].positionError > settings.tolerance) continue;
+		if (best < 0 || results[i].nanosPerStep * results[i].rate < results[best].nanosPerStep * results[best].rate) best = i;
+	}
+	if (best < 0) {
+		cout << "  nothing is within " << settings.tolerance << " m;  try higher rates" << endl;
+	}
+	else {
+		cout << "  cheapest within " << settings.tolerance << " m:  " << Integrator::name(results[best].integrator)
+			<< " at " << results[best].rate << " steps/sec" << endl;
+	}
+	return results;
+}
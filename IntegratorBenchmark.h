@@ -0,0 +1,46 @@
+#pragma once
+//  Pierce Kyaw, Aye Thwe Tun
+//
+//  Accuracy against cost of the integrators in Integrator.h, for choosing
+//  the cheapest one (and step rate) that keeps the lander's trajectory
+//  within a tolerance.
+//
+//  The lander (LanderSim::integrate, no terrain) flies a flight of random
+//  thrusts and turning forces that change every second, at several step
+//  rates with each integrator.  The reference is the exact solution, in
+//  doubles:  with the thrust held and drag linear in the velocity, the
+//  motion over each second has a closed form.  Every rate divides a second
+//  evenly, so all runs see the same thrusts and the error is the
+//  integrator's (and float rounding's).  Explicit Euler damps per step, so
+//  away from Integrator::DampingRate it flies a different (more or less
+//  damped) flight, which shows as error.
+//
+//  main.cpp runs it for --integrators.
+//
+
+#include "LanderSim.h"
+
+class IntegratorBenchmarkSettings {
+public:
+	LanderSettings lander;              // gravity, mass, damping
+	float flightTime = 20;              // sec
+	float tolerance = 0.01;             // largest position error allowed, m
+	vector<float> rates = { 15, 30, 60, 120, 240 };    // steps per sec
+	unsigned int seed = 1;
+};
+
+class IntegratorResult {
+public:
+	IntegratorType integrator = ExplicitEulerIntegrator;
+	float rate = 60;
+	float positionError = 0;            // largest over the flight, m
+	float velocityError = 0;            // m/s
+	float rotationError = 0;            // degrees
+	double nanosPerStep = 0;
+};
+
+//  Fly the flight with every integrator at every rate, print a table of
+//  errors and cost and the cheapest run within the tolerance, and return
+//  the results.
+//
+vector<IntegratorResult> benchmarkIntegrators(const IntegratorBenchmarkSettings& settings);
@@ -0,0 +1,307 @@
+//  Pierce Kyaw, Aye Thwe Tun
+//
+//  Structure of arrays lander simulation.  See LanderPool.h.
+//
+
+#include "LanderPool.h"
+#include <random>
+
+int LanderPool::add(const glm::vec3& p, int zone, float speed) {
+	int i = size();
+	for (vector<float>* a : { &px, &py, &pz, &vx, &vy, &vz, &tx, &ty, &tz, &sx, &sy, &sz,
+		&thrustTime, &flying, &targetX, &targetZ, &zoneRadius, &descentSpeed, &touchdownSpeed }) {
+		a->push_back(0);
+	}
+	state.push_back(FlyingLander);
+	descentSpeed[i] = speed;
+	reset(i, p, zone);
+	return i;
+}
+
+void LanderPool::clear() {
+	for (vector<float>* a : { &px, &py, &pz, &vx, &vy, &vz, &tx, &ty, &tz, &sx, &sy, &sz,
+		&thrustTime, &flying, &targetX, &targetZ, &zoneRadius, &descentSpeed, &touchdownSpeed }) {
+		a->clear();
+	}
+	state.clear();
+	candidates.clear();
+}
+
+void LanderPool::reset(int i, const glm::vec3& p, int zone) {
+	const LandingZone& z = landingZones[zone];
+	targetX[i] = z.center.x;
+	targetZ[i] = z.center.z;
+	zoneRadius[i] = z.radius;
+	px[i] = sx[i] = p.x;
+	py[i] = sy[i] = p.y;
+	pz[i] = sz[i] = p.z;
+	vx[i] = vy[i] = vz[i] = 0;
+	tx[i] = ty[i] = tz[i] = 0;
+	thrustTime[i] = 0;
+	touchdownSpeed[i] = 0;
+	flying[i] = 1;
+	state[i] = FlyingLander;
+}
+
+int LanderPool::count(LanderState s) const {
+	int n = 0;
+	for (int i = 0; i < state.size(); i++) n += state[i] == s;
+	return n;
+}
+
+void LanderPool::step(float dt) {
+	steer();
+	integrate(dt);
+	collide();
+}
+
+//  LandingAutopilot for every lander at once:  the velocity wanted is
+//  toward the target, slower when close, and down once well inside the
+//  zone; the thrust steers toward it, holds up the lander's weight and is
+//  limited to maxThrust.  Landers that are not flying get no thrust.
+//
+//  With SSE (simd.h) 4 landers are steered at a time, the rest one at a
+//  time with the same operations in the same order, so every lander gets
+//  the same thrust either way.
+//
+void LanderPool::steer() {
+	int n = size();
+	float k = 0.5f * gain, k2 = 2 * gain;
+	float weight = settings.gravity / settings.mass;
+	int i = 0;
+
+#ifdef SIMD_SSE
+	__m128 vk = _mm_set1_ps(k), vk2 = _mm_set1_ps(k2), vWeight = _mm_set1_ps(weight);
+	__m128 vMaxSpeed = _mm_set1_ps(maxSpeed), vMaxThrust = _mm_set1_ps(maxThrust);
+	__m128 one = _mm_set1_ps(1), half = _mm_set1_ps(0.5f), zero = _mm_setzero_ps();
+	for (; i + 4 <= n; i += 4) {
+		__m128 dx = _mm_sub_ps(_mm_loadu_ps(&targetX[i]), _mm_loadu_ps(&px[i]));
+		__m128 dz = _mm_sub_ps(_mm_loadu_ps(&targetZ[i]), _mm_loadu_ps(&pz[i]));
+		__m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dz, dz)));
+		__m128 speed = _mm_mul_ps(vk, distance);
+		__m128 scale = _mm_min_ps(one, _mm_div_ps(vMaxSpeed, speed));
+		__m128 wantX = _mm_mul_ps(_mm_mul_ps(dx, vk), scale);
+		__m128 wantZ = _mm_mul_ps(_mm_mul_ps(dz, vk), scale);
+		__m128 inside = _mm_cmplt_ps(distance, _mm_mul_ps(_mm_loadu_ps(&zoneRadius[i]), half));
+		__m128 wantY = _mm_and_ps(inside, _mm_sub_ps(zero, _mm_loadu_ps(&descentSpeed[i])));
+
+		__m128 fx = _mm_mul_ps(_mm_sub_ps(wantX, _mm_loadu_ps(&vx[i])), vk2);
+		__m128 fy = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(wantY, _mm_loadu_ps(&vy[i])), vk2), vWeight);
+		__m128 fz = _mm_mul_ps(_mm_sub_ps(wantZ, _mm_loadu_ps(&vz[i])), vk2);
+		__m128 magnitude = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(fx, fx), _mm_mul_ps(fy, fy)),
+			_mm_mul_ps(fz, fz)));
+		__m128 limit = _mm_mul_ps(_mm_min_ps(one, _mm_div_ps(vMaxThrust, magnitude)), _mm_loadu_ps(&flying[i]));
+		_mm_storeu_ps(&tx[i], _mm_mul_ps(fx, limit));
+		_mm_storeu_ps(&ty[i], _mm_mul_ps(fy, limit));
+		_mm_storeu_ps(&tz[i], _mm_mul_ps(fz, limit));
+	}
+#endif
+
+	for (; i < n; i++) {
+		float dx = targetX[i] - px[i], dz = targetZ[i] - pz[i];
+		float distance = sqrtf(dx * dx + dz * dz);
+		float speed = k * distance;
+		float scale = std::min(1.0f, maxSpeed / speed);
+		float wantX = dx * k * scale, wantZ = dz * k * scale;
+		float wantY = distance < zoneRadius[i] * 0.5f ? 0 - descentSpeed[i] : 0.0f;
+
+		float fx = (wantX - vx[i]) * k2;
+		float fy = (wantY - vy[i]) * k2 + weight;
+		float fz = (wantZ - vz[i]) * k2;
+		float magnitude = sqrtf(fx * fx + fy * fy + fz * fz);
+		float limit = std::min(1.0f, maxThrust / magnitude) * flying[i];
+		tx[i] = fx * limit;
+		ty[i] = fy * limit;
+		tz[i] = fz * limit;
+	}
+}
+
+//  LanderSim::integrate for every lander, and the fuel.  Landers that are
+//  not flying have no velocity and no thrust, and gravity is multiplied
+//  by "flying", so they stay put without a branch.  4 at a time with SSE,
+//  like steer().
+//
+void LanderPool::integrate(float dt) {
+	int n = size();
+	float gravity = settings.gravity / settings.mass, damping = settings.damping;
+	int i = 0;
+
+#ifdef SIMD_SSE
+	__m128 vdt = _mm_set1_ps(dt), vGravity = _mm_set1_ps(gravity), vDamping = _mm_set1_ps(damping);
+	__m128 zero = _mm_setzero_ps();
+	for (; i + 4 <= n; i += 4) {
+		__m128 x = _mm_loadu_ps(&px[i]), y = _mm_loadu_ps(&py[i]), z = _mm_loadu_ps(&pz[i]);
+		__m128 velX = _mm_loadu_ps(&vx[i]), velY = _mm_loadu_ps(&vy[i]), velZ = _mm_loadu_ps(&vz[i]);
+		__m128 thrustX = _mm_loadu_ps(&tx[i]), thrustY = _mm_loadu_ps(&ty[i]), thrustZ = _mm_loadu_ps(&tz[i]);
+		_mm_storeu_ps(&sx[i], x);
+		_mm_storeu_ps(&sy[i], y);
+		_mm_storeu_ps(&sz[i], z);
+		_mm_storeu_ps(&px[i], _mm_add_ps(x, _mm_mul_ps(velX, vdt)));
+		_mm_storeu_ps(&py[i], _mm_add_ps(y, _mm_mul_ps(velY, vdt)));
+		_mm_storeu_ps(&pz[i], _mm_add_ps(z, _mm_mul_ps(velZ, vdt)));
+		__m128 accelY = _mm_sub_ps(thrustY, _mm_mul_ps(vGravity, _mm_loadu_ps(&flying[i])));
+		_mm_storeu_ps(&vx[i], _mm_mul_ps(_mm_add_ps(velX, _mm_mul_ps(thrustX, vdt)), vDamping));
+		_mm_storeu_ps(&vy[i], _mm_mul_ps(_mm_add_ps(velY, _mm_mul_ps(accelY, vdt)), vDamping));
+		_mm_storeu_ps(&vz[i], _mm_mul_ps(_mm_add_ps(velZ, _mm_mul_ps(thrustZ, vdt)), vDamping));
+		__m128 thrusting = _mm_or_ps(_mm_cmpneq_ps(thrustX, zero),
+			_mm_or_ps(_mm_cmpneq_ps(thrustY, zero), _mm_cmpneq_ps(thrustZ, zero)));
+		_mm_storeu_ps(&thrustTime[i], _mm_add_ps(_mm_loadu_ps(&thrustTime[i]), _mm_and_ps(thrusting, vdt)));
+	}
+#endif
+
+	for (; i < n; i++) {
+		sx[i] = px[i];
+		sy[i] = py[i];
+		sz[i] = pz[i];
+		px[i] += vx[i] * dt;
+		py[i] += vy[i] * dt;
+		pz[i] += vz[i] * dt;
+		vx[i] = (vx[i] + tx[i] * dt) * damping;
+		vy[i] = (vy[i] + (ty[i] - gravity * flying[i]) * dt) * damping;
+		vz[i] = (vz[i] + tz[i] * dt) * damping;
+		if (tx[i] != 0 || ty[i] != 0 || tz[i] != 0) thrustTime[i] += dt;
+	}
+
+	// out of fuel (rare, so a branch)
+	for (i = 0; i < n; i++) {
+		if (thrustTime[i] >= settings.maxThrustTime && state[i] == FlyingLander) {
+			state[i] = OutOfFuelLander;
+			flying[i] = 0;
+			vx[i] = vy[i] = vz[i] = 0;
+		}
+	}
+}
+
+//  Broad phase over all the landers, then the narrow phase for the few
+//  that may touch the terrain (see LanderPool.h).
+//
+void LanderPool::collide() {
+	int n = size();
+	candidates.clear();
+	if (!terrain) return;
+
+	Vector3 lo = localBounds.min(), hi = localBounds.max();
+	float terrainTop = heightField ? heightField->topY : terrain->bounds().max().y();
+	for (int i = 0; i < n; i++) {
+		if (state[i] != FlyingLander) continue;
+		float bottom = std::min(sy[i], py[i]) + lo.y();
+		if (bottom > terrainTop) continue;
+		if (heightField) {
+			float x0 = std::min(sx[i], px[i]) + lo.x(), x1 = std::max(sx[i], px[i]) + hi.x();
+			float z0 = std::min(sz[i], pz[i]) + lo.z(), z1 = std::max(sz[i], pz[i]) + hi.z();
+			if (bottom > heightField->maxHeight(x0, z0, x1, z1)) continue;
+		}
+		candidates.push_back(i);
+	}
+
+	for (int c = 0; c < candidates.size(); c++) {
+		int i = candidates[c];
+		glm::vec3 start(sx[i], sy[i], sz[i]);
+		glm::vec3 motion = position(i) - start;
+		Vector3 s(start.x, start.y, start.z);
+		SweepHit hit;
+		if (!terrain->sweep(Box(lo + s, hi + s), motion, hit)) continue;
+
+		// stop a little short, like LanderSim::sweepCollisions
+		float length = glm::length(motion);
+		float t = length > 0 ? std::max(0.0f, hit.t - 0.001f / length) : 0;
+		px[i] = start.x + motion.x * t;
+		py[i] = start.y + motion.y * t;
+		pz[i] = start.z + motion.z * t;
+		touchdown(i, hit.normal);
+	}
+}
+
+//  LanderSim::touchdown for lander i:  land, crash, or outside the zones
+//  at a gentle speed keep only the velocity along the surface
+//
+void LanderPool::touchdown(int i, const glm::vec3& normal) {
+	bool inAnyLandingZone = false;
+	glm::vec3 p = position(i);
+	for (int z = 0; z < landingZones.size(); z++) {
+		if (glm::distance(p, landingZones[z].center) < landingZones[z].radius) {
+			inAnyLandingZone = true;
+			break;
+		}
+	}
+
+	float verticalSpeed = vy[i];
+	bool gentleVerticalSpeed = fabs(verticalSpeed) < settings.landingSpeedThreshold;
+	touchdownSpeed[i] = fabs(verticalSpeed);
+	if (inAnyLandingZone && gentleVerticalSpeed && verticalSpeed <= 0) state[i] = LandedLander;
+	else if (inAnyLandingZone || !gentleVerticalSpeed) state[i] = CrashedLander;
+	else {
+		glm::vec3 v(vx[i], vy[i], vz[i]);
+		float into = glm::dot(v, normal);
+		if (into < 0) v -= normal * into;
+		vx[i] = v.x;
+		vy[i] = v.y;
+		vz[i] = v.z;
+		return;
+	}
+	flying[i] = 0;
+	vx[i] = vy[i] = vz[i] = 0;
+}
+
+int runLanderPool(const HeadlessSettings& settings, int count) {
+	HeadlessRunner world;
+	if (!world.loadWorld(settings)) return 1;
+	if (world.lander.landingZones.empty()) return 1;
+
+	LanderPool pool;
+	pool.terrain = world.terrainIndex;
+	pool.heightField = &world.heightField;
+	pool.landingZones = world.lander.landingZones;
+	pool.localBounds = world.rocketBounds;
+
+	// start somewhere around a zone, above the ground, like the Monte Carlo
+	// descents
+	std::mt19937 rng(settings.seed);
+	std::uniform_real_distribution<float> unit(0, 1);
+	auto start = [&](int zone) {
+		const LandingZone& z = pool.landingZones[zone];
+		float angle = unit(rng) * TWO_PI;
+		float distance = sqrt(unit(rng)) * 40;
+		glm::vec3 p = z.center + glm::vec3(cos(angle) * distance, 0, sin(angle) * distance);
+		GroundHit ground;
+		float groundY = world.heightField.groundAt(p.x, p.z, ground) ? ground.point.y : z.center.y;
+		p.y = groundY + 15 + unit(rng) * 45;
+		return p;
+	};
+	for (int i = 0; i < count; i++) {
+		int zone = rng() % pool.landingZones.size();
+		pool.add(start(zone), zone, 1 + unit(rng) * 11);
+	}
+
+	float dt = 1.0 / settings.rate;
+	int landed = 0, crashed = 0, outOfFuel = 0;
+	uint64_t candidates = 0;
+	uint64_t stepMicros = 0;
+	for (int s = 0; s < settings.steps; s++) {
+		uint64_t t1 = ofGetElapsedTimeMicros();
+		pool.step(dt);
+		stepMicros += ofGetElapsedTimeMicros() - t1;
+		candidates += pool.candidates.size();
+
+		// a new descent for each lander that is done (not timed)
+		for (int i = 0; i < pool.size(); i++) {
+			if (pool.state[i] == FlyingLander) continue;
+			landed += pool.state[i] == LandedLander;
+			crashed += pool.state[i] == CrashedLander;
+			outOfFuel += pool.state[i] == OutOfFuelLander;
+			int zone = rng() % pool.landingZones.size();
+			pool.reset(i, start(zone), zone);
+		}
+	}
+
+	double seconds = stepMicros / 1000000.0;
+	double landerSteps = (double)count * settings.steps;
+	cout << "lander pool: " << count << " landers on " << world.terrainIndex->name() << ", "
+		<< settings.steps << " steps of " << dt * 1000 << " ms" << endl;
+	cout << "  descents: landed " << landed << ", crashed " << crashed << ", out of fuel " << outOfFuel << endl;
+	cout << "  " << (settings.steps > 0 ? seconds * 1000 / settings.steps : 0) << " ms per step, "
+		<< (seconds > 0 ? landerSteps / seconds : 0) << " lander steps/sec, "
+		<< (settings.steps > 0 ? (double)candidates / settings.steps : 0) << " landers per step past the broad phase"
+		<< endl;
+	return 0;
+}
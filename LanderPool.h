@@ -0,0 +1,98 @@
+#pragma once
+//  Pierce Kyaw, Aye Thwe Tun
+//
+//  Many landers flown by an autopilot in one scene.  LanderSim is one rocket
+//  with all its state in members; here each part of the state is an array
+//  with one entry per lander (structure of arrays), so a step is a few
+//  loops over contiguous floats, which run 4 landers at a time with SSE
+//  (see simd.h).  No model or GL is involved; the game draws the landers
+//  as points.
+//
+//  The physics and landing rules are LanderSim's (same LanderSettings,
+//  always with explicit Euler), with the rocket's box and without the hover
+//  push:  a lander touching the terrain outside the zones slides along it.
+//  A step integrates every lander, then collides them with the terrain in a
+//  batch:
+//
+//    broad phase   the box each lander sweeps through in the step against
+//                  the tops of the height field's cells under it; most
+//                  landers are above the terrain and stop here
+//    narrow phase  the rest are swept through the terrain index
+//                  (SpatialIndex::sweep) and land, crash or slide where
+//                  they touch
+//
+//  Each lander flies to a landing zone (its target) like LandingAutopilot,
+//  without the gusts, and lands at its own descent speed.  Landers that
+//  landed, crashed or ran out of fuel stay where they are until reset().
+//
+
+#include "HeadlessRunner.h"
+
+typedef enum { FlyingLander, LandedLander, CrashedLander, OutOfFuelLander } LanderState;
+
+class LanderPool {
+public:
+
+	// add a lander at rest at "position", flying to landing zone "zone"
+	// at "descentSpeed".  Returns its index.
+	//
+	int add(const glm::vec3& position, int zone, float descentSpeed);
+	void clear();
+	int size() const { return px.size(); }
+
+	// start lander i again at rest at "position" with a full tank, flying
+	// to landing zone "zone"
+	//
+	void reset(int i, const glm::vec3& position, int zone);
+
+	// one step of dt seconds for every lander:  autopilot, motion, fuel,
+	// then collisions
+	//
+	void step(float dt);
+	void steer();
+	void integrate(float dt);
+	void collide();
+	void touchdown(int i, const glm::vec3& normal);
+
+	glm::vec3 position(int i) const { return glm::vec3(px[i], py[i], pz[i]); }
+	int count(LanderState s) const;
+
+	// the world, shared with the caller and not changed here
+	//
+	const SpatialIndex* terrain = nullptr;
+	const HeightField* heightField = nullptr;   // broad phase; all landers are swept if null
+	vector<LandingZone> landingZones;
+	Box localBounds;                            // every lander's box, relative to its position
+	LanderSettings settings;
+
+	// autopilot (see LandingAutopilot)
+	//
+	float gain = 1;
+	float maxSpeed = 5;                         // horizontal
+	float maxThrust = 20;
+
+	// state, one entry per lander
+	//
+	vector<float> px, py, pz;                   // position
+	vector<float> vx, vy, vz;                   // velocity
+	vector<float> tx, ty, tz;                   // thrust, from steer()
+	vector<float> sx, sy, sz;                   // position at the start of the step
+	vector<float> thrustTime;                   // sec of thrust used
+	vector<float> flying;                       // 1 while flying, 0 after (multiplies the motion)
+	vector<float> targetX, targetZ;             // zone center
+	vector<float> zoneRadius;
+	vector<float> descentSpeed;
+	vector<float> touchdownSpeed;
+	vector<unsigned char> state;                // LanderState
+
+	// the last step's broad phase:  landers it passed to the narrow phase
+	//
+	vector<int> candidates;
+};
+
+//  Load the world (HeadlessRunner::loadWorld), fly "count" landers for
+//  settings.steps steps, starting a new descent for each one that lands,
+//  crashes or runs out of fuel, and print the time per step.  Returns the
+//  program's exit code.
+//
+int runLanderPool(const HeadlessSettings& settings, int count);
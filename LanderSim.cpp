@@ -0,0 +1,296 @@
+//  Pierce Kyaw, Aye Thwe Tun
+
+#include "LanderSim.h"
+
+void LanderSim::reset(const glm::vec3& p) {
+	position = p;
+	velocity = glm::vec3(0, 0, 0);
+	acceleration = glm::vec3(0, 0, 0);
+	force = glm::vec3(0, 0, 0);
+	rotation = 0;
+	angularVelocity = 0;
+	angularAcceleration = 0;
+
+	thrustForce = glm::vec3(0, 0, 0);
+	angularForce = 0;
+	bThrust = false;
+
+	fuel = settings.startFuel;
+	totalThrustTime = 0;
+	bGrounded = false;
+	bOver = false;
+	bWin = false;
+	bCrashInLZ = false;
+	bNoFuel = false;
+	impactForce = 0;
+	touchdownSpeed = 0;
+	contactNormal = glm::vec3(0, 0, 0);
+	contactTime = -1;
+	time = 0;
+	events = NoEvent;
+
+	if (explosion) {
+		explosion->stop();
+		explosion->sys->reset();
+	}
+}
+
+void LanderSim::setThrust(const glm::vec3& thrust) {
+	if (thrust == glm::vec3(0, 0, 0) || fuel <= 0) {
+		bThrust = false;
+		thrustForce = glm::vec3(0, 0, 0);
+		return;
+	}
+	if (engine) {
+		engine->sys->reset();
+		engine->start();
+	}
+	bThrust = true;
+	thrustForce = thrust;
+}
+
+void LanderSim::step(float dt) {
+	// thrust from the inputs, replaced by any contact force
+	force = bOver ? glm::vec3(0, 0, 0) : thrustForce;
+
+	if (!bOver) checkCollisions();
+
+	if (engine) engine->update(dt);
+	if (explosion) explosion->update(dt);
+
+	// on the ground the rocket stays put
+	if (bGrounded) {
+		velocity = glm::vec3(0, 0, 0);
+		acceleration = glm::vec3(0, 0, 0);
+		force = glm::vec3(0, 0, 0);
+	}
+
+	// fuel is used while thrusting
+	if (bThrust && !bOver && fuel > 0) {
+		totalThrustTime += dt;
+
+		fuel = (1.0f - (totalThrustTime / settings.maxThrustTime)) * settings.startFuel;
+
+		if (fuel <= 0 || totalThrustTime >= settings.maxThrustTime) {
+			fuel = 0;
+			velocity = glm::vec3(0, 0, 0);
+			acceleration = glm::vec3(0, 0, 0);
+			force = glm::vec3(0, 0, 0);
+			bOver = true;
+			bNoFuel = true;
+			events |= OutOfFuelEvent;
+		}
+	}
+
+	// the explosion follows the rocket, the engine particles come out
+	// of its bottom
+	if (explosion) explosion->setPosition(position);
+	if (engine) engine->setPosition(glm::vec3(position.x, position.y + localBounds.min().y(), position.z));
+
+	glm::vec3 start = position;
+	integrate(dt);
+	if (settings.bSweepCollisions && !bOver) sweepCollisions(start, dt);
+	time += dt;
+}
+
+// The step's motion, from "start" to the new position, swept through the
+// terrain:  a rocket that would pass through the terrain in one step stops
+// where it first touches it, and lands or crashes there.  Outside the zones
+// it keeps only the part of its velocity along the surface.  With a
+// collider the box's sweep only says where the mesh may start to touch.
+//
+void LanderSim::sweepCollisions(const glm::vec3& start, float dt) {
+	if (!terrain) return;
+	glm::vec3 motion = position - start;
+	Box box = boundsAt(start, rotation);
+	SweepHit hit;
+	if (!terrain->sweep(box, motion, hit)) return;
+
+	// stop a little short so the boxes touch but don't overlap
+	float length = glm::length(motion);
+	float t = length > 0 ? std::max(0.0f, hit.t - 0.001f / length) : 0;
+	contactNormal = hit.normal;
+
+	// the box touches the terrain, but the mesh may touch it later in the
+	// step or not at all:  move the mesh on from there in moves of at most
+	// half the box's smallest side until it touches
+	if (collider && !collider->empty()) {
+		Vector3 size = box.max() - box.min();
+		float side = std::max(std::min(size.x(), std::min(size.y(), size.z())), 0.001f);
+		int moves = std::max(1, (int)ceil((1 - hit.t) * length / (side / 2)));
+		bool touched = false;
+		for (int i = 0; i <= moves && !touched; i++) {
+			t = hit.t + (1 - hit.t) * i / moves;
+			position = start + motion * t;
+			touched = touchesTerrain();
+		}
+		if (!touched) {
+			position = start + motion;
+			return;
+		}
+
+		// normal of the terrain face touched, facing against the motion
+		glm::vec3 v[3];
+		terrain->getFace(contacts[0].terrainFace, v);
+		contactNormal = glm::normalize(glm::cross(v[1] - v[0], v[2] - v[0]));
+		if (glm::dot(contactNormal, motion) > 0) contactNormal = -contactNormal;
+	}
+
+	position = start + motion * t;
+	contactTime = time + t * dt;
+	touchdown();
+	if (!bOver) {
+		float into = glm::dot(velocity, contactNormal);
+		if (into < 0) velocity -= contactNormal * into;
+	}
+}
+
+// Thrust (force) and gravity are held for the step.  Explicit Euler damps
+// the velocities by settings.damping per step, as the game always did; the
+// other integrators turn it into drag (Integrator::drag).
+//
+void LanderSim::integrate(float dt) {
+	glm::vec3 gravitationalForce(0, -settings.gravity, 0);
+	glm::vec3 accel = acceleration;
+	accel += ((force * 1.0) + gravitationalForce / settings.mass);
+	float a = angularAcceleration;
+	a += (angularForce / settings.mass);
+
+	float drag = settings.integrator == ExplicitEulerIntegrator ? 0 : Integrator::drag(settings.damping);
+	Integrator::step(settings.integrator, position, velocity, dt,
+		[&](const glm::vec3&, const glm::vec3& v) { return accel - v * drag; });
+	Integrator::step(settings.integrator, rotation, angularVelocity, dt,
+		[&](float, float v) { return a - v * drag; });
+
+	if (settings.integrator == ExplicitEulerIntegrator) {
+		velocity *= settings.damping;
+		angularVelocity *= settings.damping;
+	}
+}
+
+Box LanderSim::boundsAt(const glm::vec3& position, float rotation) const {
+	if (collider && !collider->empty()) return collider->bounds(position, rotation);
+	Vector3 p(position.x, position.y, position.z);
+	return Box(localBounds.min() + p, localBounds.max() + p);
+}
+
+// The narrow phase runs against the in-memory index also with a paged
+// terrain, since it needs the faces under the box
+//
+bool LanderSim::touchesTerrain() {
+	Box box = bounds();
+
+	// only whether the rocket touches the terrain is needed here, so use the
+	// early-exit query
+	bool touching = pagedTerrain ? pagedTerrain->overlap(box) : terrain->overlap(box);
+	if (!touching || !collider || collider->empty()) {
+		contacts.clear();
+		return touching;
+	}
+	return collider->collide(*terrain, position, rotation, contacts) > 0;
+}
+
+// Check collisions between rocket and terrain or landing zones
+//
+void LanderSim::checkCollisions() {
+	if (touchesTerrain()) touchdown();
+}
+
+// The rocket touches the terrain:  land, crash, or outside the zones at a
+// gentle speed, push back up
+//
+void LanderSim::touchdown() {
+	bool inAnyLandingZone = false;
+	for (int i = 0; i < landingZones.size(); i++) {
+		if (glm::distance(position, landingZones[i].center) < landingZones[i].radius) {
+			inAnyLandingZone = true;
+			break;
+		}
+	}
+
+	float verticalSpeed = velocity.y;
+	bool gentleVerticalSpeed = fabs(verticalSpeed) < settings.landingSpeedThreshold;
+	touchdownSpeed = fabs(verticalSpeed);
+
+	if (inAnyLandingZone && gentleVerticalSpeed && verticalSpeed <= 0) {
+		// gentle landing = success
+		bGrounded = true;
+		bWin = true;
+		bOver = true;
+		score += 500;
+		events |= LandedEvent;
+	}
+	else if (inAnyLandingZone || !gentleVerticalSpeed) {
+		// crash, inside or outside a zone
+		if (explosion) {
+			explosion->sys->reset();
+			explosion->start();
+		}
+		bGrounded = true;
+		bOver = true;
+		bCrashInLZ = inAnyLandingZone;
+		impactForce = (int)(fabs(verticalSpeed));
+		if (inAnyLandingZone) score += 250;
+		events |= CrashedEvent;
+	}
+	else {
+		// hovering outside the zones:  push back up so the rocket does not
+		// sink into the terrain
+		GroundHit ground;
+		if (heightField && heightField->groundBelow(position, ground)) {
+			force = glm::vec3(0, settings.hoverForce, 0);
+		}
+		return;
+	}
+
+	velocity = glm::vec3(0, 0, 0);
+	acceleration = glm::vec3(0, 0, 0);
+	force = glm::vec3(0, 0, 0);
+}
+
+// Randomly select landing zones on the terrain, and drop them onto the
+// surface
+//
+void LanderSim::placeLandingZones(int n) {
+	landingZones.resize(n);
+	int totalVerts = terrain->vertices.size();
+	for (int i = 0; i < n; i++) {
+		int randomIndex = (int)ofRandom(0, totalVerts);
+		glm::vec3 randomVertex = terrain->vertices[randomIndex];
+		GroundHit ground;
+		landingZones[i].center = randomVertex;
+		landingZones[i].radius = 5.0;
+		if (heightField && heightField->groundAt(randomVertex.x, randomVertex.z, ground)) {
+			landingZones[i].center = ground.point;
+		}
+	}
+}
+
+void LanderSim::setupEmitters(ParticleEmitter& engine, ParticleEmitter& explosion) {
+	// forces for the particle systems, shared by all the emitters set up
+	// here and kept for the life of the program
+	static TurbulenceForce* tForce = new TurbulenceForce(ofVec3f(-20, -20, -20), ofVec3f(20, 20, 20));
+	static GravityForce* gForce = new GravityForce(ofVec3f(0, -10, 0));
+	static ImpulseRadialForce* iForce = new ImpulseRadialForce(1000.0);
+
+	// engine
+	engine.setOneShot(true);
+	engine.setEmitterType(RadialEmitter);
+	engine.setGroupSize(10);
+	engine.particleRadius = .0001;
+	engine.spawn(1);
+	engine.setParticleRadius(0.5);
+	engine.setRate(0.5);
+	engine.setLifespan(1.0);
+	engine.sys->addForce(tForce);
+	engine.sys->addForce(gForce);
+	engine.setVelocity(ofVec3f(0, 5, 0));
+
+	// explosions
+	explosion.setOneShot(true);
+	explosion.setEmitterType(RadialEmitter);
+	explosion.setGroupSize(100);
+	explosion.setParticleRadius(0.5);
+	explosion.setLifespan(2.0);
+	explosion.sys->addForce(iForce);
+}
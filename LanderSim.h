@@ -0,0 +1,137 @@
+#pragma once
+//  Pierce Kyaw, Aye Thwe Tun
+//
+//  The lander simulation, without the window:  the rocket's motion, fuel,
+//  its collisions with the terrain and the landing zones, and the engine and
+//  explosion particles.  Nothing here draws, plays sounds or needs a GL
+//  context.  ofApp feeds it the keys and draws it; the headless runner
+//  (HeadlessRunner.h) feeds it a script.
+//
+//  The rocket is the axis aligned box localBounds, placed at its position.
+//  The box does not turn with the rocket.  With a collider the rocket is
+//  its mesh instead:  the box around the turned mesh is the broad phase,
+//  and a contact only counts where the mesh crosses a terrain face.
+//  Collisions are tested where the rocket is at the start of each step,
+//  and its motion during the step is swept through the terrain
+//  (SpatialIndex::sweep), so it cannot pass through a ridge between two
+//  steps however fast it moves.
+//
+
+#include "ofMain.h"
+#include "SpatialIndex.h"
+#include "HeightField.h"
+#include "PagedOctree.h"
+#include "ParticleEmitter.h"
+#include "RocketCollider.h"
+#include "Integrator.h"
+
+class LandingZone {
+public:
+	glm::vec3 center = glm::vec3(0, 0, 0);
+	float radius = 5.0;
+};
+
+//  What happened in the steps since LanderSim::events was last cleared
+//  (bits, so the caller can react once per frame, e.g. with a sound).
+//
+typedef enum { NoEvent = 0, LandedEvent = 1, CrashedEvent = 2, OutOfFuelEvent = 4 } LanderEvent;
+
+class LanderSettings {
+public:
+	float gravity = 1.62;               // moon
+	float mass = 1.0;
+	float damping = .99;                // of velocities, per step (see Integrator.h)
+	IntegratorType integrator = ExplicitEulerIntegrator;
+	float startFuel = 120;
+	float maxThrustTime = 120;          // sec of thrust in a full tank
+	float landingSpeedThreshold = 8.0;  // fastest gentle touch down
+	float hoverForce = 10;              // pushes back off the terrain outside the zones
+	bool bSweepCollisions = true;       // sweep each step's motion through the terrain,
+	                                    // so fast or large steps can't pass through it
+};
+
+class LanderSim {
+public:
+
+	// start at rest at "position" with a full tank.  The score is kept.
+	//
+	void reset(const glm::vec3& position);
+
+	// one step of dt seconds:  collisions, particles, fuel, then motion
+	// (swept through the terrain, see sweepCollisions())
+	//
+	void step(float dt);
+	void integrate(float dt);
+	void checkCollisions();
+	void sweepCollisions(const glm::vec3& start, float dt);
+	void touchdown();
+
+	// thrust for the following steps (zero to stop).  Fires the engine
+	// particles, like a key press.
+	//
+	void setThrust(const glm::vec3& thrust);
+
+	// put "n" landing zones on random vertices of the terrain
+	//
+	void placeLandingZones(int n = 3);
+
+	// box of the rocket, at its pose or another one
+	//
+	Box bounds() const { return boundsAt(position, rotation); }
+	Box boundsAt(const glm::vec3& position, float rotation) const;
+
+	// true if the rocket at its pose touches the terrain:  the broad phase,
+	// then the collider's exact test if there is one (contacts gets the
+	// contact points)
+	//
+	bool touchesTerrain();
+
+	// the engine and explosion particles, set up the way the game shows them
+	//
+	static void setupEmitters(ParticleEmitter& engine, ParticleEmitter& explosion);
+
+	// the world, shared with the caller and not changed here
+	//
+	const SpatialIndex* terrain = nullptr;
+	PagedOctree* pagedTerrain = nullptr;        // used for collisions instead of terrain if set
+	const HeightField* heightField = nullptr;
+	vector<LandingZone> landingZones;
+	Box localBounds;                            // rocket's box, relative to its position
+	const RocketCollider* collider = nullptr;   // the rocket's mesh, if set
+
+	ParticleEmitter* engine = nullptr;          // not updated if null
+	ParticleEmitter* explosion = nullptr;
+
+	LanderSettings settings;
+
+	// inputs, held until changed
+	//
+	glm::vec3 thrustForce = glm::vec3(0, 0, 0);
+	float angularForce = 0;
+	bool bThrust = false;
+
+	// state
+	//
+	glm::vec3 position = glm::vec3(0, 0, 0);
+	glm::vec3 velocity = glm::vec3(0, 0, 0);
+	glm::vec3 acceleration = glm::vec3(0, 0, 0);
+	glm::vec3 force = glm::vec3(0, 0, 0);       // total of the last step
+	float rotation = 0;                         // about y, degrees
+	float angularVelocity = 0;
+	float angularAcceleration = 0;
+	int fuel = 0;
+	float totalThrustTime = 0;
+	bool bGrounded = false;
+	bool bOver = false;
+	bool bWin = false;
+	bool bCrashInLZ = false;
+	bool bNoFuel = false;
+	int impactForce = 0;
+	float touchdownSpeed = 0;                   // vertical, of the landing or crash
+	glm::vec3 contactNormal = glm::vec3(0, 0, 0);   // of the last swept contact
+	double contactTime = -1;                    // when it happened, -1 for none
+	vector<RocketContact> contacts;             // of the mesh, from the last test
+	int score = 0;
+	double time = 0;                            // simulated sec since reset()
+	int events = NoEvent;
+};
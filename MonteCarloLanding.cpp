@@ -0,0 +1,204 @@
+//  Pierce Kyaw, Aye Thwe Tun
+
+#include "MonteCarloLanding.h"
+#include <atomic>
+#include <thread>
+
+glm::vec3 LandingAutopilot::thrust(const LanderSim& sim) {
+	glm::vec3 toTarget = target - sim.position;
+	toTarget.y = 0;
+	float distance = glm::length(toTarget);
+
+	// velocity wanted:  toward the target, slower when close, and down once
+	// well inside the zone
+	const float maxSpeed = 5;
+	glm::vec3 wanted = toTarget * (0.5f * gain);
+	if (glm::length(wanted) > maxSpeed) wanted = glm::normalize(wanted) * maxSpeed;
+	wanted.y = distance < zoneRadius * 0.5f ? -descentSpeed : 0;
+
+	// thrust is an acceleration in LanderSim::integrate, so holding the
+	// rocket up takes gravity's
+	glm::vec3 f = (wanted - sim.velocity) * (2 * gain);
+	f.y += sim.settings.gravity / sim.settings.mass;
+
+	if (gust > 0) {
+		std::normal_distribution<float> noise(0, gust);
+		f += glm::vec3(noise(rng), noise(rng), noise(rng));
+	}
+
+	float magnitude = glm::length(f);
+	if (magnitude > maxThrust) f *= maxThrust / magnitude;
+	return f;
+}
+
+DescentResult MonteCarloLanding::fly(const HeadlessRunner& world, const MonteCarloSettings& settings, int descent) {
+	std::seed_seq seed{ settings.seed, (unsigned int)descent };
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> unit(0, 1);
+
+	LanderSim sim;
+	sim.terrain = world.terrainIndex;
+	sim.heightField = &world.heightField;
+	sim.landingZones = world.lander.landingZones;
+	sim.localBounds = world.rocketBounds;
+	sim.collider = world.lander.collider;
+	sim.settings = settings.lander;
+
+	// start somewhere around a zone, above the ground, drifting
+	const LandingZone& zone = sim.landingZones[rng() % sim.landingZones.size()];
+	float angle = unit(rng) * TWO_PI;
+	float distance = sqrt(unit(rng)) * settings.maxStartDistance;
+	glm::vec3 start = zone.center + glm::vec3(cos(angle) * distance, 0, sin(angle) * distance);
+	GroundHit ground;
+	float groundY = world.heightField.groundAt(start.x, start.z, ground) ? ground.point.y : zone.center.y;
+	start.y = groundY + settings.minStartHeight + unit(rng) * (settings.maxStartHeight - settings.minStartHeight);
+	sim.reset(start);
+	glm::vec3 drift(unit(rng) - 0.5f, unit(rng) - 0.5f, unit(rng) - 0.5f);
+	if (glm::length(drift) > 0) sim.velocity = glm::normalize(drift) * (unit(rng) * settings.maxStartSpeed);
+
+	// a pilot of random skill
+	LandingAutopilot pilot;
+	pilot.target = zone.center;
+	pilot.zoneRadius = zone.radius;
+	pilot.descentSpeed = 1 + unit(rng) * 11;
+	pilot.gain = 0.5f + unit(rng) * 1.5f;
+	pilot.gust = unit(rng) * 3;
+	pilot.maxThrust = settings.maxThrust;
+	pilot.rng.seed(rng());
+
+	float dt = 1.0 / settings.rate;
+	while (!sim.bOver && sim.time < settings.maxFlightTime) {
+		sim.setThrust(pilot.thrust(sim));
+		sim.step(dt);
+	}
+
+	DescentResult result;
+	if (sim.bWin) result.outcome = LandedOutcome;
+	else if (sim.bNoFuel) result.outcome = OutOfFuelOutcome;
+	else if (sim.bOver) result.outcome = sim.bCrashInLZ ? CrashedInZoneOutcome : CrashedOutcome;
+	else result.outcome = MissedOutcome;
+	result.touchdownSpeed = sim.bGrounded ? sim.touchdownSpeed : 0;
+	result.fuelUsed = sim.totalThrustTime / sim.settings.maxThrustTime * sim.settings.startFuel;
+	result.flightTime = sim.time;
+	return result;
+}
+
+//  Descents are handed out from a shared counter, so a thread that flies a
+//  short descent moves on to the next one.  Each result goes to its own
+//  slot, so the threads share nothing they write.
+//
+void MonteCarloLanding::run(const HeadlessRunner& world, const MonteCarloSettings& s) {
+	settings = s;
+	indexName = world.terrainIndex->name();
+	results.assign(settings.descents, DescentResult());
+	if (settings.descents <= 0 || world.lander.landingZones.empty()) return;
+
+	std::atomic<int> next(0);
+	auto worker = [&]() {
+		for (int i = next++; i < settings.descents; i = next++) {
+			results[i] = fly(world, settings, i);
+		}
+	};
+
+	numThreads = settings.numThreads > 0 ? settings.numThreads : std::thread::hardware_concurrency();
+	numThreads = std::max(1, std::min(numThreads, settings.descents));
+
+	uint64_t t1 = ofGetElapsedTimeMicros();
+	vector<std::thread> pool;
+	for (int i = 1; i < numThreads; i++) {
+		pool.emplace_back(worker);
+	}
+	worker();
+	for (int i = 0; i < pool.size(); i++) {
+		pool[i].join();
+	}
+	uint64_t t2 = ofGetElapsedTimeMicros();
+
+	wallSeconds = (t2 - t1) / 1000000.0;
+	simSeconds = 0;
+	for (int i = 0; i < results.size(); i++) {
+		simSeconds += results[i].flightTime;
+	}
+}
+
+// value below which "fraction" of the sorted values lie
+//
+static float percentile(const vector<float>& sorted, float fraction) {
+	if (sorted.empty()) return 0;
+	int i = std::min((int)(fraction * sorted.size()), (int)sorted.size() - 1);
+	return sorted[i];
+}
+
+static float mean(const vector<float>& values) {
+	double sum = 0;
+	for (int i = 0; i < values.size(); i++) sum += values[i];
+	return values.empty() ? 0 : sum / values.size();
+}
+
+static void printDistribution(const char* name, vector<float>& values) {
+	std::sort(values.begin(), values.end());
+	cout << "  " << name << ":  mean " << mean(values) << ", median " << percentile(values, 0.5f)
+		<< ", 90% " << percentile(values, 0.9f) << ", 99% " << percentile(values, 0.99f)
+		<< ", max " << (values.empty() ? 0 : values.back()) << endl;
+}
+
+void MonteCarloLanding::print() const {
+	int counts[5] = { 0 };
+	vector<float> touchdown, fuel;
+	for (int i = 0; i < results.size(); i++) {
+		counts[results[i].outcome]++;
+		if (results[i].outcome != MissedOutcome && results[i].outcome != OutOfFuelOutcome) {
+			touchdown.push_back(results[i].touchdownSpeed);
+		}
+		fuel.push_back(results[i].fuelUsed);
+	}
+
+	int n = std::max(1, (int)results.size());
+	cout << "monte carlo:  " << results.size() << " descents on " << indexName << ", "
+		<< numThreads << " threads, " << settings.rate << " steps/sec" << endl;
+	cout << "  landing speed threshold " << settings.lander.landingSpeedThreshold
+		<< ", fuel for " << settings.lander.maxThrustTime << " sec of thrust, thrust limit "
+		<< settings.maxThrust << endl;
+	const char* names[5] = { "landed", "crashed", "crashed in a zone", "out of fuel", "missed" };
+	cout << " ";
+	for (int i = 0; i < 5; i++) {
+		cout << " " << names[i] << " " << counts[i] << " (" << 100.0 * counts[i] / n << "%)" << (i < 4 ? "," : "");
+	}
+	cout << endl;
+
+	// touchdown speeds in 1 m/s buckets, x where the bucket reaches past
+	// the landing speed threshold
+	printDistribution("touchdown speed", touchdown);
+	if (!touchdown.empty()) {
+		int numBuckets = std::min(30, (int)touchdown.back() + 1);
+		vector<int> buckets(numBuckets, 0);
+		int most = 1;
+		for (int i = 0; i < touchdown.size(); i++) {
+			int b = std::min((int)touchdown[i], numBuckets - 1);
+			most = std::max(most, ++buckets[b]);
+		}
+		for (int b = 0; b < numBuckets; b++) {
+			string range = ofToString(b) + "-" + ofToString(b + 1);
+			cout << "    " << range << string(6 - range.size(), ' ')
+				<< (b + 1 > settings.lander.landingSpeedThreshold ? "x " : "  ")
+				<< string(40 * buckets[b] / most, '#') << " " << buckets[b] << endl;
+		}
+	}
+	printDistribution("fuel used", fuel);
+
+	double steps = simSeconds * settings.rate;
+	cout << "  " << simSeconds << " simulated sec in " << wallSeconds << " sec:  "
+		<< (wallSeconds > 0 ? simSeconds / wallSeconds : 0) << " simulated sec per sec, "
+		<< (wallSeconds > 0 ? steps / wallSeconds : 0) << " steps/sec" << endl;
+}
+
+int runMonteCarlo(const HeadlessSettings& worldSettings, const MonteCarloSettings& settings) {
+	HeadlessRunner world;
+	if (!world.loadWorld(worldSettings)) return 1;
+	world.terrainIndex->bCountQueries = false;
+
+	MonteCarloLanding monteCarlo;
+	monteCarlo.run(world, settings);
+	monteCarlo.print();
+	return 0;
+}
@@ -0,0 +1,90 @@
+#pragma once
+//  Pierce Kyaw, Aye Thwe Tun
+//
+//  Monte Carlo evaluation of the landing rules (thrust limit, landing speed
+//  threshold, fuel), for tuning them without playing the game by hand.
+//
+//  Thousands of descents are flown on all cores, each by its own LanderSim.
+//  The landers share one terrain index, height field and set of landing
+//  zones (a HeadlessRunner's world) and only read them, so query counting
+//  must be off.  Each descent starts at a random point near a landing zone
+//  and is flown by a LandingAutopilot with random gains, descent speed and
+//  gusts.  Everything random in a descent comes from its own seed, so the
+//  results do not depend on the number of threads.
+//
+//  main.cpp runs it for --montecarlo <descents>.
+//
+
+#include "HeadlessRunner.h"
+#include <random>
+
+class MonteCarloSettings {
+public:
+	int descents = 1000;
+	int numThreads = 0;                 // 0 = one per core
+	float rate = 60;                    // steps per simulated second
+	float maxFlightTime = 120;          // sec, then the descent counts as missed
+	float maxThrust = 20;               // the autopilot's thrust limit
+	LanderSettings lander;              // landing speed threshold, fuel, ...
+	float maxStartDistance = 40;        // from the zone, horizontally
+	float minStartHeight = 15;          // above the ground
+	float maxStartHeight = 60;
+	float maxStartSpeed = 3;
+	unsigned int seed = 1;
+};
+
+//  Flies over a target (a landing zone) and down at a set speed.  The
+//  horizontal speed is steered toward the target, the vertical speed toward
+//  -descentSpeed once over the zone (0 before), and random gusts are added
+//  to the thrust, which is limited to maxThrust.
+//
+class LandingAutopilot {
+public:
+	glm::vec3 target = glm::vec3(0, 0, 0);
+	float zoneRadius = 5;
+	float descentSpeed = 2;
+	float gain = 1;
+	float gust = 0;                     // standard deviation of the thrust noise
+	float maxThrust = 20;
+	std::mt19937 rng;
+
+	glm::vec3 thrust(const LanderSim& sim);
+};
+
+typedef enum { LandedOutcome, CrashedOutcome, CrashedInZoneOutcome, OutOfFuelOutcome, MissedOutcome } LandingOutcome;
+
+class DescentResult {
+public:
+	LandingOutcome outcome = MissedOutcome;
+	float touchdownSpeed = 0;           // vertical, 0 if the rocket never touched down
+	float fuelUsed = 0;                 // in LanderSim::fuel units
+	float flightTime = 0;               // sec
+};
+
+class MonteCarloLanding {
+public:
+
+	// fly descent number "descent" against the world's terrain
+	//
+	static DescentResult fly(const HeadlessRunner& world, const MonteCarloSettings& settings, int descent);
+
+	// fly settings.descents descents on settings.numThreads threads
+	//
+	void run(const HeadlessRunner& world, const MonteCarloSettings& settings);
+
+	// landing rate, touchdown speed and fuel distributions and throughput
+	//
+	void print() const;
+
+	MonteCarloSettings settings;
+	vector<DescentResult> results;      // in descent order
+	int numThreads = 0;
+	double simSeconds = 0;
+	double wallSeconds = 0;
+	string indexName;
+};
+
+//  Load the world (HeadlessRunner::loadWorld) and run and print the
+//  descents.  Returns the program's exit code.
+//
+int runMonteCarlo(const HeadlessSettings& world, const MonteCarloSettings& settings);
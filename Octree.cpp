@@ -11,22 +11,15 @@
 
 
 #include "Octree.h"
+#include <atomic>
+#include <thread>
 
-
-
-//draw a box from a "Box" class  
+// definitions of the constants std::min and cout take by reference
 //
-void Octree::drawBox(const Box& box) {
-	Vector3 min = box.parameters[0];
-	Vector3 max = box.parameters[1];
-	Vector3 size = max - min;
-	Vector3 center = size / 2 + min;
-	ofVec3f p = ofVec3f(center.x(), center.y(), center.z());
-	float w = size.x();
-	float h = size.y();
-	float d = size.z();
-	ofDrawBox(p, w, h, d);
-}
+const int Octree::MaxLevels;
+const int Octree::MaxMortonLevels;
+const int Octree::PacketSize;
+
 
 // return a Mesh Bounding Box for the entire Mesh
 //
@@ -52,46 +45,49 @@ Box Octree::meshBounds(const ofMesh& mesh) {
 	return Box(Vector3(min.x, min.y, min.z), Vector3(max.x, max.y, max.z));
 }
 
-// getMeshPointsInBox:  return an array of indices to points in mesh that are contained 
-//                      inside the Box.  Return count of points found;
+bool Octree::validNodes(const TreeNode* nodes, int numNodes, int numIndices, bool bInnerRanges) {
+	for (int i = 0; i < numNodes; i++) {
+		const TreeNode& n = nodes[i];
+		if ((n.isLeaf() || bInnerRanges) && (n.begin < 0 || n.begin > n.end || n.end > numIndices)) return false;
+		if (!n.isLeaf() && (n.firstChild <= i || n.firstChild > numNodes - n.numChildren())) return false;
+	}
+	vector<int> depth;
+	nodeDepths(numNodes, [nodes](int i) { return std::make_pair(nodes[i].firstChild, nodes[i].numChildren()); }, depth);
+	for (int i = 0; i < numNodes; i++) {
+		if (depth[i] >= MaxLevels) return false;
+	}
+	return true;
+}
+
+// return the 3 vertices of a face.  Meshes without indices store each
+// triangle as 3 consecutive vertices.
 //
-int Octree::getMeshPointsInBox(const ofMesh& mesh, const vector<int>& points,
-	Box& box, vector<int>& pointsRtn)
-{
-	int count = 0;
-	for (int i = 0; i < points.size(); i++) {
-		ofVec3f v = mesh.getVertex(points[i]);
-		if (box.inside(Vector3(v.x, v.y, v.z))) {
-			count++;
-			pointsRtn.push_back(points[i]);
-		}
+void Octree::getFace(const ofMesh& mesh, int face, glm::vec3 v[3]) {
+	for (int k = 0; k < 3; k++) {
+		int i = 3 * face + k;
+		v[k] = mesh.getVertex(mesh.getNumIndices() > 0 ? mesh.getIndex(i) : i);
 	}
-	return count;
 }
 
-// getMeshFacesInBox:  return an array of indices to Faces in mesh that are contained 
-//                      inside the Box.  Return count of faces found;
-//
-int Octree::getMeshFacesInBox(const ofMesh& mesh, const vector<int>& faces,
-	Box& box, vector<int>& facesRtn)
-{
-	int count = 0;
-	for (int i = 0; i < faces.size(); i++) {
-		ofMeshFace face = mesh.getFace(faces[i]);
-		ofVec3f v[3];
-		v[0] = face.getVertex(0);
-		v[1] = face.getVertex(1);
-		v[2] = face.getVertex(2);
-		Vector3 p[3];
-		p[0] = Vector3(v[0].x, v[0].y, v[0].z);
-		p[1] = Vector3(v[1].x, v[1].y, v[1].z);
-		p[2] = Vector3(v[2].x, v[2].y, v[2].z);
-		if (box.inside(p, 3)) {
-			count++;
-			facesRtn.push_back(faces[i]);
-		}
-	}
-	return count;
+int Octree::getNumFaces(const ofMesh& mesh) {
+	int n = mesh.getNumIndices() > 0 ? mesh.getNumIndices() : mesh.getNumVertices();
+	return n / 3;
+}
+
+// grow a box so it contains all the given faces
+//
+Box Octree::growToFaces(const int* faces, int count, const Box& box) const {
+	glm::vec3 min(box.min().x(), box.min().y(), box.min().z());
+	glm::vec3 max(box.max().x(), box.max().y(), box.max().z());
+	for (int i = 0; i < count; i++) {
+		glm::vec3 v[3];
+		getFace(faces[i], v);
+		for (int k = 0; k < 3; k++) {
+			min = glm::min(min, v[k]);
+			max = glm::max(max, v[k]);
+		}
+	}
+	return Box(Vector3(min.x, min.y, min.z), Vector3(max.x, max.y, max.z));
 }
 
 //  Subdivide a Box into eight(8) equal size boxes, return them in boxList;
@@ -126,7 +122,7 @@ void Octree::subDivideBox8(const Box& box, vector<Box>& boxList) {
 	}
 }
 
-void Octree::create(const ofMesh& geo, int numLevels) {
+void Octree::create(const ofMesh& geo, int numLevels, OctreeBuilder builder) {
 
 	// Initialize the colors array
 	colors = std::vector<ofColor>{ ofColor::red, ofColor::green, ofColor::blue, ofColor::yellow, ofColor::cyan, ofColor::magenta };
@@ -136,22 +132,244 @@ void Octree::create(const ofMesh& geo, int numLevels) {
 
 
 	mesh = geo;
+	vertices = ArrayView<glm::vec3>(mesh.getVertices());
+	meshIndices = ArrayView<ofIndexType>(mesh.getIndices());
+	invalidateLines();
 	int level = 0;
-	root.box = meshBounds(mesh);
+	numLevels = std::min(numLevels, MaxLevels);
+	nodeStore.clear();
+	nodeStore.push_back(TreeNode());
+	nodeStore[0].box = meshBounds(mesh);
+
+	// indices holds every vertex (or face) once; the build reorders it so the
+	// points of each node are the range [begin, end).  Points are sorted by
+	// their position, faces by their center.
+	//
+	vector<glm::vec3> centers;
+	const glm::vec3* keys;
+	int count;
 	if (!bUseFaces) {
-		for (int i = 0; i < mesh.getNumVertices(); i++) {
-			root.points.push_back(i);
+		count = vertices.size();
+		keys = vertices.data();
+	}
+	else {
+		count = getNumFaces();
+		centers.resize(count);
+		for (int i = 0; i < count; i++) {
+			glm::vec3 v[3];
+			getFace(i, v);
+			centers[i] = (v[0] + v[1] + v[2]) / 3.0f;
 		}
+		keys = centers.data();
+	}
+	indexStore.resize(count);
+	for (int i = 0; i < count; i++) {
+		indexStore[i] = i;
+	}
+	nodeStore[0].begin = 0;
+	nodeStore[0].end = count;
+
+	uint64_t start = ofGetElapsedTimeMicros();
+	this->builder = builder;
+	if (builder == MortonBuilder) {
+		levels = std::min(numLevels, MaxMortonLevels);
+		buildMorton(keys, levels);
 	}
 	else {
-		// need to load face vertices here
+		// build the top levels here; the subtrees below parallelLevel are
+		// independent and are built by buildSubtrees()
 		//
+		level++;
+		levels = numLevels;
+		vector<int> subtrees;
+		subdivide(keys, nodeStore, 0, numLevels, level, &subtrees);
+		buildSubtrees(keys, subtrees, numLevels);
 	}
 
-	// recursively buid octree
+	nodes = ArrayView<TreeNode>(nodeStore);
+	indices = ArrayView<int>(indexStore);
+	buildMillis = (ofGetElapsedTimeMicros() - start) / 1000.0f;
+}
+
+IndexStats Octree::getStats() const {
+	IndexStats stats;
+	stats.nodeBytes = nodes.size() * sizeof(TreeNode);
+	stats.indexBytes = indices.size() * sizeof(int);
+	stats.meshBytes = vertices.size() * sizeof(glm::vec3) + meshIndices.size() * sizeof(ofIndexType);
+	stats.buildMillis = buildMillis;
+
+	vector<int> depth;
+	nodeDepths(nodes.size(), [this](int i) { return std::make_pair(nodes[i].firstChild, nodes[i].numChildren()); }, depth);
+	for (int i = 0; i < nodes.size(); i++) {
+		stats.addNode(depth[i], nodes[i].isLeaf(), nodes[i].numPoints());
+	}
+	stats.finish();
+	return stats;
+}
+
+// sort codes (and the values that go with them) with an LSD radix sort,
+// 8 bits per pass.  Only the low "bits" bits of the codes are sorted.
+//
+static void radixSort(vector<uint64_t>& codes, vector<int>& values, int bits) {
+	int n = codes.size();
+	vector<uint64_t> codesTmp(n);
+	vector<int> valuesTmp(n);
+	for (int shift = 0; shift < bits; shift += 8) {
+		int count[257] = { 0 };
+		for (int i = 0; i < n; i++) {
+			count[((codes[i] >> shift) & 0xff) + 1]++;
+		}
+		for (int d = 0; d < 256; d++) {
+			count[d + 1] += count[d];
+		}
+		for (int i = 0; i < n; i++) {
+			int dst = count[(codes[i] >> shift) & 0xff]++;
+			codesTmp[dst] = codes[i];
+			valuesTmp[dst] = values[i];
+		}
+		codes.swap(codesTmp);
+		values.swap(valuesTmp);
+	}
+}
+
+//
+// buildMorton:  build the tree from Morton codes instead of by repeated
+//               splitting.
+//
+//  1) quantize every key to maxDepth bits per axis inside the root box
+//  2) interleave the bits into a code, 3 bits per level, most significant
+//     level first.  Each 3 bit digit is the octant number used by
+//     subDivideBox8(), so sorting by code sorts the points of every node
+//     by octant.
+//  3) radix sort the codes along with "indices" (30 bit codes need 4
+//     passes, 63 bit codes 8)
+//  4) now the points of every node are a contiguous run of codes with the
+//     same prefix, so nodes are read off the sorted codes (emitMorton())
+//
+void Octree::buildMorton(const glm::vec3* keys, int numLevels) {
+	int maxDepth = numLevels - 1;
+	int n = indexStore.size();
+	if (maxDepth <= 0 || n == 0) return;
+
+	// octant number for the bits (x << 2 | y << 1 | z), where a bit is 1 for
+	// the high half of that axis
 	//
-	level++;
-	subdivide(mesh, root, numLevels, level);
+	static const int octant[8] = {
+		0, 3, 4, 7,      // low x
+		1, 2, 5, 6       // high x
+	};
+
+	Vector3 min = nodeStore[0].box.min();
+	Vector3 size = nodeStore[0].box.max() - min;
+	float cells = (float)(1 << maxDepth);
+	float scale[3];
+	for (int k = 0; k < 3; k++) {
+		scale[k] = size[k] > 0 ? cells / size[k] : 0;
+	}
+
+	vector<uint64_t> codes(n);
+	for (int i = 0; i < n; i++) {
+		const glm::vec3& p = keys[indexStore[i]];
+		uint32_t q[3];
+		for (int k = 0; k < 3; k++) {
+			float f = (p[k] - min[k]) * scale[k];
+			q[k] = f <= 0 ? 0 : std::min((uint32_t)f, (uint32_t)cells - 1);
+		}
+		uint64_t code = 0;
+		for (int bit = maxDepth - 1; bit >= 0; bit--) {
+			int x = (q[0] >> bit) & 1;
+			int y = (q[1] >> bit) & 1;
+			int z = (q[2] >> bit) & 1;
+			code = (code << 3) | octant[(x << 2) | (y << 1) | z];
+		}
+		codes[i] = code;
+	}
+
+	radixSort(codes, indexStore, 3 * maxDepth);
+	if (canSplit(nodeStore[0])) emitMorton(codes, 0, nodeStore[0].box, 0, maxDepth);
+}
+
+//
+// emitMorton:  create the children of a node from the sorted codes.
+//
+//  The points of the node are codes[begin, end); the octant of each point at
+//  the next level is the next 3 bit digit of its code, so the children are
+//  found by binary search for where the digit changes.  Children are
+//  appended as a contiguous run like subdivide() does, and use the same
+//  termination rules.  "cell" is the node's octant box (before it is grown to fit
+//  faces).
+//
+void Octree::emitMorton(const vector<uint64_t>& codes, int node, const Box& cell,
+	int depth, int maxDepth) {
+	if (depth >= maxDepth) return;
+
+	vector<Box> childBoxes;
+	subDivideBox8(cell, childBoxes);
+
+	int shift = 3 * (maxDepth - depth - 1);
+	int begin = nodeStore[node].begin;
+	int end = nodeStore[node].end;
+
+	TreeNode children[8];
+	int numChildren = 0;
+	unsigned char childMask = 0;
+	int b = begin;
+	while (b < end) {
+		int digit = (codes[b] >> shift) & 7;
+		uint64_t next = ((codes[b] >> shift) + 1) << shift;
+		int e = std::lower_bound(codes.begin() + b, codes.begin() + end, next) - codes.begin();
+
+		TreeNode& childNode = children[numChildren++];
+		childNode.box = childBoxes[digit];
+		childNode.begin = b;
+		childNode.end = e;
+		if (bUseFaces) {
+			childNode.box = growToFaces(&indexStore[b], e - b, childBoxes[digit]);
+		}
+		childMask |= (1 << digit);
+		b = e;
+	}
+	if (!splitPaysOff(nodeStore[node].box, children, numChildren)) return;
+
+	int firstChild = nodeStore.size();
+	nodeStore.insert(nodeStore.end(), children, children + numChildren);
+	nodeStore[node].firstChild = firstChild;
+	nodeStore[node].childMask = childMask;
+
+	for (int i = 0, octant = 0; i < numChildren; octant++) {
+		if (!(childMask & (1 << octant))) continue;
+		if (canSplit(nodeStore[firstChild + i])) {
+			emitMorton(codes, firstChild + i, childBoxes[octant], depth + 1, maxDepth);
+		}
+		i++;
+	}
+}
+
+//
+// partition:  reorder indices[begin, end) by octant of the node box (see
+//             subDivideBox8() for the octant order).  On return the points
+//             of octant i are in [bounds[i], bounds[i + 1]).
+//
+//  Three in-place passes split by y, then z, then x; no memory is allocated.
+//
+void Octree::partition(const glm::vec3* keys, int begin, int end, const Box& box, int bounds[9]) {
+	Vector3 c = box.center();
+	int* first = indexStore.data() + begin;
+	int* last = indexStore.data() + end;
+
+	int* y = std::partition(first, last, [&](int i) { return keys[i].y < c.y(); });
+	int* lo[2] = { first, y };
+	int* hi[2] = { y, last };
+	for (int h = 0; h < 2; h++) {
+		int* z = std::partition(lo[h], hi[h], [&](int i) { return keys[i].z < c.z(); });
+		int* x0 = std::partition(lo[h], z, [&](int i) { return keys[i].x < c.x(); });
+		int* x1 = std::partition(z, hi[h], [&](int i) { return keys[i].x >= c.x(); });
+		bounds[4 * h + 0] = lo[h] - indexStore.data();
+		bounds[4 * h + 1] = x0 - indexStore.data();
+		bounds[4 * h + 2] = z - indexStore.data();
+		bounds[4 * h + 3] = x1 - indexStore.data();
+	}
+	bounds[8] = end;
 }
 
 
@@ -160,111 +378,754 @@ void Octree::create(const ofMesh& geo, int numLevels) {
 //
 //  subdivide(node) algorithm:
 //     1) subdivide box in node into 8 equal side boxes - see helper function subDivideBox8().
-//     2) For each child box
-//            sort point data into each box  (see helper function getMeshFacesInBox())
+//     2) sort the node's range of indices into the 8 boxes - see partition()
 //        if a child box contains at list 1 point
 //            add child to tree
-//            if child is not a leaf node (contains more than 1 point)
-//               recursively call subdivide(child)
-//         
-//      
+//            in face mode, grow the child box to fit its faces
+//     3) the children of a node are appended to "tree" as one contiguous run
+//        so they can be addressed with firstChild + childMask.
+//     4) For each child that can be split further (see canSplit())
+//            recursively call subdivide(child)
+//
+//  With the cost model on, the children are only added if splitPaysOff().
+//
+//  Nodes are referred to by index since "tree" may reallocate as it grows.
+//  If "deferred" is given, nodes at parallelLevel are not subdivided but
+//  added to "deferred" to be built later as separate subtrees.
+//
 
-void Octree::subdivide(const ofMesh& mesh, TreeNode& node, int numLevels, int level) {
+void Octree::subdivide(const glm::vec3* keys, vector<TreeNode>& tree, int node,
+	int numLevels, int level, vector<int>* deferred) {
 	if (level >= numLevels) return;  // Stop subdividing if max levels reached.
+	if (!canSplit(tree[node])) return;
+	if (deferred && level >= parallelLevel) {
+		deferred->push_back(node);
+		return;
+	}
 
 	vector<Box> childBoxes;
-	subDivideBox8(node.box, childBoxes);  // Divide current box into 8 smaller boxes.
+	subDivideBox8(tree[node].box, childBoxes);  // Divide current box into 8 smaller boxes.
+
+	int bounds[9];
+	partition(keys, tree[node].begin, tree[node].end, tree[node].box, bounds);
 
-	for (auto& childBox : childBoxes) {
-		vector<int> pointsInBox;
-		getMeshPointsInBox(mesh, node.points, childBox, pointsInBox);
+	TreeNode children[8];
+	int numChildren = 0;
+	unsigned char childMask = 0;
+	for (int i = 0; i < 8; i++) {
+		if (bounds[i] < bounds[i + 1]) {
+			TreeNode& childNode = children[numChildren++];
+			childNode.box = childBoxes[i];
+			childNode.begin = bounds[i];
+			childNode.end = bounds[i + 1];
+			if (bUseFaces) {
+				childNode.box = growToFaces(&indexStore[bounds[i]], childNode.numPoints(), childBoxes[i]);
+			}
+			childMask |= (1 << i);
+		}
+	}
+	if (!splitPaysOff(tree[node].box, children, numChildren)) return;
 
-		if (!pointsInBox.empty()) {
-			TreeNode childNode;
-			childNode.box = childBox;
-			childNode.points = pointsInBox;
+	int firstChild = tree.size();
+	tree.insert(tree.end(), children, children + numChildren);
+	tree[node].firstChild = firstChild;
+	tree[node].childMask = childMask;
 
-			node.children.push_back(childNode);
+	for (int i = 0; i < numChildren; i++) {
+		subdivide(keys, tree, firstChild + i, numLevels, level + 1, deferred);
+	}
+}
 
-			if (pointsInBox.size() > 1) {
-				subdivide(mesh, node.children.back(), numLevels, level + 1);
-			}
+//  false if the node should stay a leaf:  it holds few enough points (or
+//  faces), or it is smaller than settings.minExtent
+//
+bool Octree::canSplit(const TreeNode& node) const {
+	int leafSize = bUseFaces ? settings.maxFacesPerLeaf : settings.maxPointsPerLeaf;
+	if (node.numPoints() <= leafSize) return false;
+	Vector3 size = node.box.max() - node.box.min();
+	return std::max(size.x(), std::max(size.y(), size.z())) >= settings.minExtent;
+}
+
+static float surfaceArea(const Box& box) {
+	Vector3 d = box.max() - box.min();
+	return 2 * (d.x() * d.y() + d.y() * d.z() + d.z() * d.x());
+}
+
+//  Cost model (surface area heuristic).  The expected cost of a ray that
+//  reaches the node is
+//
+//     as a leaf:   intersectCost * n
+//     split:       traversalCost + sum over the children of
+//                  area(child) / area(node) * intersectCost * n(child)
+//
+//  where area(child) / area(node) estimates the chance that a ray through
+//  the node also passes through the child.  Always true when the cost model
+//  is off.
+//
+bool Octree::splitPaysOff(const Box& box, const TreeNode* children, int numChildren) const {
+	if (!settings.useCostModel) return true;
+	float area = surfaceArea(box);
+	if (area <= 0) return true;
+
+	int n = 0;
+	float splitCost = settings.traversalCost;
+	for (int i = 0; i < numChildren; i++) {
+		n += children[i].numPoints();
+		splitCost += surfaceArea(children[i].box) / area * settings.intersectCost * children[i].numPoints();
+	}
+	return splitCost < settings.intersectCost * n;
+}
+
+//
+// buildSubtrees:  build the subtrees below the given nodes on numThreads
+//                 threads, then append them to "nodeStore".
+//
+//  Each subtree is built into its own node array and works on its own range
+//  of "indices", so the threads share nothing but the (read only) mesh.
+//  Threads take the next unbuilt subtree from a shared counter until none
+//  are left, so a thread that finishes a small subtree moves on to the next
+//  one.  The subtrees are appended in the order they were deferred, which
+//  does not depend on the number of threads, so every thread count builds
+//  exactly the same tree.
+//
+void Octree::buildSubtrees(const glm::vec3* keys, const vector<int>& subtrees, int numLevels) {
+	vector<vector<TreeNode>> built(subtrees.size());
+
+	std::atomic<int> next(0);
+	auto worker = [&]() {
+		for (int i = next++; i < (int)subtrees.size(); i = next++) {
+			built[i].push_back(nodeStore[subtrees[i]]);
+			subdivide(keys, built[i], 0, numLevels, parallelLevel, nullptr);
+		}
+	};
+
+	int threads = numThreads > 0 ? numThreads : std::thread::hardware_concurrency();
+	threads = std::max(1, std::min(threads, (int)subtrees.size()));
+	vector<std::thread> pool;
+	for (int i = 1; i < threads; i++) {
+		pool.emplace_back(worker);
+	}
+	worker();
+	for (int i = 0; i < pool.size(); i++) {
+		pool[i].join();
+	}
+
+	// splice:  local node k > 0 of a subtree moves to nodeStore[offset + k],
+	// local node 0 goes back to where the subtree root was
+	//
+	for (int i = 0; i < built.size(); i++) {
+		int offset = nodeStore.size() - 1;
+		for (int k = 0; k < built[i].size(); k++) {
+			TreeNode& n = built[i][k];
+			if (!n.isLeaf()) n.firstChild += offset;
+			if (k == 0) nodeStore[subtrees[i]] = n;
+			else nodeStore.push_back(n);
 		}
 	}
 }
 
-//Pierce Kyaw, Aye Thwe Tun
-bool Octree::intersect(const Ray& ray, const TreeNode& node, TreeNode& nodeRtn) {
-	// Check if the ray intersects the bounding box of the current node.
-	bool intersects = false;
-	if (node.box.intersect(ray, 0, INFINITE))
-	{
-		// If the node has no children, it's a leaf node; return this node.
-		if (node.children.size() == 0)
-		{
-			nodeRtn = node;
-			intersects = true;
-		}
-		else
-		{
-			// If the node has children, recursively check for intersections with each child.
-			for (int i = 0; i < node.children.size(); i++)
-			{
-				if (intersect(ray, node.children[i], nodeRtn))
-				{
-					intersects = true;
+//  Nearest-hit ray query.
+//
+//  Nodes are visited front to back: the children of a node are sorted by the
+//  distance at which the ray enters their box and the nearest is visited
+//  first.
+//
+//  Point mode:  octants don't overlap, so the first leaf reached is the
+//  nearest one and the traversal stops there.  The hit is the first vertex
+//  of that leaf; t is the distance of the vertex along the ray.
+//
+//  Face mode:  the faces in a leaf are tested exactly.  Node boxes are grown
+//  to fit their faces and may overlap, so the traversal continues after a
+//  hit but skips every node the ray enters beyond the nearest hit so far.
+//
+bool Octree::intersect(const Ray& ray, RayHit& hitRtn) const {
+	if (nodes.empty()) return false;
+
+	QueryCounters count;     // kept in locals, added to counters at the end
+	count.queries++;
+	count.boxesTested++;
+	float tEnter;
+	bool found = false;
+	if (nodes[0].box.intersect(ray, 0, INFINITE, tEnter)) {
+		float tNearest = INFINITE;
+		found = intersect(ray, 0, tEnter, tNearest, hitRtn, count);
+	}
+	if (bCountQueries) counters.add(count);
+	return found;
+}
+
+//  Nearest-hit query of the subtree at "node", which the ray enters at
+//  tEnter.  Only nodes the ray enters before tNearest are visited; on a hit
+//  tNearest is set to the hit distance (to the entry distance of the leaf in
+//  point mode).  The work is added to "count".
+//
+bool Octree::intersect(const Ray& ray, int node, float tEnter, float& tNearest, RayHit& hitRtn,
+	QueryCounters& count) const {
+
+	// explicit stack, each level pushes at most 8 children
+	//
+	int stack[MaxLevels * 8];
+	float stackT[MaxLevels * 8];
+	int top = 0;
+
+	stack[top] = node;
+	stackT[top++] = tEnter;
+
+	bool found = false;
+
+	while (top > 0) {
+		top--;
+		int node = stack[top];
+		if (stackT[top] > tNearest) continue;
+
+		count.nodesVisited++;
+		const TreeNode& n = nodes[node];
+		if (n.isLeaf()) {
+			count.leavesReached++;
+			if (!bUseFaces) {
+				count.primitivesTested++;
+				tNearest = stackT[top];
+				int vertex = indices[n.begin];
+				glm::vec3 p = vertices[vertex];
+				Vector3 d = ray.direction;
+				hitRtn.point = p;
+				hitRtn.t = ((p.x - ray.origin.x()) * d.x() + (p.y - ray.origin.y()) * d.y() +
+					(p.z - ray.origin.z()) * d.z()) / (d * d);
+				hitRtn.leaf = node;
+				hitRtn.index = vertex;
+				found = true;
+				break;
+			}
+			count.primitivesTested += n.numPoints();
+			for (int i = n.begin; i < n.end; i++) {
+				glm::vec3 v[3];
+				float t;
+				getFace(indices[i], v);
+				if (rayIntersectTriangle(ray, v, t) && t < tNearest) {
+					tNearest = t;
+					hitRtn.t = t;
+					hitRtn.leaf = node;
+					hitRtn.index = indices[i];
+					found = true;
 				}
 			}
+			continue;
+		}
+
+		// sort the children the ray passes through by entry distance
+		//
+		int child[8];
+		float childT[8];
+		float tChildren[8];
+		int numHit = 0;
+		int numChildren = n.numChildren();
+		count.boxesTested += numChildren;
+		Box8 boxes;
+		for (int i = 0; i < numChildren; i++) {
+			const Box& b = nodes[n.firstChild + i].box;
+			boxes.set(i, b.parameters[0], b.parameters[1]);
 		}
+		unsigned int hits = slabTest8(ray, boxes, numChildren, 0, tNearest, tChildren);
+		for (int i = 0; hits; i++, hits >>= 1) {
+			if (!(hits & 1)) continue;
+			int c = n.firstChild + i;
+			tEnter = tChildren[i];
+			int j = numHit++;
+			for (; j > 0 && childT[j - 1] > tEnter; j--) {
+				child[j] = child[j - 1];
+				childT[j] = childT[j - 1];
+			}
+			child[j] = c;
+			childT[j] = tEnter;
+		}
+
+		// push farthest first so the nearest child is visited next
+		//
+		for (int i = numHit - 1; i >= 0; i--) {
+			stack[top] = child[i];
+			stackT[top++] = childT[i];
+		}
+	}
+
+	if (found && bUseFaces) {
+		Vector3 p = ray.origin + ray.direction * hitRtn.t;
+		hitRtn.point = glm::vec3(p.x(), p.y(), p.z());
 	}
-	// Return true if any intersection is found.
-	return intersects;
+	return found;
 }
 
-//Pierce Kyaw, Aye Thwe Tun
-bool Octree::intersect(const Box& box, TreeNode& node, vector<Box>& boxListRtn) {
-	// Check if the given box overlaps with the bounding box of the current node.
-	if (!node.box.overlap(box)) {
-		return false; // No overlap, so return false.
+//  The rays of one packet in structure of arrays form, so that a box can be
+//  tested against all of them with one loop over the lanes (which the
+//  compiler turns into SIMD instructions).
+//
+class RayPacket {
+public:
+	float ox[Octree::PacketSize], oy[Octree::PacketSize], oz[Octree::PacketSize];
+	float dx[Octree::PacketSize], dy[Octree::PacketSize], dz[Octree::PacketSize];
+	float ix[Octree::PacketSize], iy[Octree::PacketSize], iz[Octree::PacketSize];
+
+	// a lane only visits nodes it enters before tNearest: the nearest face
+	// hit so far, or in point mode the entry distance of the leaf hit so far
+	//
+	float tNearest[Octree::PacketSize];
+	const Ray* rays[Octree::PacketSize];
+	unsigned int active = 0;
+
+	void set(const Ray* r, int count) {
+		active = (1u << count) - 1;
+		for (int i = 0; i < Octree::PacketSize; i++) {
+			const Ray& ray = r[i < count ? i : 0];   // unused lanes repeat ray 0
+			rays[i] = &ray;
+			ox[i] = ray.origin.x();
+			oy[i] = ray.origin.y();
+			oz[i] = ray.origin.z();
+			dx[i] = ray.direction.x();
+			dy[i] = ray.direction.y();
+			dz[i] = ray.direction.z();
+			ix[i] = ray.inv_direction.x();
+			iy[i] = ray.inv_direction.y();
+			iz[i] = ray.inv_direction.z();
+			tNearest[i] = INFINITE;
+		}
 	}
 
-	bool foundOverlap = false;
+	// narrow [tmin, tmax] to the slab between distances a and b.  A NaN
+	// distance (a ray parallel to and exactly on a face) leaves it alone,
+	// as in slabTestScalar.
+	//
+	static void clip(float a, float b, float& tmin, float& tmax) {
+		if (a != a || b != b) return;
+		float lo = a < b ? a : b, hi = a < b ? b : a;
+		tmin = lo > tmin ? lo : tmin;
+		tmax = hi < tmax ? hi : tmax;
+	}
 
-	// If the node is a leaf (has no children), add its bounding box to the result list.
-	if (node.children.empty()) {
-		boxListRtn.push_back(node.box);
-		return true;
+	// slab test of box against every lane in mask.  Returns the lanes that
+	// enter the box in (0, tNearest) and their entry distances in tEnterRtn.
+	//
+	unsigned int intersect(const Box& box, unsigned int mask, float tEnterRtn[]) const {
+		float minX = box.min().x(), minY = box.min().y(), minZ = box.min().z();
+		float maxX = box.max().x(), maxY = box.max().y(), maxZ = box.max().z();
+		int hit[Octree::PacketSize];
+		for (int i = 0; i < Octree::PacketSize; i++) {
+			float x0 = (minX - ox[i]) * ix[i], x1 = (maxX - ox[i]) * ix[i];
+			float y0 = (minY - oy[i]) * iy[i], y1 = (maxY - oy[i]) * iy[i];
+			float z0 = (minZ - oz[i]) * iz[i], z1 = (maxZ - oz[i]) * iz[i];
+			float tmin = -INFINITY, tmax = INFINITY;
+			clip(x0, x1, tmin, tmax);
+			clip(y0, y1, tmin, tmax);
+			clip(z0, z1, tmin, tmax);
+			tEnterRtn[i] = tmin > 0 ? tmin : 0;
+			hit[i] = (tmin <= tmax) & (tmin < tNearest[i]) & (tmax > 0);
+		}
+		unsigned int hits = 0;
+		for (int i = 0; i < Octree::PacketSize; i++) hits |= hit[i] << i;
+		return hits & mask;
 	}
-	else {
-		// If the node has children, recursively check for overlaps with each child.
-		for (int i = 0; i < node.children.size(); i++) {
-			if (intersect(box, node.children[i], boxListRtn)) {
-				foundOverlap = true;
+
+	// Moller-Trumbore test of one triangle against every lane in mask (same
+	// rules as Octree::rayIntersectTriangle).  Returns the lanes that hit it
+	// nearer than tNearest and the hit distances in tRtn.
+	//
+	unsigned int intersect(const glm::vec3 v[3], unsigned int mask, float tRtn[]) const {
+		const float eps = 1e-7f;
+		glm::vec3 e1 = v[1] - v[0];
+		glm::vec3 e2 = v[2] - v[0];
+		int hit[Octree::PacketSize];
+		for (int i = 0; i < Octree::PacketSize; i++) {
+			float px = dy[i] * e2.z - dz[i] * e2.y;
+			float py = dz[i] * e2.x - dx[i] * e2.z;
+			float pz = dx[i] * e2.y - dy[i] * e2.x;
+			float det = e1.x * px + e1.y * py + e1.z * pz;
+			float invDet = 1.0f / det;
+			float sx = ox[i] - v[0].x, sy = oy[i] - v[0].y, sz = oz[i] - v[0].z;
+			float u = (sx * px + sy * py + sz * pz) * invDet;
+			float qx = sy * e1.z - sz * e1.y;
+			float qy = sz * e1.x - sx * e1.z;
+			float qz = sx * e1.y - sy * e1.x;
+			float w = (dx[i] * qx + dy[i] * qy + dz[i] * qz) * invDet;
+			float t = (e2.x * qx + e2.y * qy + e2.z * qz) * invDet;
+			tRtn[i] = t;
+			hit[i] = (fabsf(det) >= eps) & (u >= 0) & (u <= 1) & (w >= 0) & (u + w <= 1) &
+				(t >= 0) & (t < tNearest[i]);
+		}
+		unsigned int hits = 0;
+		for (int i = 0; i < Octree::PacketSize; i++) hits |= hit[i] << i;
+		return hits & mask;
+	}
+};
+
+//  Batch nearest-hit ray query.  Each packet is traversed front to back by
+//  the smallest entry distance of its rays; a node is only pushed with the
+//  lanes that hit its box.  Leaves are tested per lane with the same rules
+//  as the single ray query, so every ray gets the same hit.
+//
+int Octree::intersect(ArrayView<Ray> rays, vector<RayHit>& hitsRtn) const {
+	hitsRtn.resize(rays.size());
+	for (int i = 0; i < hitsRtn.size(); i++) {
+		hitsRtn[i].t = INFINITE;
+		hitsRtn[i].leaf = -1;
+		hitsRtn[i].index = -1;
+	}
+	if (nodes.empty()) return 0;
+	if (bCountQueries) counters.queries += rays.size();
+
+	RayPacket packet;
+	for (int first = 0; first < rays.size(); first += PacketSize) {
+		int count = std::min((int)rays.size() - first, PacketSize);
+		packet.set(rays.data() + first, count);
+		intersectPacket(packet, &hitsRtn[first]);
+	}
+
+	int numHits = 0;
+	for (int i = 0; i < hitsRtn.size(); i++) {
+		if (hitsRtn[i].leaf >= 0) numHits++;
+	}
+	return numHits;
+}
+
+void Octree::intersectPacket(RayPacket& packet, RayHit* hitsRtn) const {
+	class Entry {
+	public:
+		int node;
+		unsigned int mask;
+		float t;
+	};
+	Entry stack[MaxLevels * 8];
+	int top = 0;
+	QueryCounters count;
+
+	float tEnter[PacketSize];
+	unsigned int mask = packet.intersect(nodes[0].box, packet.active, tEnter);
+	count.boxesTested++;
+	if (!mask) {
+		if (bCountQueries) counters.add(count);
+		return;
+	}
+	stack[top++] = { 0, mask, 0 };
+
+	while (top > 0) {
+		Entry e = stack[--top];
+
+		// drop the lanes that already have a hit nearer than this node
+		//
+		mask = e.mask;
+		for (int i = 0; i < PacketSize; i++) {
+			if (packet.tNearest[i] < e.t) mask &= ~(1u << i);
+		}
+		if (!mask) continue;
+
+		// a single ray left finishes the subtree with the single ray query,
+		// from its own entry distance (e.t is the packet's nearest, which in
+		// point mode would become the ray's tNearest on a hit)
+		//
+		if (TreeNode::bitCount(mask) == 1) {
+			int i = TreeNode::bitCount(mask - 1);
+			float t;
+			count.boxesTested++;
+			if (!nodes[e.node].box.intersect(*packet.rays[i], 0, packet.tNearest[i], t)) continue;
+			RayHit hit;
+			if (intersect(*packet.rays[i], e.node, t, packet.tNearest[i], hit, count)) hitsRtn[i] = hit;
+			continue;
+		}
+
+		count.nodesVisited++;
+		const TreeNode& n = nodes[e.node];
+		if (n.isLeaf()) {
+			mask = packet.intersect(n.box, mask, tEnter);
+			count.boxesTested++;
+			count.leavesReached++;
+			if (!bUseFaces) {
+				count.primitivesTested++;
+				int vertex = indices[n.begin];
+				glm::vec3 p = vertices[vertex];
+				for (int i = 0; i < PacketSize; i++) {
+					if (!(mask & (1u << i))) continue;
+					const Ray& ray = *packet.rays[i];
+					Vector3 d = ray.direction;
+					hitsRtn[i].point = p;
+					hitsRtn[i].t = ((p.x - ray.origin.x()) * d.x() + (p.y - ray.origin.y()) * d.y() +
+						(p.z - ray.origin.z()) * d.z()) / (d * d);
+					hitsRtn[i].leaf = e.node;
+					hitsRtn[i].index = vertex;
+					packet.tNearest[i] = tEnter[i];
+				}
+				continue;
+			}
+
+			// each face is fetched once and tested against every lane
+			//
+			count.primitivesTested += n.numPoints();
+			for (int f = n.begin; f < n.end; f++) {
+				glm::vec3 v[3];
+				float t[PacketSize];
+				getFace(indices[f], v);
+				unsigned int hits = packet.intersect(v, mask, t);
+				for (int i = 0; hits; i++, hits >>= 1) {
+					if (!(hits & 1)) continue;
+					packet.tNearest[i] = t[i];
+					hitsRtn[i].t = t[i];
+					hitsRtn[i].leaf = e.node;
+					hitsRtn[i].index = indices[f];
+				}
+			}
+			continue;
+		}
+
+		// sort the children by the nearest entry distance of their lanes
+		//
+		Entry child[8];
+		int numHit = 0;
+		int numChildren = n.numChildren();
+		count.boxesTested += numChildren;
+		for (int c = 0; c < numChildren; c++) {
+			unsigned int childMask = packet.intersect(nodes[n.firstChild + c].box, mask, tEnter);
+			if (!childMask) continue;
+			float t = INFINITE;
+			for (int i = 0; i < PacketSize; i++) {
+				if ((childMask & (1u << i)) && tEnter[i] < t) t = tEnter[i];
 			}
+			int j = numHit++;
+			for (; j > 0 && child[j - 1].t > t; j--) child[j] = child[j - 1];
+			child[j] = { n.firstChild + c, childMask, t };
 		}
+
+		// push farthest first so the nearest child is visited next
+		//
+		for (int i = numHit - 1; i >= 0; i--) stack[top++] = child[i];
 	}
+	if (bCountQueries) counters.add(count);
+
+	if (bUseFaces) {
+		for (int i = 0; i < PacketSize; i++) {
+			if (!(packet.active & (1u << i)) || hitsRtn[i].leaf < 0) continue;
+			Vector3 p = packet.rays[i]->origin + packet.rays[i]->direction * hitsRtn[i].t;
+			hitsRtn[i].point = glm::vec3(p.x(), p.y(), p.z());
+		}
+	}
+}
+
+//Pierce Kyaw, Aye Thwe Tun
+bool Octree::intersect(const Box& box, int node, vector<Box>& boxListRtn) const {
+	int stack[MaxLevels * 8];
+	int top = 0;
+	stack[top++] = node;
+	bool foundOverlap = false;
+	QueryCounters count;
+	count.queries++;
+	while (top > 0) {
+		const TreeNode& n = nodes[stack[--top]];
+		count.nodesVisited++;
+		count.boxesTested++;
+
+		// Check if the given box overlaps with the bounding box of the current node.
+		if (!n.box.overlap(box)) continue;
+
+		// If the node is a leaf (has no children), add its bounding box to the result list.
+		if (n.isLeaf()) {
+			count.leavesReached++;
+			boxListRtn.push_back(n.box);
+			foundOverlap = true;
+			continue;
+		}
+
+		// If the node has children, check each of them for overlaps (pushed
+		// last first, so they are visited in order).
+		int numChildren = n.numChildren();
+		for (int i = numChildren - 1; i >= 0; i--) stack[top++] = n.firstChild + i;
+	}
+	if (bCountQueries) counters.add(count);
+
 	// Return true if any overlap is found.
 	return foundOverlap;
 }
 
-void Octree::draw(TreeNode& node, int numLevels, int level) {
-	// Stop drawing if the current level exceeds or equals the specified number of levels.
-	if (level >= numLevels) return;
+bool Octree::overlap(const Box& box) const {
+	if (nodes.empty()) return false;
+
+	int stack[MaxLevels * 8];
+	int top = 0;
+	stack[top++] = 0;
+	bool found = false;
+	QueryCounters count;
+	count.queries++;
+	while (top > 0) {
+		const TreeNode& n = nodes[stack[--top]];
+		count.nodesVisited++;
+		count.boxesTested++;
+		if (!n.box.overlap(box)) continue;
+		if (n.isLeaf()) {
+			count.leavesReached++;
+			found = true;
+			break;
+		}
+		int numChildren = n.numChildren();
+		for (int i = 0; i < numChildren; i++) stack[top++] = n.firstChild + i;
+	}
+	if (bCountQueries) counters.add(count);
+	return found;
+}
 
-	// Set the color based on the current level, cycling through available colors.
-	ofSetColor(colors[level % colors.size()]);
+//  Swept box query.  The box touches a node's box during the motion where
+//  its center, moving along the motion, is inside the node's box grown by
+//  the box's half size, so the nodes are traversed like a ray from the
+//  center (t from 0 to 1), nearest first, skipping nodes entered after the
+//  nearest hit so far.  The faces in the leaves are swept exactly (see
+//  SpatialIndex::sweepBoxTriangle).
+//
+bool Octree::sweep(const Box& box, const glm::vec3& motion, SweepHit& hitRtn) const {
+	if (nodes.empty() || !bUseFaces) return false;
 
-	// Draw the bounding box of the current node.
-	drawBox(node.box);
+	Vector3 c = box.center();
+	Vector3 h = box.max() - c;
+	glm::vec3 center(c.x(), c.y(), c.z());
+	glm::vec3 halfSize(h.x(), h.y(), h.z());
+	Ray ray(c, Vector3(motion.x, motion.y, motion.z));
 
-	// Recursively draw each child node, incrementing the level.
-	for (TreeNode& child : node.children) {
-		draw(child, numLevels, level + 1);
+	QueryCounters count;
+	count.queries++;
+	count.boxesTested++;
+	float tEnter;
+	const Box& rootBox = nodes[0].box;
+	if (!Box(rootBox.min() - h, rootBox.max() + h).intersect(ray, 0, 1, tEnter)) {
+		if (bCountQueries) counters.add(count);
+		return false;
 	}
+
+	int stack[MaxLevels * 8];
+	float stackT[MaxLevels * 8];
+	int top = 0;
+	stack[top] = 0;
+	stackT[top++] = tEnter;
+
+	float tNearest = 1;
+	bool found = false;
+	while (top > 0) {
+		top--;
+		int node = stack[top];
+		if (stackT[top] > tNearest) continue;
+
+		count.nodesVisited++;
+		const TreeNode& n = nodes[node];
+		if (n.isLeaf()) {
+			count.leavesReached++;
+			count.primitivesTested += n.numPoints();
+			for (int i = n.begin; i < n.end; i++) {
+				glm::vec3 v[3], normal;
+				float t;
+				getFace(indices[i], v);
+				if (sweepBoxTriangle(center, halfSize, motion, v, tNearest, t, normal)) {
+					tNearest = t;
+					hitRtn.t = t;
+					hitRtn.normal = normal;
+					hitRtn.leaf = node;
+					hitRtn.index = indices[i];
+					found = true;
+				}
+			}
+			continue;
+		}
+
+		// sort the children the grown boxes are entered in by entry distance
+		//
+		int child[8];
+		float childT[8];
+		float tChildren[8];
+		int numHit = 0;
+		int numChildren = n.numChildren();
+		count.boxesTested += numChildren;
+		Box8 boxes;
+		for (int i = 0; i < numChildren; i++) {
+			const Box& b = nodes[n.firstChild + i].box;
+			boxes.set(i, b.parameters[0] - h, b.parameters[1] + h);
+		}
+		unsigned int hits = slabTest8(ray, boxes, numChildren, 0, tNearest, tChildren);
+		for (int i = 0; hits; i++, hits >>= 1) {
+			if (!(hits & 1)) continue;
+			int j = numHit++;
+			for (; j > 0 && childT[j - 1] > tChildren[i]; j--) {
+				child[j] = child[j - 1];
+				childT[j] = childT[j - 1];
+			}
+			child[j] = n.firstChild + i;
+			childT[j] = tChildren[i];
+		}
+
+		// push farthest first so the nearest child is visited next
+		//
+		for (int i = numHit - 1; i >= 0; i--) {
+			stack[top] = child[i];
+			stackT[top++] = childT[i];
+		}
+	}
+
+	if (bCountQueries) counters.add(count);
+	return found;
+}
+
+int Octree::getIndicesInBox(const Box& box, vector<int>& indicesRtn) const {
+	indicesRtn.clear();
+	if (nodes.empty()) return 0;
+
+	Vector3 min = box.min(), max = box.max();
+	int stack[MaxLevels * 8];
+	int top = 0;
+	stack[top++] = 0;
+	QueryCounters count;
+	count.queries++;
+	while (top > 0) {
+		const TreeNode& n = nodes[stack[--top]];
+		count.nodesVisited++;
+		count.boxesTested++;
+		if (!n.box.overlap(box)) continue;
+		if (!n.isLeaf()) {
+			int numChildren = n.numChildren();
+			for (int i = 0; i < numChildren; i++) stack[top++] = n.firstChild + i;
+			continue;
+		}
+		count.leavesReached++;
+		count.primitivesTested += n.numPoints();
+		for (int i = n.begin; i < n.end; i++) {
+			glm::vec3 lo, hi;
+			if (bUseFaces) {
+				glm::vec3 v[3];
+				getFace(indices[i], v);
+				lo = glm::min(v[0], glm::min(v[1], v[2]));
+				hi = glm::max(v[0], glm::max(v[1], v[2]));
+			}
+			else lo = hi = vertices[indices[i]];
+			if (hi.x >= min.x() && lo.x <= max.x() && hi.y >= min.y() && lo.y <= max.y() &&
+				hi.z >= min.z() && lo.z <= max.z()) {
+				indicesRtn.push_back(indices[i]);
+			}
+		}
+	}
+	if (bCountQueries) counters.add(count);
+	return indicesRtn.size();
 }
 
+void Octree::getNodeLines(int node, int numLevels, int level, ofMesh& linesRtn) const {
+	// Stop if the current level exceeds or equals the specified number of levels.
+	if (level >= numLevels) return;
+
+	const TreeNode& n = nodes[node];
 
-void Octree::drawLeafNodes(TreeNode& node) {
+	// Add the bounding box of the current node, in the color of its level.
+	addBoxLines(n.box, colors[level % colors.size()], linesRtn);
 
+	// Recursively add each child node, incrementing the level.
+	int numChildren = n.numChildren();
+	for (int i = 0; i < numChildren; i++) {
+		getNodeLines(n.firstChild + i, numLevels, level + 1, linesRtn);
+	}
+}
 
-}
\ No newline at end of file
+// leaf boxes in the color of their depth
+//
+void Octree::getLeafLines(ofMesh& linesRtn) const {
+	vector<int> depth;
+	nodeDepths(nodes.size(), [this](int i) { return std::make_pair(nodes[i].firstChild, nodes[i].numChildren()); }, depth);
+	for (int i = 0; i < nodes.size(); i++) {
+		if (nodes[i].isLeaf()) addBoxLines(nodes[i].box, colors[depth[i] % colors.size()], linesRtn);
+	}
+}
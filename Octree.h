@@ -10,44 +10,189 @@
 //
 #pragma once
 #include "ofMain.h"
-#include "box.h"
-#include "ray.h"
+#include "SpatialIndex.h"
 
 
 
+//  Octree nodes are stored in one contiguous array (Octree::nodes). The
+//  occupied children of a node are stored next to each other starting at
+//  firstChild; bit i of childMask is set if octant i (see subDivideBox8())
+//  is occupied.  The points (or faces) in a node are Octree::indices[begin]
+//  to Octree::indices[end - 1].
+//
 class TreeNode {
 public:
 	Box box;
-	vector<int> points;
-	vector<TreeNode> children;
+	int begin = 0;
+	int end = 0;
+	int firstChild = -1;
+	unsigned char childMask = 0;
+
+	bool isLeaf() const { return childMask == 0; }
+	int numPoints() const { return end - begin; }
+	int numChildren() const { return bitCount(childMask); }
+
+	// index in Octree::nodes of the child in "octant", -1 if octant is empty
+	//
+	int child(int octant) const {
+		if (!(childMask & (1 << octant))) return -1;
+		return firstChild + bitCount(childMask & ((1 << octant) - 1));
+	}
+
+	static int bitCount(unsigned char m) {
+		int n = 0;
+		for (; m; m &= m - 1) n++;
+		return n;
+	}
+};
+
+//  How Octree::create builds the tree:
+//
+//    TopDownBuilder   recursively split each node's points into 8 octants
+//    MortonBuilder    sort all points by Morton (Z-order) code, then read the
+//                     nodes off the sorted codes
+//
+typedef enum { TopDownBuilder, MortonBuilder } OctreeBuilder;
+
+//  When Octree::create stops splitting a node.  A node always stays a leaf
+//  at the tree's numLevels; before that it is split unless
+//
+//    it holds maxPointsPerLeaf vertices or fewer (maxFacesPerLeaf faces in
+//    face mode)
+//    its largest side is shorter than minExtent
+//    useCostModel is set and the cost model says a ray through the node is
+//    cheaper with the node as a leaf (see Octree::splitPaysOff())
+//
+class OctreeSettings {
+public:
+	int maxPointsPerLeaf = 1;
+	int maxFacesPerLeaf = 4;
+	float minExtent = 0;
+	bool useCostModel = false;
+	float traversalCost = 4;    // cost of visiting a node (pop, test its
+	float intersectCost = 1;    // children), relative to testing one face
+
+	bool operator==(const OctreeSettings& s) const {
+		return maxPointsPerLeaf == s.maxPointsPerLeaf && maxFacesPerLeaf == s.maxFacesPerLeaf &&
+			minExtent == s.minExtent && useCostModel == s.useCostModel &&
+			traversalCost == s.traversalCost && intersectCost == s.intersectCost;
+	}
 };
 
-class Octree {
+class RayPacket;
+
+class Octree : public SpatialIndex {
 public:
 
-	void create(const ofMesh& mesh, int numLevels);
-	void subdivide(const ofMesh& mesh, TreeNode& node, int numLevels, int level);
-	bool intersect(const Ray&, const TreeNode& node, TreeNode& nodeRtn);
-	bool intersect(const Box&, TreeNode& node, vector<Box>& boxListRtn);
-	void draw(TreeNode& node, int numLevels, int level);
-	void draw(int numLevels, int level) {
-		draw(root, numLevels, level);
+	// most levels in a tree.  The traversals keep up to 8 nodes per level
+	// on stacks of MaxLevels * 8 entries.
+	//
+	static const int MaxLevels = 32;
+
+	// deepest tree the Morton builder supports (21 bits per axis in 64 bit codes)
+	//
+	static const int MaxMortonLevels = 22;
+
+	// number of rays traversed together by the batch ray query
+	//
+	static const int PacketSize = 8;
+
+	Octree() { }
+	Octree(const Octree&) = delete;             // the views would point into the copied
+	Octree& operator=(const Octree&) = delete;  // octree's storage
+	Octree(Octree&&) = default;
+	Octree& operator=(Octree&&) = default;
+
+	void create(const ofMesh& mesh, int numLevels, OctreeBuilder builder = TopDownBuilder);
+
+	// build in face mode with the current levels and builder
+	//
+	void create(const ofMesh& mesh) override {
+		bUseFaces = true;
+		create(mesh, levels, builder);
+	}
+	void subdivide(const glm::vec3* keys, vector<TreeNode>& tree, int node,
+		int numLevels, int level, vector<int>* deferred = nullptr);
+	void buildSubtrees(const glm::vec3* keys, const vector<int>& subtrees, int numLevels);
+	bool canSplit(const TreeNode& node) const;
+	bool splitPaysOff(const Box& box, const TreeNode* children, int numChildren) const;
+	void partition(const glm::vec3* keys, int begin, int end, const Box& box, int bounds[9]);
+	void buildMorton(const glm::vec3* keys, int numLevels);
+	void emitMorton(const vector<uint64_t>& codes, int node, const Box& cell,
+		int depth, int maxDepth);
+	bool intersect(const Ray&, RayHit& hitRtn) const override;
+	bool intersect(const Ray&, int node, float tEnter, float& tNearest, RayHit& hitRtn, QueryCounters& count) const;
+
+	// batch nearest-hit query.  Consecutive rays are traversed together in
+	// packets of PacketSize, so rays that start close together (probes
+	// around the rocket, a block of pixels) share node fetches and box
+	// tests.  hitsRtn gets one record per ray; returns the number of hits.
+	//
+	int intersect(ArrayView<Ray> rays, vector<RayHit>& hitsRtn) const override;
+	void intersectPacket(RayPacket& packet, RayHit* hitsRtn) const;
+	bool intersect(const Box&, int node, vector<Box>& boxListRtn) const;
+	bool intersect(const Box& box, vector<Box>& boxListRtn) const override {
+		return !nodes.empty() && intersect(box, 0, boxListRtn);
+	}
+
+	// any-hit box query:  true as soon as one leaf overlaps the box.  Does
+	// not allocate.
+	//
+	bool overlap(const Box& box) const override;
+
+	// swept box query, front to back along the motion (face mode only)
+	//
+	bool sweep(const Box& box, const glm::vec3& motion, SweepHit& hitRtn) const override;
+
+	// indices of the primitives in the box:  vertices inside it, or in face
+	// mode faces whose bounds overlap it.  Returns the number found.
+	//
+	int getIndicesInBox(const Box& box, vector<int>& indicesRtn) const override;
+	void getNodeLines(int node, int numLevels, int level, ofMesh& linesRtn) const;
+	void getNodeLines(int numLevels, int level, ofMesh& linesRtn) const override {
+		if (!nodes.empty()) getNodeLines(0, numLevels, level, linesRtn);
 	}
-	void drawLeafNodes(TreeNode& node);
-	static void drawBox(const Box& box);
+	void getLeafLines(ofMesh& linesRtn) const override;
 	static Box meshBounds(const ofMesh&);
-	int getMeshPointsInBox(const ofMesh& mesh, const vector<int>& points, Box& box, vector<int>& pointsRtn);
-	int getMeshFacesInBox(const ofMesh& mesh, const vector<int>& faces, Box& box, vector<int>& facesRtn);
+
+	// true if the nodes of a tree read from a file can be walked:  each
+	// node's children inside the array and after it, at most MaxLevels
+	// levels, and the [begin, end) ranges inside [0, numIndices).  Only the
+	// leaves' ranges are checked unless bInnerRanges.
+	//
+	static bool validNodes(const TreeNode* nodes, int numNodes, int numIndices, bool bInnerRanges = true);
+	static void getFace(const ofMesh& mesh, int face, glm::vec3 v[3]);
+	static int getNumFaces(const ofMesh& mesh);
+	using SpatialIndex::getFace;
+	using SpatialIndex::getNumFaces;
+	Box growToFaces(const int* faces, int count, const Box& box) const;
 	void subDivideBox8(const Box& b, vector<Box>& boxList);
 
-	ofMesh mesh;
-	TreeNode root;
-	bool bUseFaces = false;
+	const TreeNode& root() const { return nodes[0]; }
+	IndexStats getStats() const override;
+	Box bounds() const override { return nodes.empty() ? Box() : nodes[0].box; }
+	const char* name() const override { return "octree"; }
 
-	vector<ofColor> colors;
+	// The tree used by queries (and the mesh views in SpatialIndex).  They
+	// are views into the storage below after create(), or into a mapped
+	// TerrainPack file.
+	//
+	ArrayView<TreeNode> nodes;         // nodes[0] is the root
+	ArrayView<int> indices;            // vertex (or face) indices, grouped by node
+
+	ofMesh mesh;                       // copy of the mesh given to create()
+	vector<TreeNode> nodeStore;
+	vector<int> indexStore;
+
+	bool bUseFaces = false;     // leaves store triangles instead of vertices
+	OctreeSettings settings;
+	int levels = 0;             // numLevels the tree was built with
+	OctreeBuilder builder = TopDownBuilder;
 
-	// debug;
+	// parallel build:  subtrees below parallelLevel are built on numThreads
+	// threads (0 = one per core).  The tree is the same for any thread count.
 	//
-	int strayVerts = 0;
-	int numLeaf = 0;
-};
\ No newline at end of file
+	int numThreads = 0;
+	int parallelLevel = 3;
+
+};
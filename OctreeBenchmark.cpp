@@ -0,0 +1,922 @@
+//  Pierce Kyaw, Aye Thwe Tun
+//
+//  Timing harness for the Octree.
+//
+
+#include "OctreeBenchmark.h"
+#include <random>
+#include <thread>
+
+//  Nested layout used by the Octree before it was flattened, rebuilt here
+//  from the flat node array so both layouts describe exactly the same tree.
+//
+class NestedTreeNode {
+public:
+	Box box;
+	vector<int> points;
+	vector<NestedTreeNode> children;
+};
+
+static void buildNested(const Octree& octree, int node, NestedTreeNode& nestedRtn) {
+	const TreeNode& n = octree.nodes[node];
+	nestedRtn.box = n.box;
+	nestedRtn.points.assign(octree.indices.begin() + n.begin, octree.indices.begin() + n.end);
+	nestedRtn.children.resize(n.numChildren());
+	for (int i = 0; i < n.numChildren(); i++) {
+		buildNested(octree, n.firstChild + i, nestedRtn.children[i]);
+	}
+}
+
+static bool intersectNested(const Ray& ray, const NestedTreeNode& node, NestedTreeNode& nodeRtn) {
+	bool intersects = false;
+	if (node.box.intersect(ray, 0, INFINITE)) {
+		if (node.children.size() == 0) {
+			nodeRtn = node;
+			intersects = true;
+		}
+		else {
+			for (int i = 0; i < node.children.size(); i++) {
+				if (intersectNested(ray, node.children[i], nodeRtn)) intersects = true;
+			}
+		}
+	}
+	return intersects;
+}
+
+static bool intersectNested(const Box& box, const NestedTreeNode& node, vector<Box>& boxListRtn) {
+	if (!node.box.overlap(box)) return false;
+	if (node.children.empty()) {
+		boxListRtn.push_back(node.box);
+		return true;
+	}
+	bool foundOverlap = false;
+	for (int i = 0; i < node.children.size(); i++) {
+		if (intersectNested(box, node.children[i], boxListRtn)) foundOverlap = true;
+	}
+	return foundOverlap;
+}
+
+// print one result line:  name, queries/sec and hit count (hits are printed so
+// the compiler can't discard the work, and to check both layouts agree)
+//
+static void report(const string& name, int numQueries, uint64_t micros, int hits) {
+	double seconds = micros / 1000000.0;
+	double rate = seconds > 0 ? numQueries / seconds : 0;
+	cout << "  " << name << ": " << micros / 1000.0 << " ms, "
+		<< (int)rate << " queries/sec, " << hits << " hits" << endl;
+}
+
+void makeDownwardRays(const Box& bounds, int count, vector<Ray>& raysRtn, unsigned int seed) {
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> rx(bounds.min().x(), bounds.max().x());
+	std::uniform_real_distribution<float> rz(bounds.min().z(), bounds.max().z());
+	float top = bounds.max().y() + 10;
+	raysRtn.clear();
+	for (int i = 0; i < count; i++) {
+		raysRtn.push_back(Ray(Vector3(rx(rng), top, rz(rng)), Vector3(0, -1, 0)));
+	}
+}
+
+void makeProbeRays(const Box& bounds, int count, float spread, vector<Ray>& raysRtn, unsigned int seed) {
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> rx(bounds.min().x(), bounds.max().x());
+	std::uniform_real_distribution<float> rz(bounds.min().z(), bounds.max().z());
+	std::uniform_real_distribution<float> offset(-spread, spread);
+	float top = bounds.max().y() + 10;
+	raysRtn.clear();
+	while (raysRtn.size() < count) {
+		float x = rx(rng), z = rz(rng);
+		for (int i = 0; i < Octree::PacketSize && raysRtn.size() < count; i++) {
+			raysRtn.push_back(Ray(Vector3(x + offset(rng), top, z + offset(rng)), Vector3(0, -1, 0)));
+		}
+	}
+}
+
+void makeQueryBoxes(const Box& bounds, int count, vector<Box>& boxesRtn, unsigned int seed) {
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> rx(bounds.min().x(), bounds.max().x());
+	std::uniform_real_distribution<float> ry(bounds.min().y(), bounds.max().y());
+	std::uniform_real_distribution<float> rz(bounds.min().z(), bounds.max().z());
+	Vector3 half(1, 1, 1);
+	boxesRtn.clear();
+	for (int i = 0; i < count; i++) {
+		Vector3 c(rx(rng), ry(rng), rz(rng));
+		boxesRtn.push_back(Box(c - half, c + half));
+	}
+}
+
+void benchmarkOctreeLayout(Octree& octree, int numQueries) {
+	if (octree.nodes.empty()) return;
+
+	NestedTreeNode nestedRoot;
+	buildNested(octree, 0, nestedRoot);
+
+	vector<Ray> rays;
+	vector<Box> boxes;
+	makeDownwardRays(octree.root().box, numQueries, rays);
+	makeQueryBoxes(octree.root().box, numQueries, boxes);
+
+	cout << "Octree layout: " << octree.nodes.size() << " nodes, "
+		<< numQueries << " queries" << endl;
+
+	int hits = 0;
+	uint64_t t1 = ofGetElapsedTimeMicros();
+	for (int i = 0; i < rays.size(); i++) {
+		NestedTreeNode nodeRtn;
+		if (intersectNested(rays[i], nestedRoot, nodeRtn)) hits++;
+	}
+	uint64_t t2 = ofGetElapsedTimeMicros();
+	report("ray, nested children all leaves", numQueries, t2 - t1, hits);
+
+	hits = 0;
+	t1 = ofGetElapsedTimeMicros();
+	for (int i = 0; i < rays.size(); i++) {
+		RayHit hit;
+		if (octree.intersect(rays[i], hit)) hits++;
+	}
+	t2 = ofGetElapsedTimeMicros();
+	report("ray, flat array nearest hit", numQueries, t2 - t1, hits);
+
+	hits = 0;
+	t1 = ofGetElapsedTimeMicros();
+	for (int i = 0; i < boxes.size(); i++) {
+		vector<Box> boxList;
+		if (intersectNested(boxes[i], nestedRoot, boxList)) hits++;
+	}
+	t2 = ofGetElapsedTimeMicros();
+	report("box, nested children", numQueries, t2 - t1, hits);
+
+	hits = 0;
+	t1 = ofGetElapsedTimeMicros();
+	for (int i = 0; i < boxes.size(); i++) {
+		vector<Box> boxList;
+		if (octree.intersect(boxes[i], boxList)) hits++;
+	}
+	t2 = ofGetElapsedTimeMicros();
+	report("box, flat array", numQueries, t2 - t1, hits);
+
+	hits = 0;
+	t1 = ofGetElapsedTimeMicros();
+	for (int i = 0; i < boxes.size(); i++) {
+		if (octree.overlap(boxes[i])) hits++;
+	}
+	t2 = ofGetElapsedTimeMicros();
+	report("box, flat array any hit", numQueries, t2 - t1, hits);
+
+	hits = 0;
+	vector<int> found;
+	t1 = ofGetElapsedTimeMicros();
+	for (int i = 0; i < boxes.size(); i++) {
+		if (octree.getIndicesInBox(boxes[i], found) > 0) hits++;
+	}
+	t2 = ofGetElapsedTimeMicros();
+	report(string("box, flat array ") + (octree.bUseFaces ? "faces" : "vertices") + " in box",
+		numQueries, t2 - t1, hits);
+}
+
+// the mesh an octree was built from.  An octree loaded from a TerrainPack
+// has no ofMesh, so one is made from its vertex and index arrays.
+//
+static ofMesh sourceMesh(const SpatialIndex& index) {
+	ofMesh mesh;
+	mesh.addVertices(index.vertices.data(), index.vertices.size());
+	mesh.addIndices(index.meshIndices.data(), index.meshIndices.size());
+	return mesh;
+}
+
+// true if both trees have exactly the same nodes in the same order
+//
+static bool sameTree(const Octree& a, const Octree& b) {
+	if (a.nodes.size() != b.nodes.size()) return false;
+	for (int i = 0; i < a.nodes.size(); i++) {
+		const TreeNode& n = a.nodes[i];
+		const TreeNode& m = b.nodes[i];
+		if (n.box.min() != m.box.min() || n.box.max() != m.box.max()) return false;
+		if (n.firstChild != m.firstChild || n.childMask != m.childMask) return false;
+		if (n.begin != m.begin || n.end != m.end) return false;
+	}
+	return a.indices.size() == b.indices.size() &&
+		std::equal(a.indices.begin(), a.indices.end(), b.indices.begin());
+}
+
+void benchmarkOctreeBuild(const Octree& octree) {
+	int cores = std::max(1, (int)std::thread::hardware_concurrency());
+	cout << "Octree build: " << octree.levels << " levels, "
+		<< (octree.bUseFaces ? "faces" : "points") << ", 1.." << cores << " threads" << endl;
+
+	ofMesh mesh = sourceMesh(octree);
+	Octree serial;
+	for (int threads = 1; threads <= cores; threads++) {
+		Octree tree;
+		tree.bUseFaces = octree.bUseFaces;
+		tree.settings = octree.settings;
+		tree.numThreads = threads;
+		uint64_t t1 = ofGetElapsedTimeMicros();
+		tree.create(mesh, octree.levels);
+		uint64_t t2 = ofGetElapsedTimeMicros();
+		cout << "  " << threads << " threads: " << (t2 - t1) / 1000.0 << " ms";
+		if (threads == 1) {
+			cout << endl;
+			serial = std::move(tree);
+		}
+		else cout << (sameTree(serial, tree) ? ", same tree" : ", TREE DIFFERS") << endl;
+	}
+}
+
+void benchmarkOctreeBuilders(const Octree& octree, int numQueries) {
+	const char* names[2] = { "top-down", "morton" };
+	OctreeBuilder builders[2] = { TopDownBuilder, MortonBuilder };
+
+	cout << "Octree builders: " << octree.levels << " levels, "
+		<< (octree.bUseFaces ? "faces" : "points") << endl;
+
+	vector<Ray> rays;
+	makeDownwardRays(octree.root().box, numQueries, rays);
+	ofMesh mesh = sourceMesh(octree);
+
+	for (int b = 0; b < 2; b++) {
+		Octree tree;
+		tree.bUseFaces = octree.bUseFaces;
+		tree.settings = octree.settings;
+		tree.numThreads = octree.numThreads;
+		uint64_t t1 = ofGetElapsedTimeMicros();
+		tree.create(mesh, octree.levels, builders[b]);
+		uint64_t t2 = ofGetElapsedTimeMicros();
+		cout << "  " << names[b] << " build: " << (t2 - t1) / 1000.0 << " ms, "
+			<< tree.nodes.size() << " nodes" << endl;
+
+		int hits = 0;
+		t1 = ofGetElapsedTimeMicros();
+		for (int i = 0; i < rays.size(); i++) {
+			RayHit hit;
+			if (tree.intersect(rays[i], hit)) hits++;
+		}
+		t2 = ofGetElapsedTimeMicros();
+		report(string(names[b]) + " ray", numQueries, t2 - t1, hits);
+	}
+}
+
+//  Single rays against packets on one octree, and the rays whose results
+//  differ.
+//
+static void comparePackets(const Octree& octree, int numQueries) {
+	const char* names[3] = { "random", "probe bundles", "tilted bundles" };
+	vector<Ray> rays[3];
+	makeDownwardRays(octree.root().box, numQueries, rays[0]);
+	makeProbeRays(octree.root().box, numQueries, 0.5, rays[1]);
+	string mode = octree.bUseFaces ? "faces, " : "points, ";
+
+	// the probe bundles with each ray tilted, so the rays of a packet part
+	// and enter the nodes at different distances
+	//
+	std::mt19937 rng(5);
+	std::uniform_real_distribution<float> tilt(-0.5, 0.5);
+	for (const Ray& ray : rays[1]) {
+		rays[2].push_back(Ray(ray.origin, Vector3(tilt(rng), -1, tilt(rng))));
+	}
+
+	for (int r = 0; r < 3; r++) {
+		vector<RayHit> single(rays[r].size());
+		int hits = 0;
+		uint64_t t1 = ofGetElapsedTimeMicros();
+		for (int i = 0; i < rays[r].size(); i++) {
+			if (octree.intersect(rays[r][i], single[i])) hits++;
+			else single[i].leaf = -1;
+		}
+		uint64_t t2 = ofGetElapsedTimeMicros();
+		report(mode + names[r] + ", single ray loop", numQueries, t2 - t1, hits);
+
+		vector<RayHit> batch;
+		t1 = ofGetElapsedTimeMicros();
+		hits = octree.intersect(rays[r], batch);
+		t2 = ofGetElapsedTimeMicros();
+		report(mode + names[r] + ", packets", numQueries, t2 - t1, hits);
+
+		int differ = 0;
+		for (int i = 0; i < rays[r].size(); i++) {
+			if (single[i].leaf != batch[i].leaf || (single[i].leaf >= 0 && single[i].index != batch[i].index)) differ++;
+		}
+		if (differ > 0) cout << "  " << differ << " RAYS DIFFER" << endl;
+	}
+}
+
+void benchmarkOctreePackets(const Octree& octree, int numQueries) {
+	if (octree.nodes.empty()) return;
+
+	cout << "Octree batch rays: packets of " << Octree::PacketSize << ", "
+		<< numQueries << " queries" << endl;
+	comparePackets(octree, numQueries);
+
+	// point mode ends a lane at the first leaf it enters, so it takes other
+	// paths through the packet traversal
+	//
+	if (octree.bUseFaces) {
+		Octree points;
+		points.bUseFaces = false;
+		points.settings = octree.settings;
+		points.numThreads = octree.numThreads;
+		points.create(sourceMesh(octree), octree.levels, octree.builder);
+		comparePackets(points, numQueries);
+	}
+}
+
+void benchmarkBoxKernels(const Box& bounds, int numQueries) {
+	vector<Ray> rays;
+	vector<Box> boxes;
+	makeDownwardRays(bounds, numQueries, rays);
+	makeQueryBoxes(bounds, 8, boxes);
+
+	// make the boxes reach the ground so roughly half the rays hit one
+	//
+	for (int i = 0; i < boxes.size(); i++) {
+		Vector3 min = boxes[i].min(), max = boxes[i].max();
+		float size = (bounds.max().x() - bounds.min().x()) / 4;
+		boxes[i] = Box(Vector3(min.x() - size, bounds.min().y(), min.z() - size),
+			Vector3(max.x() + size, max.y(), max.z() + size));
+	}
+	Box8 box8;
+	for (int i = 0; i < 8; i++) box8.set(i, boxes[i].min(), boxes[i].max());
+
+	cout << "Box kernels: " << numQueries << " rays x 8 boxes" << endl;
+#ifndef SIMD_SSE
+	cout << "  (no SSE, both columns are scalar)" << endl;
+#endif
+
+	int hits = 0;
+	float tEnter;
+	uint64_t t1 = ofGetElapsedTimeMicros();
+	for (int i = 0; i < rays.size(); i++) {
+		for (int j = 0; j < 8; j++) {
+			if (slabTestScalar(rays[i], boxes[j].parameters[0], boxes[j].parameters[1], 0, INFINITE, tEnter)) hits++;
+		}
+	}
+	uint64_t t2 = ofGetElapsedTimeMicros();
+	report("ray/box scalar", numQueries * 8, t2 - t1, hits);
+
+	hits = 0;
+	t1 = ofGetElapsedTimeMicros();
+	for (int i = 0; i < rays.size(); i++) {
+		for (int j = 0; j < 8; j++) {
+			if (slabTest(rays[i], boxes[j].parameters[0], boxes[j].parameters[1], 0, INFINITE, tEnter)) hits++;
+		}
+	}
+	t2 = ofGetElapsedTimeMicros();
+	report("ray/box simd", numQueries * 8, t2 - t1, hits);
+
+	hits = 0;
+	float tChildren[8];
+	t1 = ofGetElapsedTimeMicros();
+	for (int i = 0; i < rays.size(); i++) {
+		hits += TreeNode::bitCount(slabTest8Scalar(rays[i], box8, 8, 0, INFINITE, tChildren));
+	}
+	t2 = ofGetElapsedTimeMicros();
+	report("ray/8 boxes scalar", numQueries * 8, t2 - t1, hits);
+
+	hits = 0;
+	t1 = ofGetElapsedTimeMicros();
+	for (int i = 0; i < rays.size(); i++) {
+		hits += TreeNode::bitCount(slabTest8(rays[i], box8, 8, 0, INFINITE, tChildren));
+	}
+	t2 = ofGetElapsedTimeMicros();
+	report("ray/8 boxes simd", numQueries * 8, t2 - t1, hits);
+
+	// the simd kernels must give the scalar results, also for rays lying in
+	// a face of a box (whose slab distance on that axis is NaN)
+	//
+	vector<Ray> checks = rays;
+	for (int j = 0; j < 8; j++) {
+		Vector3 min = boxes[j].min(), max = boxes[j].max();
+		float x = (min.x() + max.x()) / 2, y = max.y() + 10, z = (min.z() + max.z()) / 2;
+		checks.push_back(Ray(Vector3(min.x(), y, z), Vector3(0, -1, 0)));
+		checks.push_back(Ray(Vector3(max.x(), y, z), Vector3(0, -1, 0)));
+		checks.push_back(Ray(Vector3(x, y, min.z()), Vector3(0, -1, 0)));
+		checks.push_back(Ray(Vector3(x, y, max.z()), Vector3(0, -1, 0)));
+	}
+	int differ = 0;
+	float tSimd[8];
+	for (int i = 0; i < checks.size(); i++) {
+		for (int j = 0; j < 8; j++) {
+			float t;
+			bool hit = slabTestScalar(checks[i], boxes[j].parameters[0], boxes[j].parameters[1], 0, INFINITE, tEnter);
+			if (hit != slabTest(checks[i], boxes[j].parameters[0], boxes[j].parameters[1], 0, INFINITE, t) || (hit && t != tEnter)) differ++;
+		}
+		unsigned int mask = slabTest8Scalar(checks[i], box8, 8, 0, INFINITE, tChildren);
+		if (mask != slabTest8(checks[i], box8, 8, 0, INFINITE, tSimd)) differ++;
+		for (int j = 0; j < 8; j++) {
+			if ((mask >> j & 1) && tChildren[j] != tSimd[j]) differ++;
+		}
+	}
+	if (differ > 0) cout << "  " << differ << " SIMD RESULTS DIFFER FROM SCALAR" << endl;
+
+	vector<Box> queries;
+	makeQueryBoxes(bounds, numQueries, queries);
+	hits = 0;
+	t1 = ofGetElapsedTimeMicros();
+	for (int i = 0; i < queries.size(); i++) {
+		for (int j = 0; j < 8; j++) {
+			if (overlapTestScalar(queries[i].parameters[0], queries[i].parameters[1],
+				boxes[j].parameters[0], boxes[j].parameters[1])) hits++;
+		}
+	}
+	t2 = ofGetElapsedTimeMicros();
+	report("box/box scalar", numQueries * 8, t2 - t1, hits);
+
+	hits = 0;
+	t1 = ofGetElapsedTimeMicros();
+	for (int i = 0; i < queries.size(); i++) {
+		for (int j = 0; j < 8; j++) {
+			if (queries[i].overlap(boxes[j])) hits++;
+		}
+	}
+	t2 = ofGetElapsedTimeMicros();
+	report("box/box simd", numQueries * 8, t2 - t1, hits);
+}
+
+void reportOctreeShape(const Octree& octree) {
+	if (octree.nodes.empty()) return;
+
+	IndexStats stats = octree.getStats();
+	cout << "  depth " << stats.nodesAtDepth.size() - 1 << ", " << stats.numLeaves
+		<< " leaves, mean leaf depth " << stats.meanLeafDepth << ", mean "
+		<< (octree.bUseFaces ? "faces" : "points") << "/leaf " << stats.meanLeafSize << endl;
+	cout << "  nodes (leaves) by depth:";
+	for (int d = 0; d < stats.nodesAtDepth.size(); d++) {
+		cout << " " << d << ":" << stats.nodesAtDepth[d] << "(" << stats.leavesAtDepth[d] << ")";
+	}
+	cout << endl << "  leaves by size:";
+	for (int b = 0; b < IndexStats::NumLeafSizes; b++) {
+		if (stats.leafSizes[b]) cout << " " << IndexStats::leafSizeName(b) << ":" << stats.leafSizes[b];
+	}
+	cout << endl;
+}
+
+void benchmarkOctreeSettings(const Octree& octree, int numQueries) {
+	if (octree.nodes.empty()) return;
+
+	Vector3 size = octree.root().box.max() - octree.root().box.min();
+	float extent = std::max(size.x(), std::max(size.y(), size.z()));
+
+	vector<string> names;
+	vector<OctreeSettings> configs;
+	OctreeSettings s;
+	names.push_back("default");
+	configs.push_back(s);
+	int leafSizes[3] = { 2, 8, 16 };
+	for (int i = 0; i < 3; i++) {
+		s = OctreeSettings();
+		s.maxPointsPerLeaf = s.maxFacesPerLeaf = leafSizes[i];
+		names.push_back("leaf size " + ofToString(leafSizes[i]));
+		configs.push_back(s);
+	}
+	s = OctreeSettings();
+	s.minExtent = extent / 64;
+	names.push_back("min extent " + ofToString(s.minExtent));
+	configs.push_back(s);
+	s = OctreeSettings();
+	s.useCostModel = true;
+	names.push_back("cost model");
+	configs.push_back(s);
+
+	cout << "Octree settings: " << octree.levels << " levels, "
+		<< (octree.bUseFaces ? "faces" : "points") << endl;
+
+	vector<Ray> rays;
+	makeDownwardRays(octree.root().box, numQueries, rays);
+	ofMesh mesh = sourceMesh(octree);
+
+	for (int c = 0; c < configs.size(); c++) {
+		Octree tree;
+		tree.bUseFaces = octree.bUseFaces;
+		tree.settings = configs[c];
+		tree.numThreads = octree.numThreads;
+		uint64_t t1 = ofGetElapsedTimeMicros();
+		tree.create(mesh, octree.levels, octree.builder);
+		uint64_t t2 = ofGetElapsedTimeMicros();
+		size_t bytes = tree.nodes.size() * sizeof(TreeNode) + tree.indices.size() * sizeof(int);
+		cout << " " << names[c] << ": build " << (t2 - t1) / 1000.0 << " ms, "
+			<< tree.nodes.size() << " nodes, " << bytes / 1024 << " KB" << endl;
+
+		int hits = 0;
+		t1 = ofGetElapsedTimeMicros();
+		for (int i = 0; i < rays.size(); i++) {
+			RayHit hit;
+			if (tree.intersect(rays[i], hit)) hits++;
+		}
+		t2 = ofGetElapsedTimeMicros();
+		report("ray", numQueries, t2 - t1, hits);
+
+		// count the work per ray in a separate, untimed pass
+		//
+		tree.bCountQueries = true;
+		for (int i = 0; i < rays.size(); i++) {
+			RayHit hit;
+			tree.intersect(rays[i], hit);
+		}
+		const QueryCounters& q = tree.counters;
+		cout << "  per ray: " << (double)q.nodesVisited / q.queries << " nodes visited, "
+			<< (double)q.boxesTested / q.queries << " boxes tested, "
+			<< (double)q.primitivesTested / q.queries << (tree.bUseFaces ? " faces" : " points") << " tested" << endl;
+		reportOctreeShape(tree);
+	}
+}
+
+//  Node layout used before the index array, where each node owned a copy
+//  of the indices of every point below it.
+//
+class PointVectorNode {
+public:
+	Box box;
+	vector<int> points;
+	int firstChild;
+	unsigned char childMask;
+};
+
+void reportOctreeMemory(const Octree& octree) {
+	int numVerts = std::max(1, (int)octree.vertices.size());
+
+	size_t nodeBytes = octree.nodes.size() * sizeof(TreeNode);
+	size_t indexBytes = octree.indices.size() * sizeof(int);
+	size_t total = nodeBytes + indexBytes;
+
+	// the previous layout stored each index once per level it appeared on
+	//
+	size_t oldTotal = octree.nodes.size() * sizeof(PointVectorNode);
+	for (int i = 0; i < octree.nodes.size(); i++) {
+		oldTotal += octree.nodes[i].numPoints() * sizeof(int);
+	}
+
+	cout << "Octree memory: " << octree.nodes.size() << " nodes, "
+		<< numVerts << " vertices" << endl;
+	cout << "  per-node point vectors: " << oldTotal / 1024 << " KB, "
+		<< (double)oldTotal / numVerts << " bytes/vertex" << endl;
+	cout << "  index ranges: " << total / 1024 << " KB (nodes " << nodeBytes / 1024
+		<< " KB, indices " << indexBytes / 1024 << " KB), "
+		<< (double)total / numVerts << " bytes/vertex" << endl;
+}
+
+//  One row per index:  build, shape and memory, then query throughput.
+//  Nodes visited and faces tested per ray come from a separate counted pass
+//  so counting does not slow down the timed one.
+//
+static void benchmarkIndex(SpatialIndex& index, const vector<Ray>& rays,
+	const vector<Ray>& probes, const vector<Box>& boxes, vector<RayHit>& hitsRtn) {
+	IndexStats stats = index.getStats();
+	cout << "  " << index.name() << ": build " << stats.buildMillis << " ms, "
+		<< stats.numNodes << " nodes, " << stats.numLeaves << " leaves, "
+		<< stats.totalBytes() / 1024 << " KB, mean leaf depth " << stats.meanLeafDepth
+		<< ", " << stats.meanLeafSize << " faces/leaf" << endl;
+
+	int hits = 0;
+	hitsRtn.resize(rays.size());
+	uint64_t t1 = ofGetElapsedTimeMicros();
+	for (int i = 0; i < rays.size(); i++) {
+		if (index.intersect(rays[i], hitsRtn[i])) hits++;
+		else hitsRtn[i].leaf = -1;
+	}
+	uint64_t t2 = ofGetElapsedTimeMicros();
+	report(string("  ") + index.name() + " ray", rays.size(), t2 - t1, hits);
+
+	vector<RayHit> probeHits;
+	t1 = ofGetElapsedTimeMicros();
+	hits = index.intersect(ArrayView<Ray>(probes), probeHits);
+	t2 = ofGetElapsedTimeMicros();
+	report(string("  ") + index.name() + " probe batch", probes.size(), t2 - t1, hits);
+
+	hits = 0;
+	t1 = ofGetElapsedTimeMicros();
+	for (int i = 0; i < boxes.size(); i++) {
+		if (index.overlap(boxes[i])) hits++;
+	}
+	t2 = ofGetElapsedTimeMicros();
+	report(string("  ") + index.name() + " box overlap", boxes.size(), t2 - t1, hits);
+
+	index.counters.reset();
+	index.bCountQueries = true;
+	for (int i = 0; i < rays.size(); i++) {
+		RayHit hit;
+		index.intersect(rays[i], hit);
+	}
+	index.bCountQueries = false;
+	double n = std::max(1, (int)rays.size());
+	cout << "    per ray: " << index.counters.nodesVisited / n << " nodes, "
+		<< index.counters.boxesTested / n << " boxes, "
+		<< index.counters.primitivesTested / n << " faces" << endl;
+	index.counters.reset();
+}
+
+void benchmarkSpatialIndexes(const SpatialIndex& index, int numLevels, int numQueries) {
+	ofMesh mesh = sourceMesh(index);
+	Octree octree;
+	octree.bUseFaces = true;
+	octree.create(mesh, numLevels);
+	BVH bvh;
+	bvh.create(mesh);
+
+	vector<Ray> rays, probes;
+	vector<Box> boxes;
+	makeDownwardRays(bvh.bounds(), numQueries, rays);
+	makeProbeRays(bvh.bounds(), numQueries, 2, probes);
+	makeQueryBoxes(bvh.bounds(), numQueries, boxes);
+
+	cout << "Spatial indexes: " << bvh.getNumFaces() << " faces, " << numQueries
+		<< " queries, octree " << numLevels << " levels" << endl;
+	vector<RayHit> octreeHits, bvhHits;
+	benchmarkIndex(octree, rays, probes, boxes, octreeHits);
+	benchmarkIndex(bvh, rays, probes, boxes, bvhHits);
+
+	// both must find the same nearest hit (faces can tie at shared edges, so
+	// compare distances, not face indices)
+	//
+	int differ = 0;
+	for (int i = 0; i < rays.size(); i++) {
+		bool a = octreeHits[i].leaf >= 0, b = bvhHits[i].leaf >= 0;
+		if (a != b || (a && fabs(octreeHits[i].t - bvhHits[i].t) > 1e-3f)) differ++;
+	}
+	cout << "  hits that differ: " << differ << endl;
+}
+
+void benchmarkHeightField(const SpatialIndex& index, int numQueries) {
+	HeightField field;
+	field.create(index);
+	int numCells = field.numCellsX * field.numCellsZ;
+	size_t bytes = field.cellStart.size() * sizeof(int) + field.cellFaces.size() * sizeof(int) +
+		field.overhang.size();
+	cout << "Height field: " << field.numCellsX << " x " << field.numCellsZ << " cells, "
+		<< (double)field.cellFaces.size() / std::max(numCells, 1) << " faces/cell, "
+		<< field.numOverhangs << " overhang cells, " << bytes / 1024 << " KB, build "
+		<< field.buildMillis << " ms" << endl;
+
+	vector<Ray> rays;
+	makeDownwardRays(index.bounds(), numQueries, rays);
+	vector<RayHit> rayHits(rays.size());
+	int hits = 0;
+	uint64_t t1 = ofGetElapsedTimeMicros();
+	for (int i = 0; i < rays.size(); i++) {
+		if (index.intersect(rays[i], rayHits[i])) hits++;
+		else rayHits[i].leaf = -1;
+	}
+	uint64_t t2 = ofGetElapsedTimeMicros();
+	report(string("ground, ") + index.name() + " ray", rays.size(), t2 - t1, hits);
+
+	vector<GroundHit> groundHits(rays.size());
+	vector<char> found(rays.size());
+	hits = 0;
+	t1 = ofGetElapsedTimeMicros();
+	for (int i = 0; i < rays.size(); i++) {
+		const Vector3& o = rays[i].origin;
+		found[i] = field.groundBelow(glm::vec3(o.x(), o.y(), o.z()), groundHits[i]);
+		hits += found[i];
+	}
+	t2 = ofGetElapsedTimeMicros();
+	report("ground, height field", rays.size(), t2 - t1, hits);
+
+	int differ = 0, fallbacks = 0;
+	for (int i = 0; i < rays.size(); i++) {
+		const Vector3& o = rays[i].origin;
+		if (field.isOverhang(o.x(), o.z())) fallbacks++;
+		bool a = rayHits[i].leaf >= 0, b = found[i];
+		if (a != b || (a && fabs(rayHits[i].point.y - groundHits[i].point.y) > 1e-3f)) differ++;
+	}
+	cout << "  lookups that used the index: " << fallbacks << ", heights that differ: "
+		<< differ << endl;
+}
+
+void benchmarkDynamicOctree(const Box& bounds, int numObjects, int numFrames) {
+	std::mt19937 rng(4);
+	std::uniform_real_distribution<float> rx(bounds.min().x(), bounds.max().x());
+	std::uniform_real_distribution<float> ry(bounds.min().y(), bounds.max().y());
+	std::uniform_real_distribution<float> rz(bounds.min().z(), bounds.max().z());
+	std::uniform_real_distribution<float> rv(-1, 1);
+	std::uniform_real_distribution<float> rs(0.1f, 1);
+
+	// particles:  a position, a velocity and a size
+	//
+	vector<glm::vec3> pos(numObjects), vel(numObjects);
+	vector<float> size(numObjects);
+	for (int i = 0; i < numObjects; i++) {
+		pos[i] = glm::vec3(rx(rng), ry(rng), rz(rng));
+		vel[i] = glm::vec3(rv(rng), rv(rng), rv(rng));
+		size[i] = rs(rng);
+	}
+	auto boxOf = [&](int i) {
+		Vector3 c(pos[i].x, pos[i].y, pos[i].z), h(size[i], size[i], size[i]);
+		return Box(c - h, c + h);
+	};
+	vector<Box> queries;
+	makeQueryBoxes(bounds, 1000, queries);
+
+	cout << "Dynamic octree: " << numObjects << " objects, " << numFrames << " frames" << endl;
+	DynamicOctree tree;
+	tree.create(bounds);
+	uint64_t t1 = ofGetElapsedTimeMicros();
+	for (int i = 0; i < numObjects; i++) tree.insert(i, boxOf(i));
+	uint64_t t2 = ofGetElapsedTimeMicros();
+	report("insert", numObjects, t2 - t1, tree.size());
+
+	uint64_t moveMicros = 0, rebuildMicros = 0;
+	for (int f = 0; f < numFrames; f++) {
+		for (int i = 0; i < numObjects; i++) pos[i] += vel[i] * 0.1f;
+		t1 = ofGetElapsedTimeMicros();
+		for (int i = 0; i < numObjects; i++) tree.move(i, boxOf(i));
+		t2 = ofGetElapsedTimeMicros();
+		moveMicros += t2 - t1;
+
+		DynamicOctree rebuilt;
+		t1 = ofGetElapsedTimeMicros();
+		rebuilt.create(bounds);
+		for (int i = 0; i < numObjects; i++) rebuilt.insert(i, boxOf(i));
+		t2 = ofGetElapsedTimeMicros();
+		rebuildMicros += t2 - t1;
+	}
+	report("move all, per frame", numObjects * numFrames, moveMicros, tree.size());
+	report("rebuild, per frame", numObjects * numFrames, rebuildMicros, tree.size());
+
+	// box queries against brute force over the current positions
+	//
+	int found = 0, differ = 0;
+	vector<int> ids;
+	t1 = ofGetElapsedTimeMicros();
+	for (int q = 0; q < queries.size(); q++) found += tree.query(queries[q], ids);
+	t2 = ofGetElapsedTimeMicros();
+	report("box query", queries.size(), t2 - t1, found);
+
+	int bruteFound = 0;
+	t1 = ofGetElapsedTimeMicros();
+	for (int q = 0; q < queries.size(); q++) {
+		for (int i = 0; i < numObjects; i++) {
+			if (boxOf(i).overlap(queries[q])) bruteFound++;
+		}
+	}
+	t2 = ofGetElapsedTimeMicros();
+	report("box query, brute force", queries.size(), t2 - t1, bruteFound);
+	for (int q = 0; q < queries.size(); q++) {
+		int n = tree.query(queries[q], ids);
+		int m = 0;
+		for (int i = 0; i < numObjects; i++) m += boxOf(i).overlap(queries[q]);
+		if (n != m) differ++;
+	}
+
+	// remove half, check the rest are still found
+	//
+	t1 = ofGetElapsedTimeMicros();
+	for (int i = 0; i < numObjects; i += 2) tree.remove(i);
+	t2 = ofGetElapsedTimeMicros();
+	report("remove half", numObjects / 2, t2 - t1, tree.size());
+	for (int q = 0; q < queries.size(); q++) {
+		tree.query(queries[q], ids);
+		int m = 0;
+		for (int i = 1; i < numObjects; i += 2) m += boxOf(i).overlap(queries[q]);
+		if (ids.size() != m) differ++;
+	}
+	cout << "  queries that differ from brute force: " << differ << ", nodes in use: "
+		<< tree.nodes.size() - tree.freeNodes.size() << endl;
+}
+
+void benchmarkCompactOctree(const Octree& octree, int numQueries) {
+	ofMesh mesh = sourceMesh(octree);
+	Octree full;
+	full.bUseFaces = true;
+	full.settings = octree.settings;
+	full.create(mesh, octree.levels);
+	CompactOctree compact;
+	compact.create(full);
+
+	// every decoded box must contain the box it was encoded from
+	//
+	int notContained = 0;
+	vector<Box> decoded(compact.nodes.size());
+	decoded[0] = compact.rootBox;
+	for (int i = 0; i < compact.nodes.size(); i++) {
+		const CompactNode& n = compact.nodes[i];
+		Vector3 dMin = decoded[i].min(), dMax = decoded[i].max();
+		Vector3 bMin = full.nodes[i].box.min(), bMax = full.nodes[i].box.max();
+		if (dMin.x() > bMin.x() || dMin.y() > bMin.y() || dMin.z() > bMin.z() ||
+			dMax.x() < bMax.x() || dMax.y() < bMax.y() || dMax.z() < bMax.z()) notContained++;
+		if (n.isLeaf()) continue;
+		for (int c = 0; c < n.numChildren; c++) {
+			decoded[n.first + c] = CompactOctree::childBox(decoded[i], compact.nodes[n.first + c]);
+		}
+	}
+
+	vector<Ray> rays, probes;
+	vector<Box> boxes;
+	makeDownwardRays(full.bounds(), numQueries, rays);
+	makeProbeRays(full.bounds(), numQueries, 2, probes);
+	makeQueryBoxes(full.bounds(), numQueries, boxes);
+
+	cout << "Compact octree: " << full.nodes.size() << " nodes, " << sizeof(TreeNode) << " -> "
+		<< sizeof(CompactNode) << " bytes/node, nodes " << full.nodes.size() * sizeof(TreeNode) / 1024
+		<< " -> " << compact.nodes.size() * sizeof(CompactNode) / 1024 << " KB, "
+		<< notContained << " boxes not contained" << endl;
+	vector<RayHit> fullHits, compactHits;
+	benchmarkIndex(full, rays, probes, boxes, fullHits);
+	benchmarkIndex(compact, rays, probes, boxes, compactHits);
+
+	int differ = 0;
+	for (int i = 0; i < rays.size(); i++) {
+		bool a = fullHits[i].leaf >= 0, b = compactHits[i].leaf >= 0;
+		if (a != b || (a && fabs(fullHits[i].t - compactHits[i].t) > 1e-5f)) differ++;
+	}
+	cout << "  hits that differ: " << differ << endl;
+
+	// box queries are conservative:  the compact octree may report more
+	// overlaps than the octree, never fewer
+	//
+	int extra = 0, missed = 0;
+	for (int i = 0; i < boxes.size(); i++) {
+		bool a = full.overlap(boxes[i]), b = compact.overlap(boxes[i]);
+		extra += b && !a;
+		missed += a && !b;
+	}
+	cout << "  box overlaps that differ: " << extra << " extra, " << missed << " missed" << endl;
+}
+
+void benchmarkPagedOctree(const Octree& octree, int numQueries) {
+	if (!octree.bUseFaces || octree.nodes.empty()) return;
+	string path = ofToDataPath("benchmark.pages");
+	uint64_t t1 = ofGetElapsedTimeMicros();
+	if (!PagedOctree::save(path, 0, octree, 64 * 1024)) {
+		cout << "Paged octree: could not write " << path << endl;
+		return;
+	}
+	uint64_t t2 = ofGetElapsedTimeMicros();
+
+	PagedOctree paged;
+	paged.open(path, 0, SIZE_MAX);
+	size_t totalBytes = paged.totalPageBytes();
+	cout << "Paged octree: " << paged.numPages() << " pages, " << paged.top.size() << " top nodes, "
+		<< totalBytes / 1024 << " KB of pages, written in " << (t2 - t1) / 1000.0 << " ms" << endl;
+
+	// a flight across the terrain:  every frame, probe rays around the
+	// rocket and a box query at the ground below it.  The sleep stands in
+	// for the rest of the frame, when the loader thread can read ahead.
+	//
+	Box bounds = octree.bounds();
+	Vector3 size = bounds.max() - bounds.min();
+	glm::vec3 from(bounds.min().x(), bounds.max().y() + 1, bounds.min().z());
+	glm::vec3 to(bounds.max().x(), bounds.max().y() + 1, bounds.max().z());
+	int numFrames = 200;
+	float frameTime = 1.0f / 60;
+	glm::vec3 velocity = (to - from) / (numFrames * frameTime);
+	float radius = std::max(size.x(), size.z()) / 50;
+	int raysPerFrame = std::max(1, numQueries / numFrames);
+	std::uniform_real_distribution<float> offset(-radius, radius);
+
+	struct Run { const char* name; size_t budget; bool bPrefetch; };
+	Run runs[] = {
+		{ "all in memory", SIZE_MAX, false },
+		{ "1/4 budget", totalBytes / 4, false },
+		{ "1/4 budget, prefetch", totalBytes / 4, true },
+		{ "1/16 budget", totalBytes / 16, false },
+		{ "1/16 budget, prefetch", totalBytes / 16, true },
+	};
+	for (const Run& run : runs) {
+		paged.open(path, 0, run.budget);
+		std::mt19937 rng(4);
+		int hits = 0, differ = 0;
+		uint64_t micros = 0;
+		for (int f = 0; f < numFrames; f++) {
+			glm::vec3 p = from + velocity * (f * frameTime);
+			if (run.bPrefetch) {
+				paged.prefetch(p, velocity, 1.0f, radius);
+				paged.update();
+			}
+			for (int i = 0; i < raysPerFrame; i++) {
+				Ray ray(Vector3(p.x + offset(rng), p.y, p.z + offset(rng)), Vector3(0, -1, 0));
+				RayHit hit, expected;
+				t1 = ofGetElapsedTimeMicros();
+				bool found = paged.intersect(ray, hit);
+				micros += ofGetElapsedTimeMicros() - t1;
+				if (found) hits++;
+				if (found != octree.intersect(ray, expected) || (found && fabs(hit.t - expected.t) > 1e-5f)) differ++;
+			}
+			Box box(Vector3(p.x - 1, bounds.min().y(), p.z - 1), Vector3(p.x + 1, bounds.max().y(), p.z + 1));
+			t1 = ofGetElapsedTimeMicros();
+			bool any = paged.overlap(box);
+			micros += ofGetElapsedTimeMicros() - t1;
+			if (any != octree.overlap(box)) differ++;
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		}
+		cout << "  " << run.name << ": " << micros / 1000.0 << " ms in queries, " << hits << " hits, "
+			<< paged.stats.faults << " faults, " << paged.stats.prefetched << " prefetched, "
+			<< paged.stats.evictions << " evictions, " << paged.residentBytes() / 1024
+			<< " KB resident, " << differ << " results differ" << endl;
+	}
+	paged.close();
+	std::remove(path.c_str());
+}
+
+void benchmarkOctree(Octree& octree, int numQueries) {
+	reportOctreeMemory(octree);
+	benchmarkBoxKernels(octree.root().box, numQueries);
+	benchmarkOctreeBuild(octree);
+	benchmarkOctreeBuilders(octree, numQueries);
+	benchmarkOctreeSettings(octree, numQueries);
+	benchmarkOctreeLayout(octree, numQueries);
+	benchmarkOctreePackets(octree, numQueries);
+	benchmarkCompactOctree(octree, numQueries);
+	benchmarkPagedOctree(octree, numQueries);
+	benchmarkSpatialIndexes(octree, octree.levels, numQueries);
+	benchmarkHeightField(octree, numQueries);
+	benchmarkDynamicOctree(octree.root().box, numQueries, 10);
+}
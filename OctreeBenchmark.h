@@ -0,0 +1,109 @@
+#pragma once
+//  Pierce Kyaw, Aye Thwe Tun
+//
+//  Timing harness for the Octree.  Each benchmark prints its results to
+//  cout so they can be compared between runs on the same terrain.
+//
+
+#include "ofMain.h"
+#include "Octree.h"
+#include "BVH.h"
+#include "CompactOctree.h"
+#include "PagedOctree.h"
+#include "HeightField.h"
+#include "DynamicOctree.h"
+
+//  Generate "count" vertical rays that start above the mesh bounds and point
+//  down at random (x, z) positions, like the altitude probes in ofApp::update.
+//  A fixed seed is used so runs are comparable.
+//
+void makeDownwardRays(const Box& bounds, int count, vector<Ray>& raysRtn, unsigned int seed = 1);
+
+//  Generate "count" random boxes of roughly rocket size inside the bounds.
+//
+void makeQueryBoxes(const Box& bounds, int count, vector<Box>& boxesRtn, unsigned int seed = 2);
+
+//  Generate "count" downward rays in bundles of Octree::PacketSize.  The rays
+//  of a bundle start within "spread" of a random point, like the altitude
+//  probes at several points of the rocket's hull.
+//
+void makeProbeRays(const Box& bounds, int count, float spread, vector<Ray>& raysRtn, unsigned int seed = 3);
+
+//  Compare ray and box query throughput of the flat node array against the
+//  previous layout (nested vector<TreeNode> children) built from the same tree.
+//
+void benchmarkOctreeLayout(Octree& octree, int numQueries);
+
+//  Time Octree::create on the octree's mesh with 1..N threads (N = number of
+//  cores) and check that every thread count builds the same tree.
+//
+void benchmarkOctreeBuild(const Octree& octree);
+
+//  Build the octree's mesh with the top-down and the Morton builder and
+//  compare build time, node count and ray query throughput.
+//
+void benchmarkOctreeBuilders(const Octree& octree, int numQueries);
+
+//  Compare the batch (packet) ray query against looping over the single ray
+//  query, for random rays and for bundles of nearby probe rays, and check
+//  that both return the same hits.
+//
+void benchmarkOctreePackets(const Octree& octree, int numQueries);
+
+//  Microbenchmarks of the ray/box and box/box kernels in simd.h:  the
+//  scalar versions against the SSE ones Box and Octree use.
+//
+void benchmarkBoxKernels(const Box& bounds, int numQueries);
+
+//  Print the depth of the octree and how full its leaves are:  nodes and
+//  leaves per depth, and a histogram of points (faces) per leaf.
+//
+void reportOctreeShape(const Octree& octree);
+
+//  Build the octree's mesh with a range of OctreeSettings (leaf size,
+//  minimum extent, cost model) and compare build time, memory, ray query
+//  throughput and the shape of the resulting trees.
+//
+void benchmarkOctreeSettings(const Octree& octree, int numQueries);
+
+//  Print bytes used by the octree, and bytes per mesh vertex, next to what
+//  the same tree used when every node kept its own vector of point indices
+//  (heap allocator overhead is not counted).
+//
+void reportOctreeMemory(const Octree& octree);
+
+//  Compress a copy of the octree (face mode) into a CompactOctree and
+//  compare node memory, ray, probe and box query throughput, and that both
+//  return the same hits.
+//
+void benchmarkCompactOctree(const Octree& octree, int numQueries);
+
+//  Write the octree (face mode) as a pages file and fly across it with
+//  probe rays and box queries, all in memory and with smaller memory
+//  budgets with and without prefetching:  page faults, evictions, query
+//  time, and that the results match the octree's.
+//
+void benchmarkPagedOctree(const Octree& octree, int numQueries);
+
+//  Build the index's mesh as an octree (face mode, numLevels) and as a BVH,
+//  and compare build time, memory, ray, probe and box query throughput, and
+//  that both return the same hits.  Runs the queries through SpatialIndex.
+//
+void benchmarkSpatialIndexes(const SpatialIndex& index, int numLevels, int numQueries);
+
+//  Build a HeightField over the index's mesh and compare ground lookups
+//  below random points against downward ray queries through the index:
+//  throughput, and that both find the same height.
+//
+void benchmarkHeightField(const SpatialIndex& index, int numQueries);
+
+//  Move numObjects random particles inside the bounds for numFrames frames
+//  in a DynamicOctree, and compare moving them against rebuilding the tree
+//  every frame, and box queries against brute force.
+//
+void benchmarkDynamicOctree(const Box& bounds, int numObjects, int numFrames);
+
+//  Run all octree benchmarks, the comparisons against the BVH and the
+//  height field, and the dynamic octree benchmark.
+//
+void benchmarkOctree(Octree& octree, int numQueries);
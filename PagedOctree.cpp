@@ -0,0 +1,565 @@
+//  Pierce Kyaw, Aye Thwe Tun
+//
+//  Out-of-core paged octree.  See PagedOctree.h for the file layout.
+//
+
+#include "PagedOctree.h"
+#include <climits>
+
+static const char pagesMagic[8] = { 'P', 'A', 'G', 'E', 'T', 'R', 'E', 'E' };
+
+// round up to the next multiple of 16
+//
+static uint64_t align16(uint64_t n) {
+	return (n + 15) & ~(uint64_t)15;
+}
+
+uint64_t PageRecord::faceOffset() const {
+	return align16(offset + numNodes * sizeof(TreeNode));
+}
+
+uint64_t PageRecord::vertexOffset() const {
+	return align16(faceOffset() + numFaces * sizeof(int));
+}
+
+size_t PageRecord::bytes() const {
+	return numNodes * sizeof(TreeNode) + numFaces * (sizeof(int) + 3 * sizeof(glm::vec3));
+}
+
+//  Copy the subtree at "root" into nodesRtn (root first, children of a node
+//  next to each other like Octree::nodes).  Nodes with stop[node] set are
+//  copied as leaves.  srcRtn gets the octree node of each copied node.
+//
+static void copySubtree(const Octree& octree, int root, const vector<char>* stop,
+	vector<TreeNode>& nodesRtn, vector<int>& srcRtn) {
+	nodesRtn.assign(1, octree.nodes[root]);
+	srcRtn.assign(1, root);
+	for (int i = 0; i < nodesRtn.size(); i++) {
+		const TreeNode& n = octree.nodes[srcRtn[i]];
+		if (n.isLeaf() || (stop && (*stop)[srcRtn[i]])) {
+			nodesRtn[i].childMask = 0;
+			nodesRtn[i].firstChild = -1;
+			continue;
+		}
+		nodesRtn[i].firstChild = nodesRtn.size();
+		int numChildren = n.numChildren();
+		for (int c = 0; c < numChildren; c++) {
+			nodesRtn.push_back(octree.nodes[n.firstChild + c]);
+			srcRtn.push_back(n.firstChild + c);
+		}
+	}
+}
+
+bool PagedOctree::save(const string& path, uint64_t sourceHash, const Octree& octree, size_t maxPageBytes) {
+	if (octree.nodes.empty() || !octree.bUseFaces) return false;
+
+	// subtree sizes, children before parents.  A node's faces are its
+	// range of indices, so only the node counts need summing.
+	//
+	int numNodes = octree.nodes.size();
+	vector<int> subtreeNodes(numNodes, 1);
+	for (int i = numNodes - 1; i >= 0; i--) {
+		const TreeNode& n = octree.nodes[i];
+		int numChildren = n.numChildren();
+		for (int c = 0; c < numChildren; c++) subtreeNodes[i] += subtreeNodes[n.firstChild + c];
+	}
+
+	// a node can be a page if its subtree fits.  The top of the tree ends
+	// at the first such node on every path.
+	//
+	vector<char> isPage(numNodes, 0);
+	for (int i = 0; i < numNodes; i++) {
+		const TreeNode& n = octree.nodes[i];
+		PageRecord r;
+		r.numNodes = subtreeNodes[i];
+		r.numFaces = n.numPoints();
+		isPage[i] = r.bytes() <= maxPageBytes || n.isLeaf();
+	}
+	vector<TreeNode> topNodes;
+	vector<int> topSrc;
+	copySubtree(octree, 0, &isPage, topNodes, topSrc);
+	vector<int> pageRoots;
+	for (int i = 0; i < topNodes.size(); i++) {
+		if (!topNodes[i].isLeaf()) continue;
+		topNodes[i].begin = pageRoots.size();
+		topNodes[i].end = topNodes[i].begin + 1;
+		pageRoots.push_back(topSrc[i]);
+	}
+
+	PagedOctreeHeader h;
+	memset((void*)&h, 0, sizeof(h));
+	memcpy(h.magic, pagesMagic, sizeof(pagesMagic));
+	h.version = Version;
+	h.nodeSize = sizeof(TreeNode);
+	h.sourceHash = sourceHash;
+	const Box& bounds = octree.root().box;
+	for (int k = 0; k < 3; k++) {
+		h.bounds[k] = bounds.min()[k];
+		h.bounds[3 + k] = bounds.max()[k];
+	}
+	h.numTopNodes = topNodes.size();
+	h.numPages = pageRoots.size();
+	h.topOffset = align16(sizeof(h));
+	h.pageTableOffset = align16(h.topOffset + h.numTopNodes * sizeof(TreeNode));
+
+	vector<PageRecord> records(h.numPages);
+	uint64_t offset = align16(h.pageTableOffset + h.numPages * sizeof(PageRecord));
+	for (int p = 0; p < h.numPages; p++) {
+		const TreeNode& n = octree.nodes[pageRoots[p]];
+		records[p].offset = offset;
+		records[p].numNodes = subtreeNodes[pageRoots[p]];
+		records[p].numFaces = n.numPoints();
+		offset = align16(records[p].vertexOffset() + records[p].numFaces * 3 * sizeof(glm::vec3));
+	}
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out) return false;
+
+	auto writeAt = [&](uint64_t offset, const void* p, uint64_t bytes) {
+		static const char zeros[16] = { 0 };
+		uint64_t pos = out.tellp();
+		out.write(zeros, offset - pos);
+		out.write((const char*)p, bytes);
+	};
+	out.write((const char*)&h, sizeof(h));
+	writeAt(h.topOffset, topNodes.data(), h.numTopNodes * sizeof(TreeNode));
+	writeAt(h.pageTableOffset, records.data(), h.numPages * sizeof(PageRecord));
+
+	// each page with page local node, face and vertex numbers
+	//
+	vector<TreeNode> pageNodes;
+	vector<int> pageSrc, faces;
+	vector<glm::vec3> vertices;
+	for (int p = 0; p < h.numPages; p++) {
+		copySubtree(octree, pageRoots[p], nullptr, pageNodes, pageSrc);
+		int first = octree.nodes[pageRoots[p]].begin;
+		faces.assign(octree.indices.data() + first, octree.indices.data() + octree.nodes[pageRoots[p]].end);
+		vertices.resize(faces.size() * 3);
+		for (int i = 0; i < faces.size(); i++) octree.getFace(faces[i], &vertices[3 * i]);
+		for (TreeNode& n : pageNodes) {
+			n.begin -= first;
+			n.end -= first;
+		}
+		writeAt(records[p].offset, pageNodes.data(), pageNodes.size() * sizeof(TreeNode));
+		writeAt(records[p].faceOffset(), faces.data(), faces.size() * sizeof(int));
+		writeAt(records[p].vertexOffset(), vertices.data(), vertices.size() * sizeof(glm::vec3));
+	}
+	return (bool)out;
+}
+
+bool PagedOctree::open(const string& path, uint64_t sourceHash, size_t budgetBytes) {
+	close();
+	in.open(path, std::ios::binary);
+	if (!in) return false;
+
+	in.seekg(0, std::ios::end);
+	uint64_t size = in.tellg();
+	in.seekg(0);
+
+	// validate the header, that the top of the tree, the page table and
+	// every page fit in the file and that the top's leaves are pages, so a
+	// damaged file is rebuilt rather than crashing the queries.  The nodes
+	// of a page are checked when it is read.
+	//
+	auto fits = [size](uint64_t offset, uint64_t count, size_t bytes) {
+		return offset <= size && count <= (size - offset) / bytes;
+	};
+	PagedOctreeHeader h;
+	in.read((char*)&h, sizeof(h));
+	bool ok = in && memcmp(h.magic, pagesMagic, sizeof(pagesMagic)) == 0 &&
+		h.version == Version &&
+		h.nodeSize == sizeof(TreeNode) &&
+		h.sourceHash == sourceHash &&
+		fits(h.topOffset, h.numTopNodes, sizeof(TreeNode)) &&
+		fits(h.pageTableOffset, h.numPages, sizeof(PageRecord)) &&
+		h.numTopNodes > 0 && h.numTopNodes <= INT_MAX && h.numPages <= INT_MAX;
+	if (ok) {
+		top.resize(h.numTopNodes);
+		table.resize(h.numPages);
+		in.seekg(h.topOffset);
+		in.read((char*)top.data(), h.numTopNodes * sizeof(TreeNode));
+		in.seekg(h.pageTableOffset);
+		in.read((char*)table.data(), h.numPages * sizeof(PageRecord));
+		ok = in && Octree::validNodes(top.data(), top.size(), table.size(), false);
+	}
+	for (int i = 0; ok && i < top.size(); i++) {
+		ok = !top[i].isLeaf() || top[i].end == top[i].begin + 1;
+	}
+	for (int p = 0; ok && p < table.size(); p++) {
+		const PageRecord& r = table[p];
+		ok = r.numNodes > 0 && fits(r.offset, r.numNodes, sizeof(TreeNode)) &&
+			fits(r.faceOffset(), r.numFaces, sizeof(int)) &&
+			fits(r.vertexOffset(), r.numFaces, 3 * sizeof(glm::vec3));
+	}
+	if (!ok) {
+		close();
+		return false;
+	}
+
+	int n = table.size();
+	pages.resize(n);
+	lruPrev.assign(n, -1);
+	lruNext.assign(n, -1);
+	requested.assign(n, 0);
+	this->budgetBytes = budgetBytes;
+	this->path = path;
+	stats.reset();
+	bStop = false;
+	loader = std::thread(&PagedOctree::loaderLoop, this);
+	return true;
+}
+
+void PagedOctree::close() {
+	if (loader.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			bStop = true;
+		}
+		wake.notify_one();
+		loader.join();
+	}
+	if (in.is_open()) in.close();
+	in.clear();
+	top.clear();
+	table.clear();
+	pages.clear();
+	lruPrev.clear();
+	lruNext.clear();
+	lruHead = lruTail = -1;
+	numLoaded = 0;
+	cacheBytes = 0;
+	requests.clear();
+	loaded.clear();
+	requested.clear();
+}
+
+size_t PagedOctree::totalPageBytes() const {
+	size_t bytes = 0;
+	for (const PageRecord& r : table) bytes += r.bytes();
+	return bytes;
+}
+
+bool PagedOctree::readPage(std::ifstream& file, const PageRecord& record, TerrainPage& pageRtn) {
+	pageRtn.nodes.resize(record.numNodes);
+	pageRtn.faces.resize(record.numFaces);
+	pageRtn.vertices.resize(record.numFaces * 3);
+	file.clear();     // a failed read leaves the stream failed
+	file.seekg(record.offset);
+	file.read((char*)pageRtn.nodes.data(), record.numNodes * sizeof(TreeNode));
+	file.seekg(record.faceOffset());
+	file.read((char*)pageRtn.faces.data(), record.numFaces * sizeof(int));
+	file.seekg(record.vertexOffset());
+	file.read((char*)pageRtn.vertices.data(), record.numFaces * 3 * sizeof(glm::vec3));
+	return file && Octree::validNodes(pageRtn.nodes.data(), record.numNodes, record.numFaces);
+}
+
+void PagedOctree::unlinkLRU(int page) {
+	if (lruPrev[page] >= 0) lruNext[lruPrev[page]] = lruNext[page];
+	else lruHead = lruNext[page];
+	if (lruNext[page] >= 0) lruPrev[lruNext[page]] = lruPrev[page];
+	else lruTail = lruPrev[page];
+	lruPrev[page] = lruNext[page] = -1;
+}
+
+// move a page in memory to the front of the LRU list
+//
+void PagedOctree::touch(int page) {
+	if (lruHead == page) return;
+	unlinkLRU(page);
+	lruNext[page] = lruHead;
+	lruPrev[lruHead] = page;
+	lruHead = page;
+}
+
+//  Put a page in the cache, evicting the least recently used pages until it
+//  fits in the budget.  The cache always keeps the new page, even if it is
+//  larger than the budget by itself.
+//
+void PagedOctree::install(int page, std::unique_ptr<TerrainPage> data) {
+	size_t bytes = table[page].bytes();
+	while (lruTail >= 0 && cacheBytes + bytes > budgetBytes) {
+		int victim = lruTail;
+		unlinkLRU(victim);
+		pages[victim].reset();
+		cacheBytes -= table[victim].bytes();
+		numLoaded--;
+		stats.evictions++;
+	}
+	pages[page] = std::move(data);
+	cacheBytes += bytes;
+	numLoaded++;
+	lruPrev[page] = -1;
+	lruNext[page] = lruHead;
+	if (lruHead >= 0) lruPrev[lruHead] = page;
+	lruHead = page;
+	if (lruTail < 0) lruTail = page;
+}
+
+//  The page, read now if it is not in memory.  The pointer is good until
+//  the next page is read (which may evict it).
+//
+const TerrainPage* PagedOctree::getPage(int page) {
+	if (!pages[page]) {
+		std::unique_ptr<TerrainPage> data(new TerrainPage());
+		if (!readPage(in, table[page], *data)) return nullptr;
+		stats.faults++;
+		stats.bytesRead += table[page].bytes();
+		install(page, std::move(data));
+	}
+	else touch(page);
+	return pages[page].get();
+}
+
+void PagedOctree::loaderLoop() {
+	std::ifstream file(path, std::ios::binary);
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		wake.wait(lock, [this] { return bStop || !requests.empty(); });
+		if (bStop) break;
+		int page = requests.front();
+		requests.pop_front();
+		PageRecord record = table[page];
+
+		lock.unlock();
+		std::unique_ptr<TerrainPage> data(new TerrainPage());
+		bool ok = readPage(file, record, *data);
+		lock.lock();
+		if (ok) loaded.push_back(std::make_pair(page, std::move(data)));
+		else requested[page] = 0;
+	}
+}
+
+void PagedOctree::prefetch(const glm::vec3& position, const glm::vec3& velocity, float seconds, float radius) {
+	if (top.empty()) return;
+
+	// boxes along the path, one per radius travelled.  Ground queries look
+	// straight down, so the boxes reach down to the bottom of the terrain.
+	//
+	float bottom = top[0].box.min().y();
+	float distance = glm::length(velocity) * seconds;
+	int numSteps = std::min(64, 1 + (int)(distance / std::max(radius, 1e-3f)));
+	vector<int> found;
+	for (int s = 0; s < numSteps; s++) {
+		glm::vec3 p = position + velocity * (seconds * s / std::max(numSteps - 1, 1));
+		Box box(Vector3(p.x - radius, std::min(bottom, p.y - radius), p.z - radius), Vector3(p.x + radius, p.y + radius, p.z + radius));
+		int stack[MaxLevels * 8];
+		int sp = 0;
+		stack[sp++] = 0;
+		while (sp > 0) {
+			const TreeNode& n = top[stack[--sp]];
+			if (!n.box.overlap(box)) continue;
+			if (n.isLeaf()) {
+				if (std::find(found.begin(), found.end(), n.begin) == found.end()) found.push_back(n.begin);
+				continue;
+			}
+			int numChildren = n.numChildren();
+			for (int c = 0; c < numChildren; c++) stack[sp++] = n.firstChild + c;
+		}
+	}
+
+	// pages in memory are touched so they outlive the ones behind the
+	// rocket; the others are requested, nearest first, up to half the budget
+	//
+	size_t bytes = 0;
+	bool bWake = false;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (int page : found) {
+			bytes += table[page].bytes();
+			if (bytes > budgetBytes / 2) break;
+			if (pages[page]) continue;
+			if (requested[page]) continue;
+			requested[page] = 1;
+			requests.push_back(page);
+			bWake = true;
+		}
+	}
+	for (int i = found.size() - 1; i >= 0; i--) {
+		if (pages[found[i]]) touch(found[i]);
+	}
+	if (bWake) wake.notify_one();
+}
+
+void PagedOctree::update() {
+	vector<std::pair<int, std::unique_ptr<TerrainPage>>> done;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		done.swap(loaded);
+		for (auto& d : done) requested[d.first] = 0;
+	}
+	for (auto& d : done) {
+		if (pages[d.first]) continue;     // a query read it first
+		stats.prefetched++;
+		stats.bytesRead += table[d.first].bytes();
+		install(d.first, std::move(d.second));
+	}
+}
+
+//  Nearest face hit in a page, front to back like Octree::intersect.
+//
+bool PagedOctree::intersectPage(const TerrainPage& page, const Ray& ray, float tEnter,
+	float& tNearest, RayHit& hitRtn) const {
+	int stack[MaxLevels * 8];
+	float stackT[MaxLevels * 8];
+	int sp = 0;
+	stack[sp] = 0;
+	stackT[sp++] = tEnter;
+	bool found = false;
+
+	while (sp > 0) {
+		sp--;
+		if (stackT[sp] > tNearest) continue;
+		const TreeNode& n = page.nodes[stack[sp]];
+		if (n.isLeaf()) {
+			for (int i = n.begin; i < n.end; i++) {
+				float t;
+				if (SpatialIndex::rayIntersectTriangle(ray, &page.vertices[3 * i], t) && t < tNearest) {
+					tNearest = t;
+					hitRtn.t = t;
+					hitRtn.index = page.faces[i];
+					found = true;
+				}
+			}
+			continue;
+		}
+
+		int child[8];
+		float childT[8];
+		int numHit = 0;
+		int numChildren = n.numChildren();
+		for (int c = 0; c < numChildren; c++) {
+			float t;
+			if (!page.nodes[n.firstChild + c].box.intersect(ray, 0, tNearest, t)) continue;
+			int j = numHit++;
+			for (; j > 0 && childT[j - 1] > t; j--) {
+				child[j] = child[j - 1];
+				childT[j] = childT[j - 1];
+			}
+			child[j] = n.firstChild + c;
+			childT[j] = t;
+		}
+		for (int i = numHit - 1; i >= 0; i--) {
+			stack[sp] = child[i];
+			stackT[sp++] = childT[i];
+		}
+	}
+	return found;
+}
+
+bool PagedOctree::intersect(const Ray& ray, RayHit& hitRtn) {
+	if (top.empty()) return false;
+
+	float tEnter;
+	if (!top[0].box.intersect(ray, 0, INFINITE, tEnter)) return false;
+	int stack[MaxLevels * 8];
+	float stackT[MaxLevels * 8];
+	int sp = 0;
+	stack[sp] = 0;
+	stackT[sp++] = tEnter;
+	float tNearest = INFINITE;
+	bool found = false;
+
+	while (sp > 0) {
+		sp--;
+		if (stackT[sp] > tNearest) continue;
+		const TreeNode& n = top[stack[sp]];
+		if (n.isLeaf()) {
+			const TerrainPage* page = getPage(n.begin);
+			if (page && intersectPage(*page, ray, stackT[sp], tNearest, hitRtn)) {
+				hitRtn.leaf = n.begin;
+				found = true;
+			}
+			continue;
+		}
+
+		int child[8];
+		float childT[8];
+		int numHit = 0;
+		int numChildren = n.numChildren();
+		for (int c = 0; c < numChildren; c++) {
+			float t;
+			if (!top[n.firstChild + c].box.intersect(ray, 0, tNearest, t)) continue;
+			int j = numHit++;
+			for (; j > 0 && childT[j - 1] > t; j--) {
+				child[j] = child[j - 1];
+				childT[j] = childT[j - 1];
+			}
+			child[j] = n.firstChild + c;
+			childT[j] = t;
+		}
+		for (int i = numHit - 1; i >= 0; i--) {
+			stack[sp] = child[i];
+			stackT[sp++] = childT[i];
+		}
+	}
+
+	if (found) {
+		Vector3 p = ray.origin + ray.direction * hitRtn.t;
+		hitRtn.point = glm::vec3(p.x(), p.y(), p.z());
+	}
+	return found;
+}
+
+//  Leaves of a page that overlap the box.  With boxListRtn null, stops at
+//  the first one (any-hit, like Octree::overlap).
+//
+bool PagedOctree::overlapPage(const TerrainPage& page, const Box& box, vector<Box>* boxListRtn) const {
+	int stack[MaxLevels * 8];
+	int sp = 0;
+	stack[sp++] = 0;
+	bool found = false;
+	while (sp > 0) {
+		const TreeNode& n = page.nodes[stack[--sp]];
+		if (!n.box.overlap(box)) continue;
+		if (n.isLeaf()) {
+			found = true;
+			if (!boxListRtn) break;
+			boxListRtn->push_back(n.box);
+			continue;
+		}
+		int numChildren = n.numChildren();
+		for (int c = 0; c < numChildren; c++) stack[sp++] = n.firstChild + c;
+	}
+	return found;
+}
+
+bool PagedOctree::overlap(const Box& box) {
+	if (top.empty()) return false;
+
+	int stack[MaxLevels * 8];
+	int sp = 0;
+	stack[sp++] = 0;
+	while (sp > 0) {
+		const TreeNode& n = top[stack[--sp]];
+		if (!n.box.overlap(box)) continue;
+		if (n.isLeaf()) {
+			const TerrainPage* page = getPage(n.begin);
+			if (page && overlapPage(*page, box, nullptr)) return true;
+			continue;
+		}
+		int numChildren = n.numChildren();
+		for (int c = 0; c < numChildren; c++) stack[sp++] = n.firstChild + c;
+	}
+	return false;
+}
+
+bool PagedOctree::intersect(const Box& box, vector<Box>& boxListRtn) {
+	if (top.empty()) return false;
+
+	int stack[MaxLevels * 8];
+	int sp = 0;
+	stack[sp++] = 0;
+	bool found = false;
+	while (sp > 0) {
+		const TreeNode& n = top[stack[--sp]];
+		if (!n.box.overlap(box)) continue;
+		if (n.isLeaf()) {
+			const TerrainPage* page = getPage(n.begin);
+			if (page && overlapPage(*page, box, &boxListRtn)) found = true;
+			continue;
+		}
+		int numChildren = n.numChildren();
+		for (int c = 0; c < numChildren; c++) stack[sp++] = n.firstChild + c;
+	}
+	return found;
+}
@@ -0,0 +1,164 @@
+#pragma once
+//  Pierce Kyaw, Aye Thwe Tun
+//
+//  Out-of-core octree, for terrains larger than memory.  The octree (face
+//  mode) is cut into pages:  each page is a subtree small enough to fit in
+//  maxPageBytes, stored in the file with its nodes and its own copy of its
+//  triangles, so no page needs the mesh.  Only the nodes above the pages
+//  (the top of the tree) are kept in memory.
+//
+//  Pages are read on first access and kept in a cache with a memory budget;
+//  when a new page does not fit, the least recently used pages are evicted.
+//  prefetch() asks a loader thread to read the pages along the rocket's
+//  path ahead of time, so queries near the rocket find them in memory
+//  instead of waiting for the disk (a page fault).
+//
+//  File layout (all sections 16 byte aligned):
+//
+//     PagedOctreeHeader
+//     TreeNode     top[numTopNodes]      leaves of the top are pages:
+//                                        begin is the page number
+//     PageRecord   pages[numPages]
+//     per page:    TreeNode   nodes[numNodes]    (firstChild, begin, end
+//                  int        faces[numFaces]     are page local)
+//                  glm::vec3  vertices[3 * numFaces]
+//
+//  The pages file is written from a built Octree (see save()), normally
+//  offline on a machine that can hold the whole terrain.
+//
+
+#include "ofMain.h"
+#include "Octree.h"
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+class PagedOctreeHeader {
+public:
+	char magic[8];              // "PAGETREE"
+	uint32_t version;
+	uint32_t nodeSize;          // sizeof(TreeNode) of the writer
+	uint64_t sourceHash;        // hash of the source mesh file
+	float bounds[6];            // min xyz, max xyz of the root
+	uint64_t numTopNodes, numPages;
+	uint64_t topOffset, pageTableOffset;
+};
+
+class PageRecord {
+public:
+	uint64_t offset;            // of the page's nodes
+	uint32_t numNodes;
+	uint32_t numFaces;
+
+	uint64_t faceOffset() const;
+	uint64_t vertexOffset() const;
+	size_t bytes() const;       // in memory
+};
+
+//  A page in memory.  "faces" are face indices of the source mesh, and
+//  vertices[3 * i] to vertices[3 * i + 2] the triangle of faces[i].
+//
+class TerrainPage {
+public:
+	vector<TreeNode> nodes;     // nodes[0] is the page's root
+	vector<int> faces;
+	vector<glm::vec3> vertices;
+};
+
+//  Counters since open() or the last reset.
+//
+class PagedOctreeStats {
+public:
+	uint64_t faults = 0;        // pages a query had to wait for
+	uint64_t prefetched = 0;    // pages read by the loader thread
+	uint64_t evictions = 0;
+	uint64_t bytesRead = 0;
+
+	void reset() { *this = PagedOctreeStats(); }
+};
+
+class PagedOctree {
+public:
+	static const uint32_t Version = 1;
+	static const int MaxLevels = Octree::MaxLevels;
+
+	PagedOctree() { }
+	~PagedOctree() { close(); }
+	PagedOctree(const PagedOctree&) = delete;
+	PagedOctree& operator=(const PagedOctree&) = delete;
+
+	// write the octree (face mode) as a pages file.  Pages are the largest
+	// subtrees that fit in maxPageBytes (a leaf is always one page).
+	//
+	static bool save(const string& path, uint64_t sourceHash, const Octree& octree,
+		size_t maxPageBytes = 256 * 1024);
+
+	// open a pages file and read the top of the tree.  At most budgetBytes
+	// of pages are kept in memory (at least one page).  Fails if the file
+	// is missing, was written by a different version, does not match
+	// sourceHash, or is damaged (a page or table outside the file, a node
+	// outside the arrays).  A damaged page is not used.
+	//
+	bool open(const string& path, uint64_t sourceHash, size_t budgetBytes);
+	void close();
+	bool isOpen() const { return in.is_open(); }
+
+	// same queries and results as the Octree's; hitRtn.leaf is the page of
+	// the hit.  Pages the queries reach are read if they are not in memory.
+	//
+	bool intersect(const Ray& ray, RayHit& hitRtn);
+	bool overlap(const Box& box);
+	bool intersect(const Box& box, vector<Box>& boxListRtn);
+
+	// ask the loader thread for the pages within "radius" of the path from
+	// position over the next "seconds" at "velocity", and below it, nearest
+	// first (no more than half the budget).  update() puts the pages it has
+	// read in the cache; call it once per frame.
+	//
+	void prefetch(const glm::vec3& position, const glm::vec3& velocity, float seconds, float radius);
+	void update();
+
+	Box bounds() const { return top.empty() ? Box() : top[0].box; }
+	int numPages() const { return table.size(); }
+	int numResident() const { return numLoaded; }
+	size_t residentBytes() const { return cacheBytes; }
+	size_t totalPageBytes() const;
+
+	const TerrainPage* getPage(int page);
+	void install(int page, std::unique_ptr<TerrainPage> data);
+	void touch(int page);
+	void unlinkLRU(int page);
+	static bool readPage(std::ifstream& file, const PageRecord& record, TerrainPage& pageRtn);
+	bool intersectPage(const TerrainPage& page, const Ray& ray, float tEnter, float& tNearest, RayHit& hitRtn) const;
+	bool overlapPage(const TerrainPage& page, const Box& box, vector<Box>* boxListRtn) const;
+	void loaderLoop();
+
+	vector<TreeNode> top;       // top[0] is the root
+	vector<PageRecord> table;
+	vector<std::unique_ptr<TerrainPage>> pages;     // nullptr if not in memory
+	PagedOctreeStats stats;
+
+	// LRU list of the pages in memory, most recently used first
+	//
+	vector<int> lruPrev, lruNext;
+	int lruHead = -1, lruTail = -1;
+	int numLoaded = 0;
+	size_t cacheBytes = 0;
+	size_t budgetBytes = 0;
+
+	// the loader thread reads "requests" with its own file and hands the
+	// pages to update() in "loaded"
+	//
+	std::ifstream in;
+	string path;
+	std::thread loader;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<int> requests;
+	vector<std::pair<int, std::unique_ptr<TerrainPage>>> loaded;
+	vector<char> requested;     // in requests or being read
+	bool bStop = false;
+};
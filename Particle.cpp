@@ -11,6 +11,7 @@ Particle::Particle() {
 	forces.set(0, 0, 0);
 	lifespan = 5;
 	birthtime = 0;
+	lived = 0;
 	radius = .1;
 	damping = .99;
 	mass = 1;
@@ -23,39 +24,38 @@ void Particle::draw() {
 	ofDrawSphere(position, radius);
 }
 
-// write your own integrator here.. (hint: it's only 3 lines of code)
+// dt is the interval for this step (the simulation's fixed step, not the
+// frame time).  The forces are held for the step; explicit Euler damps the
+// velocity per step, the other integrators turn damping into drag (see
+// Integrator.h).
 //
-void Particle::integrate() {
-
-
-	// interval for this step
-	//
-	float dt = 1.0 / ofGetFrameRate();
-
-	// update position based on velocity
-	//
-	position += (velocity * dt);
+void Particle::integrate(float dt, IntegratorType integrator) {
 
 	// update acceleration with accumulated paritcles forces
 	// remember :  (f = ma) OR (a = 1/m * f)
 	//
 	ofVec3f accel = acceleration;    // start with any acceleration already on the particle
 	accel += (forces * (1.0 / mass));
-	velocity += accel * dt;
+
+	float drag = integrator == ExplicitEulerIntegrator ? 0 : Integrator::drag(damping);
+	Integrator::step(integrator, position, velocity, dt,
+		[&](const ofVec3f&, const ofVec3f& v) { return accel - v * drag; });
 
 	// add a little damping for good measure
 	//
-	velocity *= damping;
+	if (integrator == ExplicitEulerIntegrator) velocity *= damping;
 
 	// clear forces on particle (they get re-added each step)
 	//
 	forces.set(0, 0, 0);
+
+	lived += dt;
 }
 
 //  return age in seconds
 //
 float Particle::age() {
-	return (ofGetElapsedTimeMillis() - birthtime) / 1000.0;
+	return lived;
 }
 
 
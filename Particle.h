@@ -1,6 +1,7 @@
 #pragma once
 
 #include "ofMain.h"
+#include "Integrator.h"
 
 class ParticleForceField;
 
@@ -16,10 +17,11 @@ public:
 	float   mass;
 	float   lifespan;
 	float   radius;
-	float   birthtime;
-	void    integrate();
+	float   birthtime;    // ms, on the emitter's clock
+	float   lived;        // sec integrated since birth
+	void    integrate(float dt, IntegratorType integrator = ExplicitEulerIntegrator);   // dt in sec
 	void    draw();
-	float   age();        // sec
+	float   age();        // sec, of simulated time
 	ofColor color;
 };
 
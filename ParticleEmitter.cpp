@@ -38,6 +38,7 @@ void ParticleEmitter::init() {
 	oneShot = false;
 	fired = false;
 	lastSpawned = 0;
+	time = 0;
 	radius = 1;
 	particleRadius = .1;
 	visible = true;
@@ -66,16 +67,16 @@ void ParticleEmitter::draw() {
 }
 void ParticleEmitter::start() {
 	started = true;
-	lastSpawned = ofGetElapsedTimeMillis();
+	lastSpawned = time;
 }
 
 void ParticleEmitter::stop() {
 	started = false;
 	fired = false;
 }
-void ParticleEmitter::update() {
+void ParticleEmitter::update(float dt) {
 
-	float time = ofGetElapsedTimeMillis();
+	time += dt * 1000;
 
 	if (oneShot && started) {
 		if (!fired) {
@@ -101,7 +102,7 @@ void ParticleEmitter::update() {
 		lastSpawned = time;
 	}
 
-	sys->update();
+	sys->update(dt);
 }
 
 // spawn a single particle.  time is current time of birth
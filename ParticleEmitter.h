@@ -29,7 +29,7 @@ public:
 	void setLifespanRange(const ofVec2f& r) { lifeMinMax = r; }
 	void setMass(float m) { mass = m; }
 	void setDamping(float d) { damping = d; }
-	void update();
+	void update(float dt);
 	void spawn(float time);
 	ParticleSystem* sys;
 	float rate;         // per sec
@@ -43,6 +43,7 @@ public:
 	float damping;
 	bool started;
 	float lastSpawned;  // ms
+	float time;         // ms of simulated time, advanced by update()
 	float particleRadius;
 	float radius;
 	bool visible;
@@ -20,13 +20,14 @@ public:
 	void add(const Particle&);
 	void addForce(ParticleForce*);
 	void remove(int);
-	void update();
+	void update(float dt);
 	void setLifespan(float);
 	void reset();
 	int removeNear(const ofVec3f& point, float dist);
 	void draw();
 	vector<Particle> particles;
 	vector<ParticleForce*> forces;
+	IntegratorType integrator = ExplicitEulerIntegrator;   // see Integrator.h
 };
 
 
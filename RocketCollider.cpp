@@ -0,0 +1,142 @@
+//  Pierce Kyaw, Aye Thwe Tun
+//
+//  Narrow phase of the rocket against the terrain.  See RocketCollider.h.
+//
+
+#include "RocketCollider.h"
+#include <cfloat>
+
+// p turned about y by the angle whose cosine and sine are c and s (the
+// same turn as ofNode::setRotation about y; -s turns back)
+//
+static glm::vec3 turnY(const glm::vec3& p, float c, float s) {
+	return glm::vec3(c * p.x + s * p.z, p.y, -s * p.x + c * p.z);
+}
+
+void RocketCollider::create(const vector<ofMesh>& meshes) {
+	// one triangle mesh of all the model's meshes
+	ofMesh mesh;
+	mesh.setMode(OF_PRIMITIVE_TRIANGLES);
+	for (int m = 0; m < meshes.size(); m++) {
+		int first = mesh.getNumVertices();
+		for (int i = 0; i < meshes[m].getNumVertices(); i++) mesh.addVertex(meshes[m].getVertex(i));
+		if (meshes[m].getNumIndices() > 0) {
+			for (int i = 0; i < meshes[m].getNumIndices(); i++) mesh.addIndex(first + meshes[m].getIndex(i));
+		}
+		else {
+			// 3 vertices per triangle
+			for (int i = 0; i < meshes[m].getNumVertices(); i++) mesh.addIndex(first + i);
+		}
+	}
+
+	// small leaves:  each leaf's faces are tested against every terrain
+	// face reaching it
+	bvh.settings.maxFacesPerLeaf = 4;
+	bvh.create(mesh);
+
+	frontier.clear();
+	if (bvh.nodes.empty()) return;
+	vector<int> level(1, 0), next;
+	for (int depth = 0; !level.empty(); depth++) {
+		next.clear();
+		for (int i = 0; i < level.size(); i++) {
+			const BVHNode& n = bvh.nodes[level[i]];
+			if (n.isLeaf() || depth == BoundsDepth) frontier.push_back(n.box);
+			else {
+				next.push_back(n.firstChild);
+				next.push_back(n.firstChild + 1);
+			}
+		}
+		level.swap(next);
+	}
+}
+
+Box RocketCollider::bounds(const glm::vec3& position, float rotation) const {
+	float c = cos(ofDegToRad(rotation)), s = sin(ofDegToRad(rotation));
+	glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+	for (int i = 0; i < frontier.size(); i++) {
+		Vector3 lo = frontier[i].min(), hi = frontier[i].max();
+		for (int k = 0; k < 4; k++) {
+			// the turn is about y, so only the 4 x / z corners move
+			glm::vec3 p = turnY(glm::vec3(k & 1 ? hi.x() : lo.x(), 0, k & 2 ? hi.z() : lo.z()), c, s);
+			min = glm::min(min, glm::vec3(p.x, lo.y(), p.z));
+			max = glm::max(max, glm::vec3(p.x, hi.y(), p.z));
+		}
+	}
+	if (frontier.empty()) min = max = glm::vec3(0, 0, 0);
+	min += position;
+	max += position;
+	return Box(Vector3(min.x, min.y, min.z), Vector3(max.x, max.y, max.z));
+}
+
+//  Each terrain face under the rocket's box is turned into the model's
+//  frame, so the BVH's boxes are used as they are, and pushed down the
+//  nodes its bounds overlap.
+//
+int RocketCollider::collide(const SpatialIndex& terrain, const glm::vec3& position, float rotation,
+	vector<RocketContact>& contactsRtn) const {
+	contactsRtn.clear();
+	if (empty()) return 0;
+
+	vector<int> faces;
+	terrain.getIndicesInBox(bounds(position, rotation), faces);
+	if (faces.empty()) return 0;
+
+	float c = cos(ofDegToRad(rotation)), s = sin(ofDegToRad(rotation));
+	vector<glm::vec3> points;
+	int stack[BVH::MaxDepth * 2];
+	for (int f = 0; f < faces.size(); f++) {
+		glm::vec3 t[3];
+		terrain.getFace(faces[f], t);
+		for (int k = 0; k < 3; k++) t[k] = turnY(t[k] - position, c, -s);
+		glm::vec3 lo = glm::min(t[0], glm::min(t[1], t[2]));
+		glm::vec3 hi = glm::max(t[0], glm::max(t[1], t[2]));
+		Box faceBox(Vector3(lo.x, lo.y, lo.z), Vector3(hi.x, hi.y, hi.z));
+
+		int top = 0;
+		stack[top++] = 0;
+		while (top > 0) {
+			const BVHNode& n = bvh.nodes[stack[--top]];
+			if (!n.box.overlap(faceBox)) continue;
+			if (!n.isLeaf()) {
+				stack[top++] = n.firstChild;
+				stack[top++] = n.firstChild + 1;
+				continue;
+			}
+			for (int i = n.begin; i < n.end; i++) {
+				glm::vec3 r[3];
+				bvh.getFace(bvh.indices[i], r);
+				points.clear();
+				if (!intersectTriangles(r, t, points)) continue;
+				for (int k = 0; k < points.size(); k++) {
+					RocketContact contact;
+					contact.point = turnY(points[k], c, s) + position;
+					contact.terrainFace = faces[f];
+					contact.rocketFace = bvh.indices[i];
+					contactsRtn.push_back(contact);
+				}
+			}
+		}
+	}
+	return contactsRtn.size();
+}
+
+// The 6 edges as segments against the other triangle (Moller-Trumbore, see
+// SpatialIndex::rayIntersectTriangle, with the hit within the edge)
+//
+bool RocketCollider::intersectTriangles(const glm::vec3 a[3], const glm::vec3 b[3], vector<glm::vec3>& pointsRtn) {
+	int found = 0;
+	for (int side = 0; side < 2; side++) {
+		const glm::vec3* edges = side == 0 ? a : b;
+		const glm::vec3* triangle = side == 0 ? b : a;
+		for (int k = 0; k < 3; k++) {
+			glm::vec3 p = edges[k], d = edges[(k + 1) % 3] - p;
+			float t;
+			if (SpatialIndex::rayIntersectTriangle(Ray(Vector3(p.x, p.y, p.z), Vector3(d.x, d.y, d.z)), triangle, t) && t <= 1) {
+				pointsRtn.push_back(p + d * t);
+				found++;
+			}
+		}
+	}
+	return found > 0;
+}
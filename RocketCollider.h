@@ -0,0 +1,67 @@
+#pragma once
+//  Pierce Kyaw, Aye Thwe Tun
+//
+//  Mesh accurate collisions of the rocket with the terrain.  The rocket's
+//  triangles are put in a BVH once, in the model's own frame; the rocket is
+//  placed by a position and a turn about y (LanderSim::rotation), and the
+//  BVH is never rebuilt.
+//
+//  The broad phase is the terrain index's box query against bounds(), a box
+//  around the turned model that stays tight as it turns.  Only when that
+//  reports an overlap does collide() take the terrain faces under the box,
+//  bring each into the model's frame, and test it against the rocket faces
+//  in the BVH leaves its bounds reach.  Two triangles touch where an edge of
+//  one crosses the other, which gives the contact points.  Triangles lying
+//  in the same plane are not reported.
+//
+
+#include "BVH.h"
+
+//  Where a rocket face crosses a terrain face, in world space.
+//
+class RocketContact {
+public:
+	glm::vec3 point;
+	int terrainFace;
+	int rocketFace;
+};
+
+class RocketCollider {
+public:
+
+	// nodes down to this depth are turned for bounds()
+	//
+	static const int BoundsDepth = 3;
+
+	RocketCollider() { }
+	RocketCollider(const RocketCollider&) = delete;
+	RocketCollider& operator=(const RocketCollider&) = delete;
+
+	// build the hierarchy over the triangles of the model's meshes
+	//
+	void create(const vector<ofMesh>& meshes);
+	void create(const ofMesh& mesh) { create(vector<ofMesh>(1, mesh)); }
+	bool empty() const { return bvh.nodes.empty() || bvh.getNumFaces() == 0; }
+
+	// box around the model placed at "position", turned "rotation" degrees
+	// about y:  the turned corners of the boxes of the nodes down to
+	// BoundsDepth
+	//
+	Box bounds(const glm::vec3& position, float rotation) const;
+
+	// exact contacts of the placed model with the terrain's faces.  Call
+	// after the broad phase (terrain.overlap(bounds())) reports an overlap.
+	// Returns the number of contacts.
+	//
+	int collide(const SpatialIndex& terrain, const glm::vec3& position, float rotation,
+		vector<RocketContact>& contactsRtn) const;
+
+	// true if the triangles a and b cross; adds the points where the edges
+	// of each cross the other to pointsRtn
+	//
+	static bool intersectTriangles(const glm::vec3 a[3], const glm::vec3 b[3], vector<glm::vec3>& pointsRtn);
+
+	BVH bvh;                        // the model's faces, in the model's frame
+	vector<Box> frontier;           // boxes of the nodes down to BoundsDepth
+	                                // that cover all the faces
+};
@@ -0,0 +1,265 @@
+//  Pierce Kyaw, Aye Thwe Tun
+//
+//  Parts of the spatial index interface shared by every index.  See
+//  SpatialIndex.h.
+//
+
+#include "SpatialIndex.h"
+
+const char* IndexStats::leafSizeName(int bucket) {
+	const char* names[NumLeafSizes] = { "1", "2", "3-4", "5-8", "9-16", "17-32", "33+" };
+	return names[bucket];
+}
+
+// meanLeafDepth and meanLeafSize hold the sums until finish()
+//
+void IndexStats::addNode(int depth, bool leaf, int size) {
+	numNodes++;
+	if (depth >= nodesAtDepth.size()) {
+		nodesAtDepth.resize(depth + 1, 0);
+		leavesAtDepth.resize(depth + 1, 0);
+	}
+	nodesAtDepth[depth]++;
+	if (!leaf) return;
+
+	leavesAtDepth[depth]++;
+	numLeaves++;
+	meanLeafDepth += depth;
+	meanLeafSize += size;
+	int bucket = 0;
+	for (int n = 1; bucket < NumLeafSizes - 1 && size > n; n *= 2) bucket++;
+	leafSizes[bucket]++;
+}
+
+void IndexStats::finish() {
+	if (numLeaves == 0) return;
+	meanLeafDepth /= numLeaves;
+	meanLeafSize /= numLeaves;
+}
+
+int SpatialIndex::intersect(ArrayView<Ray> rays, vector<RayHit>& hitsRtn) const {
+	hitsRtn.resize(rays.size());
+	int numHits = 0;
+	for (int i = 0; i < rays.size(); i++) {
+		if (intersect(rays[i], hitsRtn[i])) numHits++;
+		else {
+			hitsRtn[i].t = INFINITE;
+			hitsRtn[i].leaf = -1;
+			hitsRtn[i].index = -1;
+		}
+	}
+	return numHits;
+}
+
+//draw a box from a "Box" class
+//
+void SpatialIndex::drawBox(const Box& box) {
+	Vector3 min = box.parameters[0];
+	Vector3 max = box.parameters[1];
+	Vector3 size = max - min;
+	Vector3 center = size / 2 + min;
+	ofVec3f p = ofVec3f(center.x(), center.y(), center.z());
+	float w = size.x();
+	float h = size.y();
+	float d = size.z();
+	ofDrawBox(p, w, h, d);
+}
+
+void SpatialIndex::draw(int numLevels, int level) {
+	if (numLevels != nodeLinesLevels || level != nodeLinesLevel) {
+		nodeLines.clear();
+		getNodeLines(numLevels, level, nodeLines);
+		nodeLinesLevels = numLevels;
+		nodeLinesLevel = level;
+	}
+	nodeLines.draw();
+}
+
+void SpatialIndex::drawLeafNodes() {
+	if (!bLeafLinesValid) {
+		leafLines.clear();
+		getLeafLines(leafLines);
+		bLeafLinesValid = true;
+	}
+	leafLines.draw();
+}
+
+void SpatialIndex::invalidateLines() {
+	nodeLinesLevels = nodeLinesLevel = -1;
+	bLeafLinesValid = false;
+}
+
+// add the 12 edges of a box to a line list
+//
+void SpatialIndex::addBoxLines(const Box& box, const ofFloatColor& color, ofMesh& linesRtn) {
+	Vector3 min = box.min(), max = box.max();
+	glm::vec3 corner[8];
+	for (int i = 0; i < 8; i++) {
+		corner[i] = glm::vec3(i & 1 ? max.x() : min.x(), i & 2 ? max.y() : min.y(), i & 4 ? max.z() : min.z());
+	}
+
+	// corners i and j are joined if they differ in one bit (one axis)
+	//
+	linesRtn.setMode(OF_PRIMITIVE_LINES);
+	for (int i = 0; i < 8; i++) {
+		for (int axis = 1; axis < 8; axis <<= 1) {
+			if (i & axis) continue;
+			linesRtn.addVertex(corner[i]);
+			linesRtn.addVertex(corner[i | axis]);
+			linesRtn.addColor(color);
+			linesRtn.addColor(color);
+		}
+	}
+}
+
+// return the 3 vertices of a face.  Meshes without indices store each
+// triangle as 3 consecutive vertices.
+//
+void SpatialIndex::getFace(int face, glm::vec3 v[3]) const {
+	for (int k = 0; k < 3; k++) {
+		int i = 3 * face + k;
+		v[k] = vertices[meshIndices.empty() ? i : meshIndices[i]];
+	}
+}
+
+int SpatialIndex::getNumFaces() const {
+	return (meshIndices.empty() ? vertices.size() : meshIndices.size()) / 3;
+}
+
+// Moller-Trumbore ray/triangle intersection.  Return ray parameter of the
+// hit in t.
+//
+bool SpatialIndex::rayIntersectTriangle(const Ray& ray, const glm::vec3 v[3], float& t) {
+	const float eps = 1e-7f;
+	glm::vec3 o(ray.origin.x(), ray.origin.y(), ray.origin.z());
+	glm::vec3 d(ray.direction.x(), ray.direction.y(), ray.direction.z());
+	glm::vec3 e1 = v[1] - v[0];
+	glm::vec3 e2 = v[2] - v[0];
+	glm::vec3 p = glm::cross(d, e2);
+	float det = glm::dot(e1, p);
+	if (fabs(det) < eps) return false;     // ray parallel to triangle
+	float invDet = 1.0f / det;
+	glm::vec3 s = o - v[0];
+	float u = glm::dot(s, p) * invDet;
+	if (u < 0 || u > 1) return false;
+	glm::vec3 q = glm::cross(s, e1);
+	float w = glm::dot(d, q) * invDet;
+	if (w < 0 || u + w > 1) return false;
+	t = glm::dot(e2, q) * invDet;
+	return t >= 0;
+}
+
+// Moving box against a triangle by separating axes:  the box and the
+// triangle are apart while any of the 13 axes (the box's 3, the triangle's
+// normal, and the 9 crosses of their edges) separates their projections.
+// On each axis the projections overlap during one interval of the motion;
+// the box touches the triangle when the last of those intervals starts,
+// unless one of them has already ended.  The axis that starts last gives
+// the normal.
+//
+// A box already overlapping the triangle (t = 0) takes the normal of the
+// axis of least penetration, and only hits if it moves into it.
+//
+bool SpatialIndex::sweepBoxTriangle(const glm::vec3& center, const glm::vec3& halfSize,
+	const glm::vec3& motion, const glm::vec3 v[3], float tMax, float& t, glm::vec3& normalRtn) {
+	glm::vec3 edges[3] = { v[1] - v[0], v[2] - v[1], v[0] - v[2] };
+	glm::vec3 axes[13] = { glm::vec3(1, 0, 0), glm::vec3(0, 1, 0), glm::vec3(0, 0, 1),
+		glm::cross(edges[0], edges[1]) };
+	int numAxes = 4;
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			axes[numAxes++] = glm::cross(axes[i], edges[j]);
+		}
+	}
+
+	float tFirst = 0, tLast = tMax;
+	glm::vec3 firstNormal(0, 0, 0);
+	float leastDepth = FLT_MAX;
+	glm::vec3 leastNormal(0, 0, 0);
+	for (int i = 0; i < numAxes; i++) {
+		float length = glm::length(axes[i]);
+		if (length < 1e-6f) continue;         // edge parallel to a box axis
+		glm::vec3 a = axes[i] / length;
+
+		float r = halfSize.x * fabs(a.x) + halfSize.y * fabs(a.y) + halfSize.z * fabs(a.z);
+		float c = glm::dot(center, a);
+		float boxMin = c - r, boxMax = c + r;
+		float p0 = glm::dot(v[0], a), p1 = glm::dot(v[1], a), p2 = glm::dot(v[2], a);
+		float triMin = std::min(p0, std::min(p1, p2));
+		float triMax = std::max(p0, std::max(p1, p2));
+		float speed = glm::dot(motion, a);
+
+		if (boxMax < triMin) {
+			// box below the triangle on this axis
+			if (speed <= 0) return false;
+			float tEnter = (triMin - boxMax) / speed;
+			if (tEnter > tFirst) {
+				tFirst = tEnter;
+				firstNormal = -a;
+			}
+			tLast = std::min(tLast, (triMax - boxMin) / speed);
+		}
+		else if (boxMin > triMax) {
+			// above
+			if (speed >= 0) return false;
+			float tEnter = (triMax - boxMin) / speed;
+			if (tEnter > tFirst) {
+				tFirst = tEnter;
+				firstNormal = a;
+			}
+			tLast = std::min(tLast, (triMin - boxMax) / speed);
+		}
+		else {
+			// overlapping now:  until the box moves off either end
+			if (speed > 0) tLast = std::min(tLast, (triMax - boxMin) / speed);
+			else if (speed < 0) tLast = std::min(tLast, (triMin - boxMax) / speed);
+			float below = boxMax - triMin, above = triMax - boxMin;
+			if (std::min(below, above) < leastDepth) {
+				leastDepth = std::min(below, above);
+				leastNormal = below < above ? -a : a;
+			}
+		}
+		if (tFirst > tLast) return false;
+	}
+
+	if (firstNormal == glm::vec3(0, 0, 0)) {
+		// overlapping on every axis from the start
+		if (glm::dot(motion, leastNormal) >= 0) return false;
+		firstNormal = leastNormal;
+	}
+	t = tFirst;
+	normalRtn = firstNormal;
+	return true;
+}
+
+bool SpatialIndex::sweep(const Box& box, const glm::vec3& motion, SweepHit& hitRtn) const {
+	Vector3 d(motion.x, motion.y, motion.z);
+	Vector3 min = box.min(), max = box.max();
+	Box swept(Vector3(std::min(min.x(), min.x() + d.x()), std::min(min.y(), min.y() + d.y()),
+		std::min(min.z(), min.z() + d.z())),
+		Vector3(std::max(max.x(), max.x() + d.x()), std::max(max.y(), max.y() + d.y()),
+		std::max(max.z(), max.z() + d.z())));
+
+	vector<int> faces;
+	getIndicesInBox(swept, faces);
+
+	Vector3 c = box.center();
+	glm::vec3 center(c.x(), c.y(), c.z());
+	glm::vec3 halfSize(max.x() - c.x(), max.y() - c.y(), max.z() - c.z());
+	float tNearest = 1;
+	bool found = false;
+	for (int i = 0; i < faces.size(); i++) {
+		glm::vec3 v[3], normal;
+		float t;
+		getFace(faces[i], v);
+		if (sweepBoxTriangle(center, halfSize, motion, v, tNearest, t, normal)) {
+			tNearest = t;
+			hitRtn.t = t;
+			hitRtn.normal = normal;
+			hitRtn.leaf = -1;
+			hitRtn.index = faces[i];
+			found = true;
+		}
+	}
+	return found;
+}
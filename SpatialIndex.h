@@ -0,0 +1,222 @@
+#pragma once
+//  Pierce Kyaw, Aye Thwe Tun
+//
+//  Common interface of the terrain's spatial indexes.  The game only builds
+//  and queries the terrain through SpatialIndex, so the index can be picked
+//  at startup:
+//
+//    OctreeIndex          Octree, 8 equal octants per node (Octree.h)
+//    BVHIndex             bounding volume hierarchy built with the surface
+//                         area heuristic (BVH.h)
+//    CompactOctreeIndex   the octree with 16 byte nodes whose boxes are
+//                         quantized inside their parent's (CompactOctree.h)
+//
+//  All three index the triangles of the mesh (the octree can also index its
+//  vertices, see Octree::bUseFaces).
+//
+
+#include "ofMain.h"
+#include "box.h"
+#include "ray.h"
+#include "ArrayView.h"
+
+typedef enum { OctreeIndex, BVHIndex, CompactOctreeIndex } SpatialIndexType;
+
+//  Result of a nearest-hit ray query.  Plain data, no allocation.
+//
+//    point   hit point in world space
+//    t       ray parameter of the hit (origin + t * direction)
+//    leaf    index of the leaf node that was hit (-1 for a ray that
+//            missed, in batch queries)
+//    index   face index of the hit (mesh vertex index for an octree of
+//            points)
+//
+class RayHit {
+public:
+	glm::vec3 point;
+	float t;
+	int leaf;
+	int index;
+};
+
+//  Result of a swept box query (SpatialIndex::sweep).
+//
+//    t       fraction of the motion at which the box first touches a face
+//            (0 if it already touches one and is moving into it)
+//    normal  unit contact normal, pointing from the face toward the box
+//    leaf    index of the leaf node holding the face (-1 if the index does
+//            not report leaves)
+//    index   face index
+//
+class SweepHit {
+public:
+	float t;
+	glm::vec3 normal;
+	int leaf;
+	int index;
+};
+
+//  Shape and size of a built index, from SpatialIndex::getStats().
+//
+class IndexStats {
+public:
+	static const int NumLeafSizes = 7;
+
+	int numNodes = 0;
+	int numLeaves = 0;
+	vector<int> nodesAtDepth;       // nodesAtDepth[0] is 1 (the root)
+	vector<int> leavesAtDepth;
+	int leafSizes[NumLeafSizes] = { 0 };   // leaves holding 1, 2, 3-4, 5-8, ... points
+	float meanLeafDepth = 0;
+	float meanLeafSize = 0;         // points (faces) per leaf
+	size_t nodeBytes = 0;
+	size_t indexBytes = 0;
+	size_t meshBytes = 0;           // vertices and triangle indices
+	float buildMillis = 0;          // 0 for a tree loaded from a TerrainPack
+
+	static const char* leafSizeName(int bucket);
+	size_t totalBytes() const { return nodeBytes + indexBytes + meshBytes; }
+
+	// count one node at "depth"; a leaf also counts the number of points
+	// (faces) it holds.  Call finish() after the last node.
+	//
+	void addNode(int depth, bool leaf, int size);
+	void finish();
+};
+
+//  Per-query counters, summed over every query while
+//  SpatialIndex::bCountQueries is on.  Queries count into locals and add
+//  them here once at the end, so the cost is one branch per query when off.
+//  Not thread safe:  turn counting on only if one thread is querying.
+//
+class QueryCounters {
+public:
+	uint64_t queries = 0;
+	uint64_t nodesVisited = 0;
+	uint64_t boxesTested = 0;       // node boxes tested (a packet counts once)
+	uint64_t leavesReached = 0;     // leaves a ray reached, or a box query returned
+	uint64_t primitivesTested = 0;  // points or faces tested in those leaves
+
+	void reset() { *this = QueryCounters(); }
+	void add(const QueryCounters& c) {
+		queries += c.queries;
+		nodesVisited += c.nodesVisited;
+		boxesTested += c.boxesTested;
+		leavesReached += c.leavesReached;
+		primitivesTested += c.primitivesTested;
+	}
+};
+
+class SpatialIndex {
+public:
+	virtual ~SpatialIndex() { }
+
+	// build the index over the triangles of "mesh" (keeps a copy of it)
+	//
+	virtual void create(const ofMesh& mesh) = 0;
+
+	// nearest hit along the ray
+	//
+	virtual bool intersect(const Ray& ray, RayHit& hitRtn) const = 0;
+
+	// batch nearest-hit query.  hitsRtn gets one record per ray (leaf -1
+	// for a miss); returns the number of hits.  The default runs the single
+	// ray query for each ray.
+	//
+	virtual int intersect(ArrayView<Ray> rays, vector<RayHit>& hitsRtn) const;
+
+	// any-hit box query:  true as soon as one leaf overlaps the box
+	//
+	virtual bool overlap(const Box& box) const = 0;
+
+	// continuous collision:  sweep the box along "motion" (from where it is
+	// now to box + motion) and find the first face it touches.  Faces the
+	// box starts in contact with only count if it moves into them, so a box
+	// resting on the terrain can still lift off or slide.  Face indexes
+	// only.  The default tests the faces returned by getIndicesInBox() for
+	// the bounds of the whole sweep.
+	//
+	virtual bool sweep(const Box& box, const glm::vec3& motion, SweepHit& hitRtn) const;
+
+	// boxes of all leaves that overlap the box
+	//
+	virtual bool intersect(const Box& box, vector<Box>& boxListRtn) const = 0;
+
+	// indices of the primitives whose bounds overlap the box.  Returns the
+	// number found.
+	//
+	virtual int getIndicesInBox(const Box& box, vector<int>& indicesRtn) const = 0;
+
+	virtual IndexStats getStats() const = 0;
+	virtual Box bounds() const = 0;
+	virtual const char* name() const = 0;
+
+	// draw the node boxes of the top numLevels levels, starting at "level"
+	// for the colors; drawLeafNodes() draws the leaf boxes.  The boxes are
+	// drawn as one line list with the colors baked in, built and uploaded
+	// once and cached until the levels change or the index is rebuilt.
+	//
+	void draw(int numLevels, int level);
+	void drawLeafNodes();
+	static void drawBox(const Box& box);
+
+	// the line lists drawn by draw() and drawLeafNodes() (OF_PRIMITIVE_LINES,
+	// 2 vertices per edge, one color per vertex).  CPU only, no GL context
+	// needed.
+	//
+	virtual void getNodeLines(int numLevels, int level, ofMesh& linesRtn) const = 0;
+	virtual void getLeafLines(ofMesh& linesRtn) const = 0;
+	static void addBoxLines(const Box& box, const ofFloatColor& color, ofMesh& linesRtn);
+
+	// depth of every node of a tree kept in one array, each node's children
+	// next to each other and after the node (the layout of all the indexes
+	// here), so one pass in node order finds them all.  children(i) returns
+	// node i's (first child, number of children), 0 children for a leaf.
+	//
+	template <class Children>
+	static void nodeDepths(int numNodes, const Children& children, vector<int>& depthRtn) {
+		depthRtn.assign(numNodes, 0);
+		for (int i = 0; i < numNodes; i++) {
+			std::pair<int, int> c = children(i);
+			for (int k = 0; k < c.second; k++) depthRtn[c.first + k] = depthRtn[i] + 1;
+		}
+	}
+
+	// call after the nodes change so draw() rebuilds its lines
+	//
+	void invalidateLines();
+
+	void getFace(int face, glm::vec3 v[3]) const;
+	int getNumFaces() const;
+	static bool rayIntersectTriangle(const Ray& ray, const glm::vec3 v[3], float& t);
+
+	// box (center, half extents) moving by "motion" against a triangle.
+	// True if it touches the triangle before fraction tMax of the motion;
+	// returns the fraction in t and the contact normal.
+	//
+	static bool sweepBoxTriangle(const glm::vec3& center, const glm::vec3& halfSize,
+		const glm::vec3& motion, const glm::vec3 v[3], float tMax, float& t, glm::vec3& normalRtn);
+
+	// the mesh used by queries:  a view into the index's copy of the mesh,
+	// or into a mapped TerrainPack file
+	//
+	ArrayView<glm::vec3> vertices;
+	ArrayView<ofIndexType> meshIndices;   // mesh triangle indices (may be empty)
+
+	// colors of the levels, cycled through by depth
+	//
+	vector<ofColor> colors;
+
+	// instrumentation (see QueryCounters)
+	//
+	float buildMillis = 0;
+	bool bCountQueries = false;
+	mutable QueryCounters counters;
+
+	// line lists cached by draw() and drawLeafNodes(), and the levels the
+	// node lines were built for (-1 = not built)
+	//
+	ofVboMesh nodeLines, leafLines;
+	int nodeLinesLevels = -1, nodeLinesLevel = -1;
+	bool bLeafLinesValid = false;
+};
@@ -0,0 +1,207 @@
+//  Pierce Kyaw, Aye Thwe Tun
+//
+//  Precompiled, memory mapped terrain pack.  See TerrainPack.h for the
+//  file layout.
+//
+
+#include "TerrainPack.h"
+#include <fstream>
+#include <climits>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char packMagic[8] = { 'T', 'E', 'R', 'R', 'P', 'A', 'C', 'K' };
+
+// round up to the next multiple of 16
+//
+static uint64_t align16(uint64_t n) {
+	return (n + 15) & ~(uint64_t)15;
+}
+
+uint64_t TerrainPack::hashFile(const string& path) {
+	std::ifstream in(path, std::ios::binary);
+	if (!in) return 0;
+
+	uint64_t hash = 14695981039346656037ULL;
+	char buf[1 << 16];
+	while (in) {
+		in.read(buf, sizeof(buf));
+		std::streamsize n = in.gcount();
+		for (std::streamsize i = 0; i < n; i++) {
+			hash ^= (unsigned char)buf[i];
+			hash *= 1099511628211ULL;
+		}
+	}
+	return hash;
+}
+
+bool TerrainPack::save(const string& path, uint64_t sourceHash, const Octree& octree) {
+	if (octree.nodes.empty()) return false;
+
+	TerrainPackHeader h;
+	memset((void*)&h, 0, sizeof(h));
+	memcpy(h.magic, packMagic, sizeof(packMagic));
+	h.version = Version;
+	h.nodeSize = sizeof(TreeNode);
+	h.sourceHash = sourceHash;
+	h.levels = octree.levels;
+	h.useFaces = octree.bUseFaces;
+	h.builder = octree.builder;
+	h.settings = octree.settings;
+
+	// the root box is the mesh bounds, so its min y is the lowest vertex
+	//
+	const Box& bounds = octree.root().box;
+	for (int k = 0; k < 3; k++) {
+		h.bounds[k] = bounds.min()[k];
+		h.bounds[3 + k] = bounds.max()[k];
+	}
+	h.minY = bounds.min().y();
+
+	h.numVertices = octree.vertices.size();
+	h.numMeshIndices = octree.meshIndices.size();
+	h.numNodes = octree.nodes.size();
+	h.numIndices = octree.indices.size();
+	h.vertexOffset = align16(sizeof(h));
+	h.meshIndexOffset = align16(h.vertexOffset + h.numVertices * sizeof(glm::vec3));
+	h.nodeOffset = align16(h.meshIndexOffset + h.numMeshIndices * sizeof(ofIndexType));
+	h.indexOffset = align16(h.nodeOffset + h.numNodes * sizeof(TreeNode));
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out) return false;
+
+	auto writeAt = [&](uint64_t offset, const void* p, uint64_t bytes) {
+		static const char zeros[16] = { 0 };
+		uint64_t pos = out.tellp();
+		out.write(zeros, offset - pos);
+		out.write((const char*)p, bytes);
+	};
+	out.write((const char*)&h, sizeof(h));
+	writeAt(h.vertexOffset, octree.vertices.data(), h.numVertices * sizeof(glm::vec3));
+	writeAt(h.meshIndexOffset, octree.meshIndices.data(), h.numMeshIndices * sizeof(ofIndexType));
+	writeAt(h.nodeOffset, octree.nodes.data(), h.numNodes * sizeof(TreeNode));
+	writeAt(h.indexOffset, octree.indices.data(), h.numIndices * sizeof(int));
+	return (bool)out;
+}
+
+bool TerrainPack::load(const string& path, uint64_t sourceHash, const Octree& octree) {
+	close();
+
+#ifdef _WIN32
+	HANDLE f = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, NULL);
+	if (f == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(f, &fileSize)) {
+		CloseHandle(f);
+		return false;
+	}
+	HANDLE m = CreateFileMappingA(f, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m == NULL) {
+		CloseHandle(f);
+		return false;
+	}
+	file = f;
+	mapping = m;
+	size = (size_t)fileSize.QuadPart;
+	data = (const char*)MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+#else
+	fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		close();
+		return false;
+	}
+	size = st.st_size;
+	void* p = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+	data = (p == MAP_FAILED) ? nullptr : (const char*)p;
+#endif
+	if (data == nullptr) {
+		close();
+		return false;
+	}
+
+	// validate the header, that every section fits in the file, that the
+	// nodes stay inside the node and index arrays and that the indices name
+	// faces (vertices in point mode) and vertices of the mesh, so a damaged
+	// pack is rebuilt rather than crashing the queries
+	//
+	auto fits = [this](uint64_t offset, uint64_t count, size_t bytes) {
+		return offset % 16 == 0 && offset <= size && count <= (size - offset) / bytes;
+	};
+	bool ok = size >= sizeof(TerrainPackHeader);
+	if (ok) {
+		const TerrainPackHeader& h = header();
+		ok = memcmp(h.magic, packMagic, sizeof(packMagic)) == 0 &&
+			h.version == Version &&
+			h.nodeSize == sizeof(TreeNode) &&
+			h.sourceHash == sourceHash &&
+			h.levels == octree.levels &&
+			h.useFaces == (int)octree.bUseFaces &&
+			h.builder == octree.builder &&
+			h.settings == octree.settings &&
+			fits(h.vertexOffset, h.numVertices, sizeof(glm::vec3)) &&
+			fits(h.meshIndexOffset, h.numMeshIndices, sizeof(ofIndexType)) &&
+			fits(h.nodeOffset, h.numNodes, sizeof(TreeNode)) &&
+			fits(h.indexOffset, h.numIndices, sizeof(int)) &&
+			h.numNodes > 0 && h.numNodes <= INT_MAX && h.numIndices <= INT_MAX;
+		ok = ok && Octree::validNodes((const TreeNode*)(data + h.nodeOffset), h.numNodes, h.numIndices);
+	}
+	if (ok) {
+		const TerrainPackHeader& h = header();
+		const ofIndexType* meshIndices = (const ofIndexType*)(data + h.meshIndexOffset);
+		for (uint64_t i = 0; ok && i < h.numMeshIndices; i++) ok = meshIndices[i] < h.numVertices;
+		uint64_t numFaces = (h.numMeshIndices > 0 ? h.numMeshIndices : h.numVertices) / 3;
+		uint64_t limit = h.useFaces ? numFaces : h.numVertices;
+		const int* indices = (const int*)(data + h.indexOffset);
+		for (uint64_t i = 0; ok && i < h.numIndices; i++) ok = indices[i] >= 0 && (uint64_t)indices[i] < limit;
+	}
+	if (!ok) close();
+	return ok;
+}
+
+void TerrainPack::close() {
+#ifdef _WIN32
+	if (data) UnmapViewOfFile(data);
+	if (mapping) CloseHandle((HANDLE)mapping);
+	if (file) CloseHandle((HANDLE)file);
+	mapping = nullptr;
+	file = nullptr;
+#else
+	if (data) munmap((void*)data, size);
+	if (fd >= 0) ::close(fd);
+	fd = -1;
+#endif
+	data = nullptr;
+	size = 0;
+}
+
+void TerrainPack::attach(Octree& octree) const {
+	const TerrainPackHeader& h = header();
+	octree.vertices = ArrayView<glm::vec3>((const glm::vec3*)(data + h.vertexOffset), h.numVertices);
+	octree.meshIndices = ArrayView<ofIndexType>((const ofIndexType*)(data + h.meshIndexOffset), h.numMeshIndices);
+	octree.nodes = ArrayView<TreeNode>((const TreeNode*)(data + h.nodeOffset), h.numNodes);
+	octree.indices = ArrayView<int>((const int*)(data + h.indexOffset), h.numIndices);
+	octree.levels = h.levels;
+	octree.bUseFaces = h.useFaces != 0;
+	octree.builder = (OctreeBuilder)h.builder;
+	octree.settings = h.settings;
+	octree.invalidateLines();
+	if (octree.colors.empty()) {
+		octree.colors = std::vector<ofColor>{ ofColor::red, ofColor::green, ofColor::blue, ofColor::yellow, ofColor::cyan, ofColor::magenta };
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+//  Pierce Kyaw, Aye Thwe Tun
+//
+//  Precompiled terrain pack.  A pack stores everything the game derives
+//  from the terrain mesh at startup -- vertices, triangle indices, the built
+//  octree and the bounds / lowest point -- in one binary file laid out so
+//  it can be mapped into memory and used in place.  The pack is keyed on a
+//  hash of the source mesh file; if the hash (or the octree settings) do not
+//  match, load() fails and the caller rebuilds and saves a new pack.
+//
+//  File layout (all sections 16 byte aligned):
+//
+//     TerrainPackHeader
+//     glm::vec3    vertices[numVertices]
+//     ofIndexType  meshIndices[numMeshIndices]
+//     TreeNode     nodes[numNodes]
+//     int          indices[numIndices]
+//
+
+#include "ofMain.h"
+#include "Octree.h"
+
+class TerrainPackHeader {
+public:
+	char magic[8];              // "TERRPACK"
+	uint32_t version;
+	uint32_t nodeSize;          // sizeof(TreeNode) of the writer
+	uint64_t sourceHash;        // hash of the source mesh file
+	int32_t levels;
+	int32_t useFaces;
+	int32_t builder;
+	OctreeSettings settings;
+	float bounds[6];            // min xyz, max xyz of the mesh
+	float minY;                 // lowest vertex of the mesh
+	uint64_t numVertices, numMeshIndices, numNodes, numIndices;
+	uint64_t vertexOffset, meshIndexOffset, nodeOffset, indexOffset;
+};
+
+class TerrainPack {
+public:
+	static const uint32_t Version = 3;     // 2: 16 byte aligned Vector3, 3: OctreeSettings
+
+	TerrainPack() { }
+	~TerrainPack() { close(); }
+	TerrainPack(const TerrainPack&) = delete;
+	TerrainPack& operator=(const TerrainPack&) = delete;
+
+	// 64 bit FNV-1a hash of a file's contents (0 if it can't be read)
+	//
+	static uint64_t hashFile(const string& path);
+
+	// write the octree (and the mesh data it refers to) to a pack file
+	//
+	static bool save(const string& path, uint64_t sourceHash, const Octree& octree);
+
+	// map a pack file.  Fails if the file is missing, was written by a
+	// different version, does not match sourceHash and the build settings
+	// (levels, face mode, builder, OctreeSettings) of "octree", or is
+	// damaged (a section outside the file, a node outside the arrays).
+	//
+	bool load(const string& path, uint64_t sourceHash, const Octree& octree);
+	void close();
+	bool isLoaded() const { return data != nullptr; }
+
+	// point the octree's views at the mapped data; the pack must stay
+	// loaded as long as the octree is used
+	//
+	void attach(Octree& octree) const;
+
+	const TerrainPackHeader& header() const { return *(const TerrainPackHeader*)data; }
+	float minY() const { return header().minY; }
+
+private:
+	const char* data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#else
+	int fd = -1;
+#endif
+};
@@ -13,25 +13,11 @@
  */
 
 bool Box::intersect(const Ray& r, float t0, float t1) const {
-    float tmin, tmax, tymin, tymax, tzmin, tzmax;
+    float tEnter;
+    return intersect(r, t0, t1, tEnter);
+}
 
-    tmin = (parameters[r.sign[0]].x() - r.origin.x()) * r.inv_direction.x();
-    tmax = (parameters[1 - r.sign[0]].x() - r.origin.x()) * r.inv_direction.x();
-    tymin = (parameters[r.sign[1]].y() - r.origin.y()) * r.inv_direction.y();
-    tymax = (parameters[1 - r.sign[1]].y() - r.origin.y()) * r.inv_direction.y();
-    if ((tmin > tymax) || (tymin > tmax))
-        return false;
-    if (tymin > tmin)
-        tmin = tymin;
-    if (tymax < tmax)
-        tmax = tymax;
-    tzmin = (parameters[r.sign[2]].z() - r.origin.z()) * r.inv_direction.z();
-    tzmax = (parameters[1 - r.sign[2]].z() - r.origin.z()) * r.inv_direction.z();
-    if ((tmin > tzmax) || (tzmin > tmax))
-        return false;
-    if (tzmin > tmin)
-        tmin = tzmin;
-    if (tzmax < tmax)
-        tmax = tzmax;
-    return ((tmin < t1) && (tmax > t0));
+bool Box::intersect(const Ray& r, float t0, float t1, float& tEnter) const {
+    // branchless SSE slab test, or the scalar version without SSE (simd.h)
+    return slabTest(r, parameters[0], parameters[1], t0, t1, tEnter);
 }
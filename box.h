@@ -4,6 +4,7 @@
 #include <assert.h>
 #include "vector3.h"
 #include "ray.h"
+#include "simd.h"
 
 /*
  * Axis-aligned bounding box class, for use with the optimized ray-box
@@ -25,6 +26,9 @@ public:
 	}
 	// (t0, t1) is the interval for valid hits
 	bool intersect(const Ray&, float t0, float t1) const;
+	// same test, also returns the parameter where the ray enters the box
+	// (clamped to t0 when the ray starts inside)
+	bool intersect(const Ray&, float t0, float t1, float& tEnter) const;
 
 	// corners
 	Vector3 parameters[2];
@@ -32,9 +36,7 @@ public:
 	Vector3 min() const { return parameters[0]; }
 	Vector3 max() const { return parameters[1]; }
 	const bool inside(const Vector3& p) {
-		return ((p.x() >= parameters[0].x() && p.x() <= parameters[1].x()) &&
-			(p.y() >= parameters[0].y() && p.y() <= parameters[1].y()) &&
-			(p.z() >= parameters[0].z() && p.z() <= parameters[1].z()));
+		return insideTest(parameters[0], parameters[1], p);
 	}
 	const bool inside(Vector3* points, int size) {
 		bool allInside = true;
@@ -48,14 +50,8 @@ public:
 	// implement for Homework Project
 	//
 	bool overlap(const Box& box) const {
-		// Check for separation along x-axis
-		if (max().x() < box.min().x() || min().x() > box.max().x()) return false;
-		// Check for separation along y-axis
-		if (max().y() < box.min().y() || min().y() > box.max().y()) return false;
-		// Check for separation along z-axis
-		if (max().z() < box.min().z() || min().z() > box.max().z()) return false;
-		// If no separation on any axis, boxes overlap
-		return true;
+		// no separation on any axis (see overlapTest in simd.h)
+		return overlapTest(parameters[0], parameters[1], box.parameters[0], box.parameters[1]);
 	}
 
 	Vector3 center() const {
@@ -1,8 +1,90 @@
 #include "ofMain.h"
 #include "ofApp.h"
+#include "HeadlessRunner.h"
+#include "MonteCarloLanding.h"
+#include "LanderPool.h"
+#include "IntegratorBenchmark.h"
 
 //========================================================================
-int main( ){
+//  Pass --bvh to use a BVH instead of the octree for the terrain, or
+//  --compact for the octree with compact nodes.  --paged tests terrain
+//  collisions against an out-of-core paged octree.  --rate <hz> sets the
+//  simulation steps per second (default 60).
+//
+//  --headless runs the simulation without a window and prints how fast it
+//  ran (see HeadlessRunner.h), with --steps <n>, --script <file> and
+//  --no-particles.  --box-collisions collides the rocket's box instead of
+//  its mesh (RocketCollider.h), here and with --montecarlo.
+//
+//  --montecarlo <n> flies n autopiloted descents on all cores and prints
+//  the landing rate and touchdown speeds (see MonteCarloLanding.h), with
+//  --threads <n>, --threshold <m/s> (landing speed), --fuel <sec of thrust>,
+//  --max-thrust <n> and --seed <n>.  --no-sweep turns off the swept
+//  collisions (see LanderSim.h) to compare.
+//
+//  --landers <n> flies n autopiloted landers together (LanderPool.h) for
+//  --steps steps and prints the time per step.
+//
+//  --integrator <euler|semi-implicit|verlet|rk4> moves the rocket and the
+//  particles with that integrator (Integrator.h), in the game and with
+//  --headless and --montecarlo.  --integrators compares the integrators'
+//  error and cost at several step rates (IntegratorBenchmark.h), with
+//  --tolerance <m>.
+//
+int main(int argc, char* argv[]){
+
+	HeadlessSettings headless;
+	bool bHeadless = false;
+	bool bPaged = false;
+	MonteCarloSettings monteCarlo;
+	bool bMonteCarlo = false;
+	int numLanders = 0;
+	IntegratorBenchmarkSettings integrators;
+	bool bIntegrators = false;
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		bool bValue = i + 1 < argc;
+		if (arg == "--bvh") headless.indexType = BVHIndex;
+		if (arg == "--compact") headless.indexType = CompactOctreeIndex;
+		if (arg == "--paged") bPaged = true;
+		if (arg == "--rate" && bValue) headless.rate = max(1.0, atof(argv[++i]));
+		if (arg == "--headless") bHeadless = true;
+		if (arg == "--steps" && bValue) headless.steps = atoi(argv[++i]);
+		if (arg == "--script" && bValue) headless.scriptPath = argv[++i];
+		if (arg == "--no-particles") headless.bParticles = false;
+		if (arg == "--box-collisions") headless.bMeshCollisions = false;
+		if (arg == "--montecarlo" && bValue) {
+			bMonteCarlo = true;
+			monteCarlo.descents = atoi(argv[++i]);
+		}
+		if (arg == "--threads" && bValue) monteCarlo.numThreads = atoi(argv[++i]);
+		if (arg == "--threshold" && bValue) monteCarlo.lander.landingSpeedThreshold = atof(argv[++i]);
+		if (arg == "--fuel" && bValue) monteCarlo.lander.maxThrustTime = atof(argv[++i]);
+		if (arg == "--max-thrust" && bValue) monteCarlo.maxThrust = atof(argv[++i]);
+		if (arg == "--seed" && bValue) monteCarlo.seed = atoi(argv[++i]);
+		if (arg == "--no-sweep") monteCarlo.lander.bSweepCollisions = false;
+		if (arg == "--landers" && bValue) numLanders = atoi(argv[++i]);
+		if (arg == "--integrator" && bValue) {
+			string name = argv[++i];
+			if (name == "euler") headless.integrator = ExplicitEulerIntegrator;
+			else if (name == "semi-implicit") headless.integrator = SemiImplicitEulerIntegrator;
+			else if (name == "verlet") headless.integrator = VelocityVerletIntegrator;
+			else if (name == "rk4") headless.integrator = RK4Integrator;
+			else cout << "unknown integrator " << name << ", using " << Integrator::name(headless.integrator) << endl;
+		}
+		if (arg == "--integrators") bIntegrators = true;
+		if (arg == "--tolerance" && bValue) integrators.tolerance = atof(argv[++i]);
+	}
+	monteCarlo.rate = headless.rate;
+	monteCarlo.lander.integrator = headless.integrator;
+
+	if (bIntegrators) {
+		benchmarkIntegrators(integrators);
+		return 0;
+	}
+	if (bMonteCarlo) return runMonteCarlo(headless, monteCarlo);
+	if (numLanders > 0) return runLanderPool(headless, numLanders);
+	if (bHeadless) return runHeadless(headless);
 
 	//Use ofGLFWWindowSettings for more options like multi-monitor fullscreen
 	ofGLWindowSettings settings;
@@ -11,7 +93,13 @@ int main( ){
 
 	auto window = ofCreateWindow(settings);
 
-	ofRunApp(window, make_shared<ofApp>());
+	auto app = make_shared<ofApp>();
+	app->indexType = headless.indexType;
+	app->bPagedTerrain = bPaged;
+	app->simRate = headless.rate;
+	app->integrator = headless.integrator;
+
+	ofRunApp(window, app);
 	ofRunMainLoop();
 
 }
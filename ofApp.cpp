@@ -1,19 +1,17 @@
 #include "ofApp.h"
 #include "Util.h"
+#include "OctreeBenchmark.h"
 #include <glm/gtx/intersect.hpp>
 
 //Pierce Kyaw, Aye Thwe Tun
 void ofApp::setup() {
-    // Initialize score and various state variables
-    score = 0;
-
+    // Initialize various state variables
     bWireframe = false;
     bDisplayPoints = false;
     bAltKeyDown = false;
     bCtrlKeyDown = false;
     bRocketLoaded = false;
     bTerrainSelected = true;
-    gravitationalForce = glm::vec3(0, -terrainGravity, 0);
 
     radius = 5;
 
@@ -22,15 +20,9 @@ void ofApp::setup() {
     ofEnableSmoothing();
     ofEnableDepthTest();
 
-    rotation = 0.0;
-
     // Since we are loading textures, turn off arbitrary textures
     ofDisableArbTex();
 
-    fuel = 120;
-    startFuel = 120;
-    maxThrustTime = 120.0f;
-    totalThrustTime = 0.0f;
     startThrustTime = 0.0f;
 
     // Initialize lighting and materials
@@ -39,16 +31,69 @@ void ofApp::setup() {
     // Load background image
     background.loadImage("images/space.jpg");
 
-    printf("Map loaded. Creating Octree....\n");
-
-    // Load the terrain model and create an octree for spatial queries
+    // Load the terrain model and create the spatial index (octree or BVH,
+    // chosen in main.cpp) for spatial queries
     if (terrain.loadModel("geo/moonterrain.obj"))
     {
         terrain.setScaleNormalization(false);
-        printf("Map loaded, creating octree...\n");
 
-        octree.create(terrain.getMesh(0), 20);
-        printf("Octree created!\n");
+        // store triangles in the leaves so ray queries return exact surface points
+        octree.bUseFaces = true;
+        octree.levels = 20;
+
+        if (indexType == BVHIndex) {
+            printf("Map loaded, creating BVH...\n");
+            bvh.create(terrain.getMesh(0));
+            terrainIndex = &bvh;
+            printf("BVH created!\n");
+        }
+        else {
+            printf("Map loaded, creating octree...\n");
+
+            // use the precompiled terrain pack if it was built from this mesh file,
+            // otherwise build the octree and write a new pack for the next run
+            uint64_t terrainHash = TerrainPack::hashFile(ofToDataPath("geo/moonterrain.obj"));
+            string packPath = ofToDataPath("geo/moonterrain.pack");
+            if (terrainPack.load(packPath, terrainHash, octree)) {
+                terrainPack.attach(octree);
+                printf("Octree loaded from terrain pack!\n");
+            }
+            else {
+                octree.create(terrain.getMesh(0), octree.levels);
+                if (!TerrainPack::save(packPath, terrainHash, octree)) {
+                    printf("Could not write terrain pack.\n");
+                }
+                printf("Octree created!\n");
+            }
+            terrainIndex = &octree;
+
+            // out-of-core terrain for the collision test.  The pages file
+            // is written from the octree here so the mode can be tried on
+            // this terrain; a terrain too large to load would come with
+            // its pages file written offline.
+            if (bPagedTerrain) {
+                string pagesPath = ofToDataPath("geo/moonterrain.pages");
+                if (!pagedTerrain.open(pagesPath, terrainHash, pagedBudget)) {
+                    PagedOctree::save(pagesPath, terrainHash, octree);
+                    bPagedTerrain = pagedTerrain.open(pagesPath, terrainHash, pagedBudget);
+                }
+                if (bPagedTerrain) printf("Paged terrain opened!\n");
+            }
+
+            // the compact octree copies what it needs, so the full size
+            // nodes are freed
+            if (indexType == CompactOctreeIndex) {
+                compactOctree.create(octree);
+                octree = Octree();
+                octree.bUseFaces = true;
+                octree.levels = compactOctree.levels;
+                terrainIndex = &compactOctree;
+                printf("Octree compressed!\n");
+            }
+        }
+
+        // the pages file is only made from the octree
+        if (!pagedTerrain.isOpen()) bPagedTerrain = false;
     }
     else
     {
@@ -64,6 +109,7 @@ void ofApp::setup() {
         rocket.setRotation(0, 0.0, 0, 1, 0);
         rocket.setPosition(0, 30, 0);
         rocket.update();
+        createRocketCollider();
         bRocketLoaded = true;
     }
     else
@@ -72,6 +118,12 @@ void ofApp::setup() {
         ofExit(0);
     }
 
+    // Moving objects (the rocket), for box and ray queries next to the
+    // terrain.  The tree covers the terrain and the sky above it.
+    Box terrainBounds = terrainIndex->bounds();
+    objects.create(Box(terrainBounds.min(), terrainBounds.max() + Vector3(0, 100, 0)));
+    objects.insert(rocketId, getRocketBounds());
+
     // Load sound effects and background music
     if (backgroundMusic.load("sounds/Background.mp3") && crashSound.load("sounds/Crash.mp3")
         && thrustSound.load("sounds/Thrusters.mp3")
@@ -117,34 +169,9 @@ void ofApp::setup() {
     gui.add(thrust.setup("Thrust", 100, 1, 1000));
     gui.add(numLevels.setup("Number of Octree Levels", 1, 1, 10));
 
-    // Set up forces for particle systems
-    // Turbulence force
-    tForce = new TurbulenceForce(ofVec3f(-20, -20, -20), ofVec3f(20, 20, 20));
-    // Gravity force
-    gForce = new GravityForce(ofVec3f(0, -10, 0));
-    // Radial force for explosions
-    iForce = new ImpulseRadialForce(1000.0);
-
-    // Create an Emitter for the rocket's engine
-    emitter.setOneShot(true);
-    emitter.setEmitterType(RadialEmitter);
-    emitter.setGroupSize(10);
-    emitter.particleRadius = .0001;
-    emitter.spawn(1);
-    emitter.setParticleRadius(0.5);
-    emitter.setRate(0.5);
-    emitter.setLifespan(1.0);
-    emitter.sys->addForce(tForce);
-    emitter.sys->addForce(gForce);
-    emitter.setVelocity(ofVec3f(0, 5, 0));
-
-    // Emitter for explosions
-    explosion.setOneShot(true);
-    explosion.setEmitterType(RadialEmitter);
-    explosion.setGroupSize(100);
-    explosion.setParticleRadius(0.5);
-    explosion.setLifespan(2.0);
-    explosion.sys->addForce(iForce);
+    // Emitters for the rocket's engine and explosions
+    LanderSim::setupEmitters(emitter, explosion);
+    setIntegrator(integrator);
 
     glm::vec3 rocketPos = rocket.getPosition();
 
@@ -185,77 +212,79 @@ void ofApp::setup() {
     dynamicLight.setPosition(rocket.getPosition() + glm::vec3(0, 10, 0));
     dynamicLight.rotate(90, ofVec3f(1, 0, 0));
 
-    // Compute minimum terrain Y coordinate
-    ofMesh terrainMesh = terrain.getMesh(0);
-    float minY = std::numeric_limits<float>::max();
-    for (int i = 0; i < terrainMesh.getNumVertices(); i++) {
-        glm::vec3 v = terrainMesh.getVertex(i);
-        if (v.y < minY) minY = v.y;
-    }
-    minTerrainY = minY;
-    int totalVerts = terrainMesh.getNumVertices();
-
-    // Randomly select landing zones on the terrain
-    for (int i = 0; i < 3; i++) {
-        int randomIndex = (int)ofRandom(0, totalVerts);
-        glm::vec3 randomVertex = terrainMesh.getVertex(randomIndex);
-        Ray groundRay(Vector3(randomVertex.x, randomVertex.y + 200, randomVertex.z), Vector3(0, -1, 0));
-        TreeNode groundNode;
-
-        if (octree.intersect(groundRay, octree.root, groundNode)) {
-            glm::vec3 groundPoint = octree.mesh.getVertex(groundNode.points[0]);
-            landingZones[i].center = groundPoint;
-        }
-        else {
-            landingZones[i].center = randomVertex;
-        }
+    // Minimum terrain Y coordinate
+    minTerrainY = terrainIndex->bounds().min().y();
+
+    // Height field for constant time ground lookups (altitude, hover,
+    // landing zones)
+    heightField.create(*terrainIndex);
+    printf("Height field created (%d x %d cells)\n", heightField.numCellsX, heightField.numCellsZ);
+
+    // The rocket's physics, against the terrain index built above
+    lander.terrain = terrainIndex;
+    lander.pagedTerrain = bPagedTerrain ? &pagedTerrain : nullptr;
+    lander.heightField = &heightField;
+    lander.localBounds = Box(Vector3(rocket.getSceneMin().x, rocket.getSceneMin().y, rocket.getSceneMin().z),
+        Vector3(rocket.getSceneMax().x, rocket.getSceneMax().y, rocket.getSceneMax().z));
+    lander.collider = &rocketCollider;
+    lander.engine = &emitter;
+    lander.explosion = &explosion;
+    lander.reset(rocket.getPosition());
+
+    placeLandingZones();
+}
 
-        landingZones[i].radius = 5.0;
-    }
+// Randomly select landing zones on the terrain
+void ofApp::placeLandingZones() {
+    lander.placeLandingZones(3);
 }
 
 //Pierce Kyaw, Aye Thwe Tun
 void ofApp::update() {
+    // Sample the spatial index query counters of the last frame
+    if (terrainIndex->bCountQueries) {
+        frameCounters = terrainIndex->counters;
+        terrainIndex->counters.reset();
+    }
+
     // If the game has started
     if (bStart) {
-        // If the game is not over, check collisions
-        if (!bOver) {
-            checkCollisions();
+        // If the rocket was moved outside the simulation (dragged or reset),
+        // start from there, and don't interpolate from where it was
+        if (rocket.getPosition() != simRocketPosition) {
+            lander.position = rocket.getPosition();
+            prevRocketPosition = lander.position;
+            prevRotation = lander.rotation;
         }
 
-        // Update emitters for engine and explosions
-        emitter.update();
-        explosion.update();
-
-        // If the rocket is on the ground, stop its movement
-        if (bgrounded) {
-            velocity = glm::vec3(0, 0, 0);
-            acceleration = glm::vec3(0, 0, 0);
-            force = glm::vec3(0, 0, 0);
+        // Run as many fixed steps as the real time since the last frame
+        // covers, dropping the time beyond maxStepsPerFrame steps
+        float dt = 1.0 / simRate;
+        simAccumulator += ofGetLastFrameTime();
+        if (simAccumulator > maxStepsPerFrame * dt) simAccumulator = maxStepsPerFrame * dt;
+        while (simAccumulator >= dt) {
+            prevRocketPosition = lander.position;
+            prevRotation = lander.rotation;
+            lander.step(dt);
+            if (landers.size() > 0) landers.step(dt);
+            simAccumulator -= dt;
         }
+        simRocketPosition = lander.position;
+        setRocketPose(lander.position, lander.rotation);
+        objects.move(rocketId, getRocketBounds());
 
-        // Manage thrust and fuel consumption
-        if (bStart && bThrust && !bOver && fuel > 0) {
-            float currentThrustDuration = ofGetElapsedTimef() - startThrustTime;
-
-            totalThrustTime += currentThrustDuration;
-            startThrustTime = ofGetElapsedTimef();
+        // Pose to draw the rocket at, between the last two steps
+        float alpha = simAccumulator / dt;
+        renderPosition = glm::mix(prevRocketPosition, lander.position, alpha);
+        renderRotation = ofLerp(prevRotation, lander.rotation, alpha);
 
-            fuel = (1.0f - (totalThrustTime / maxThrustTime)) * 120;
-
-            // If fuel runs out
-            if (fuel <= 0 || totalThrustTime >= maxThrustTime) {
-                fuel = 0;
-                velocity = glm::vec3(0, 0, 0);
-                acceleration = glm::vec3(0, 0, 0);
-                force = glm::vec3(0, 0, 0);
-                bOver = true;
-                noFuel = true;
-            }
-        }
+        // Sounds for what happened in the steps
+        if (lander.events & LandedEvent) winSound.play();
+        if (lander.events & CrashedEvent) crashSound.play();
+        lander.events = NoEvent;
 
         // Update the timer when thrust is applied and game is not over
-        if (!bOver && bThrust) {
+        if (!lander.bOver && lander.bThrust) {
             int tempTime = ofGetElapsedTimeMillis() / 1000;
             timer = tempTime - startTime;
         }
@@ -264,39 +293,34 @@ void ofApp::update() {
         if (!backgroundMusic.isPlaying()) backgroundMusic.play();
 
         // Update camera and light positions relative to rocket
-        trackingCam.lookAt(rocketPosition);
-        bottomCam.setPosition(rocketPosition.x, rocketPosition.y - 5, rocketPosition.z);
-        TopDownCam.setPosition(rocketPosition.x, rocketPosition.y + 10, rocketPosition.z);
-        dynamicLight.setPosition(rocket.getPosition() + glm::vec3(0, 10, 0));
+        trackingCam.lookAt(renderPosition);
+        bottomCam.setPosition(renderPosition.x, renderPosition.y - 5, renderPosition.z);
+        TopDownCam.setPosition(renderPosition.x, renderPosition.y + 10, renderPosition.z);
+        dynamicLight.setPosition(renderPosition + glm::vec3(0, 10, 0));
 
         // Calculate rocket's altitude
-        Ray altitudeRay = Ray(Vector3(rocket.getPosition().x, rocket.getPosition().y, rocket.getPosition().z),
-            Vector3(rocket.getPosition().x, rocket.getPosition().y - 200, rocket.getPosition().z));
-        TreeNode altNode;
-        if (octree.intersect(altitudeRay, octree.root, altNode)) {
-            distanceToGround = glm::length(octree.mesh.getVertex(altNode.points[0]) - rocket.getPosition());
+        GroundHit ground;
+        if (heightField.groundBelow(rocket.getPosition(), ground)) {
+            distanceToGround = rocket.getPosition().y - ground.point.y;
         }
 
         altitude = rocket.getPosition().y - minTerrainY;
 
-        // Update explosion position
-        glm::vec3 pos = rocket.getPosition();
-        explosion.setPosition(glm::vec3(pos.x, pos.y, pos.z));
-
-        // Update emitter position (for engine particles)
-        glm::vec3 rocketMin = rocket.getSceneMin() + rocket.getPosition();
-        glm::vec3 emitterPos = rocket.getPosition();
-        emitterPos.y = rocketMin.y;
-        emitter.setPosition(emitterPos);
-
-        // Integrate to update physics (position, velocity, etc.)
-        integrate();
-
-        // Reset force for next frame
-        force = glm::vec3(0, 0, 0);
+        // read the terrain pages the rocket is heading for
+        if (bPagedTerrain) {
+            pagedTerrain.prefetch(rocket.getPosition(), lander.velocity, 2.0f, 10.0f);
+            pagedTerrain.update();
+        }
     }
 }
 
+// Place the rocket model
+//
+void ofApp::setRocketPose(const glm::vec3& position, float angle) {
+    rocket.setPosition(position.x, position.y, position.z);
+    rocket.setRotation(0, angle, 0, 1, 0);
+}
+
 //Pierce Kyaw, Aye Thwe Tun
 void ofApp::draw() {
     // Load the VBO for particles
@@ -310,6 +334,11 @@ void ofApp::draw() {
 
     glDepthMask(true);
 
+    // Draw the rocket at its interpolated pose, and put its pose back when
+    // the scene is done
+    glm::vec3 rocketPos = rocket.getPosition();
+    if (bStart) setRocketPose(renderPosition, renderRotation);
+
     currentCam->begin();
 
     // Draw explosion particles
@@ -346,6 +375,12 @@ void ofApp::draw() {
                     Octree::drawBox(bboxList[i]);
                     ofPopMatrix();
                 }
+
+                // where the rocket's mesh touched the terrain
+                ofSetColor(ofColor::red);
+                for (int i = 0; i < lander.contacts.size(); i++) {
+                    ofDrawSphere(lander.contacts[i].point, .05);
+                }
             }
 
             if (bRocketSelected) {
@@ -412,20 +447,19 @@ void ofApp::draw() {
     ofDisableLighting();
     int level = 0;
 
-    // Display Octree if enabled
+    // Display Octree (or BVH) if enabled
     if (bDisplayLeafNodes) {
-        octree.drawLeafNodes(octree.root);
-        cout << "num leaf: " << octree.numLeaf << endl;
+        terrainIndex->drawLeafNodes();
     }
     else if (bDisplayOctree) {
         ofNoFill();
         ofSetColor(ofColor::white);
-        octree.draw(numLevels, 0);
+        terrainIndex->draw(numLevels, 0);
     }
 
     // Draw selected node if a point is selected
     if (pointSelected) {
-        ofVec3f p = octree.mesh.getVertex(selectedNode.points[0]);
+        ofVec3f p = selectedHit.point;
         ofVec3f d = p - cam.getPosition();
         ofSetColor(ofColor::lightGreen);
         ofDrawSphere(p, .02 * d.length());
@@ -433,19 +467,24 @@ void ofApp::draw() {
 
     ofDisableDepthTest();
 
+    // AI landers
+    if (landers.size() > 0) drawLanders();
+
     // Draw landing zones
-    for (int i = 0; i < 3; i++) {
+    for (int i = 0; i < lander.landingZones.size(); i++) {
         ofPushMatrix();
-        ofTranslate(landingZones[i].center);
+        ofTranslate(lander.landingZones[i].center);
         ofSetColor(ofColor::blue);
         ofRotateXDeg(-90);
         ofNoFill();
-        ofDrawCircle(0, 0, landingZones[i].radius);
+        ofDrawCircle(0, 0, lander.landingZones[i].radius);
         ofPopMatrix();
     }
 
     currentCam->end();
 
+    if (bStart) setRocketPose(rocketPos, lander.rotation);
+
     // Draw GUI if not hidden
     if (!bHide) {
         ofDisableDepthTest();
@@ -479,20 +518,20 @@ void ofApp::draw() {
     }
 
     // Display text (fuel, altitude, score) during gameplay
-    if (bStart && !bOver)
+    if (bStart && !lander.bOver)
     {
         drawText();
     }
 
     // If game over, display appropriate end game messages
-    if (bOver) {
+    if (lander.bOver) {
         ofSetColor(ofColor::white);
 
         string altitudeMsg = "Altitude: " + std::to_string(altitude);
-        string scoreMessage = "Your Score: " + std::to_string(score);
+        string scoreMessage = "Your Score: " + std::to_string(lander.score);
         float charWidth = 8.0f;
 
-        if (bWin && bgrounded) {
+        if (lander.bWin && lander.bGrounded) {
             // Successful landing scenario
             string mainMsg = "CONGRATULATIONS! You landed safely!";
 
@@ -514,13 +553,13 @@ void ofApp::draw() {
             ofDrawBitmapString(altitudeMsg, altX, altY);
 
         }
-        else if (bgrounded && !bWin && !noFuel) {
+        else if (lander.bGrounded && !lander.bWin && !lander.bNoFuel) {
             // Crash scenarios
-            if (bCrashInLZ) {
+            if (lander.bCrashInLZ) {
                 // Crashed inside landing zone
                 string gameOver = "GAME OVER! Almost there!";
                 string crashMessage = "You crash-landed in the landing area!";
-                string impactForceMsg = "Impact Force: " + std::to_string(impactForce);
+                string impactForceMsg = "Impact Force: " + std::to_string(lander.impactForce);
 
                 float goWidth = gameOver.length() * charWidth;
                 float crashWidth = crashMessage.length() * charWidth;
@@ -549,7 +588,7 @@ void ofApp::draw() {
                 // Crashed outside the landing zone
                 string gameOver = "GAME OVER!";
                 string crashMessage = "You crashed!";
-                string impactForceMsg = "Impact Force: " + std::to_string(impactForce);
+                string impactForceMsg = "Impact Force: " + std::to_string(lander.impactForce);
 
                 float goWidth = gameOver.length() * charWidth;
                 float crashWidth = crashMessage.length() * charWidth;
@@ -575,7 +614,7 @@ void ofApp::draw() {
                 ofDrawBitmapString(impactForceMsg, impactX, impactY);
             }
         }
-        else if (noFuel) {
+        else if (lander.bNoFuel) {
             // Out of Fuel scenario
             string gameOver = "GAME OVER!";
             string fuelMessage = "Out of Fuel";
@@ -662,6 +701,12 @@ void ofApp::keyPressed(int key) {
         // Toggle fullscreen mode
         ofToggleFullscreen();
         break;
+    case 'g':
+    case 'G':
+        // Next integrator
+        setIntegrator((IntegratorType)((integrator + 1) % Integrator::NumTypes));
+        cout << "integrator: " << Integrator::name(integrator) << endl;
+        break;
     case 'h':
     case 'H':
         // Toggle GUI visibility
@@ -677,6 +722,16 @@ void ofApp::keyPressed(int key) {
         // Display octree
         bDisplayOctree = !bDisplayOctree;
         break;
+    case 'k':
+    case 'K':
+        // Run octree benchmarks (results printed to console); with the BVH
+        // or the compact octree only the octree / BVH comparison runs
+        if (terrainIndex == &octree) benchmarkOctree(octree, 10000);
+        else {
+            benchmarkSpatialIndexes(*terrainIndex, octree.levels, 10000);
+            benchmarkHeightField(*terrainIndex, 10000);
+        }
+        break;
     case 'r':
         // Reset the camera
         cam.reset();
@@ -689,67 +744,49 @@ void ofApp::keyPressed(int key) {
         // Movement and thrust controls
     case 'w':
     case 'W':
-        if (fuel > 0) {
-            if (!bThrust) startThrustTime = ofGetElapsedTimef();
-            emitter.sys->reset();
-            emitter.start();
-            bThrust = true;
-            force = float(thrust) * ofVec3f(0, 0, 1); // Forward
+        if (lander.fuel > 0) {
+            if (!lander.bThrust) startThrustTime = ofGetElapsedTimef();
+            lander.setThrust(float(thrust) * ofVec3f(0, 0, 1)); // Forward
             if (!thrustSound.isPlaying()) thrustSound.play();
         }
         break;
     case 's':
     case 'S':
-        if (fuel > 0) {
-            if (!bThrust) startThrustTime = ofGetElapsedTimef();
-            emitter.sys->reset();
-            emitter.start();
-            bThrust = true;
-            force = float(thrust) * ofVec3f(0, 0, -1); // Backward
+        if (lander.fuel > 0) {
+            if (!lander.bThrust) startThrustTime = ofGetElapsedTimef();
+            lander.setThrust(float(thrust) * ofVec3f(0, 0, -1)); // Backward
             if (!thrustSound.isPlaying()) thrustSound.play();
         }
         break;
     case 'a':
     case 'A':
-        if (fuel > 0) {
-            if (!bThrust) startThrustTime = ofGetElapsedTimef();
-            emitter.sys->reset();
-            emitter.start();
-            bThrust = true;
-            force = float(thrust) * ofVec3f(1, 0, 0); // Left
+        if (lander.fuel > 0) {
+            if (!lander.bThrust) startThrustTime = ofGetElapsedTimef();
+            lander.setThrust(float(thrust) * ofVec3f(1, 0, 0)); // Left
             if (!thrustSound.isPlaying()) thrustSound.play();
         }
         break;
     case 'd':
     case 'D':
-        if (fuel > 0) {
-            if (!bThrust) startThrustTime = ofGetElapsedTimef();
-            emitter.sys->reset();
-            emitter.start();
-            bThrust = true;
-            force = float(thrust) * ofVec3f(-1, 0, 0); // Right
+        if (lander.fuel > 0) {
+            if (!lander.bThrust) startThrustTime = ofGetElapsedTimef();
+            lander.setThrust(float(thrust) * ofVec3f(-1, 0, 0)); // Right
             if (!thrustSound.isPlaying()) thrustSound.play();
         }
         break;
     case 'q':
     case 'Q':
-        if (fuel > 0) {
-            if (!bThrust) startThrustTime = ofGetElapsedTimef();
-            emitter.sys->reset();
-            emitter.start();
-            bThrust = true;
-            force = float(thrust) * ofVec3f(0, 1, 0); // Up
+        if (lander.fuel > 0) {
+            if (!lander.bThrust) startThrustTime = ofGetElapsedTimef();
+            lander.setThrust(float(thrust) * ofVec3f(0, 1, 0)); // Up
             if (!thrustSound.isPlaying()) thrustSound.play();
         }
         break;
     case 'e':
     case 'E':
-        if (fuel > 0) {
-            if (!bThrust) startThrustTime = ofGetElapsedTimef();
-            emitter.sys->reset();
-            emitter.start();
-            bThrust = true;
-            force = float(thrust) * ofVec3f(0, -1, 0); // Down
+        if (lander.fuel > 0) {
+            if (!lander.bThrust) startThrustTime = ofGetElapsedTimef();
+            lander.setThrust(float(thrust) * ofVec3f(0, -1, 0)); // Down
             if (!thrustSound.isPlaying()) thrustSound.play();
         }
         break;
@@ -757,59 +794,36 @@ void ofApp::keyPressed(int key) {
         // Rotation controls
     case 'o':
     case 'O':
-        if (fuel > 0) {
+        if (lander.fuel > 0) {
             if (!thrustSound.isPlaying()) thrustSound.play();
-            bThrust = true;
-            angularForce += -10.0f; // Rotate clockwise
+            lander.bThrust = true;
+            lander.angularForce += -10.0f; // Rotate clockwise
         }
         break;
     case 'p':
     case 'P':
-        if (fuel > 0) {
-            if (!bThrust) startThrustTime = ofGetElapsedTimef();
+        if (lander.fuel > 0) {
+            if (!lander.bThrust) startThrustTime = ofGetElapsedTimef();
             if (!thrustSound.isPlaying()) thrustSound.play();
-            bThrust = true;
-            angularForce += 10.0f; // Rotate counter-clockwise
+            lander.bThrust = true;
+            lander.angularForce += 10.0f; // Rotate counter-clockwise
         }
         break;
     case ' ':
-        if (bOver) {
-            // Reset the game if it ended
-            bOver = false;
-            bWin = false;
-            noFuel = false;
-            bgrounded = false;
-            bThrust = false;
-
-            // Reset fuel and thrust
-            fuel = startFuel;
+        if (lander.bOver) {
+            // Reset the game if it ended:  rocket, fuel, physics and
+            // explosion
             startThrustTime = ofGetElapsedTimef();
-
-            // Reset rocket state
-            rocket.setPosition(0, 30, 0);
-            rocket.setRotation(0, 180.0, 0, 1, 0);
+            lander.reset(glm::vec3(0, 30, 0));
+            setRocketPose(lander.position, lander.rotation);
             rocket.update();
 
-            // Reset physics
-            velocity = glm::vec3(0, 0, 0);
-            acceleration = glm::vec3(0, 0, 0);
-            force = glm::vec3(0, 0, 0);
-
-            // Reset particles and sounds
-            explosion.stop();
-            explosion.sys->reset();
+            // Reset sounds
             crashSound.stop();
             winSound.stop();
 
             // Re-randomize landing zones
-            ofMesh terrainMesh = terrain.getMesh(0);
-            int totalVerts = terrainMesh.getNumVertices();
-            for (int i = 0; i < 3; i++) {
-                int randomIndex = (int)ofRandom(0, totalVerts);
-                glm::vec3 randomVertex = terrainMesh.getVertex(randomIndex);
-                landingZones[i].center = randomVertex;
-                landingZones[i].radius = 5.0;
-            }
+            placeLandingZones();
 
             // Start game again
             bStart = true;
@@ -825,6 +839,20 @@ void ofApp::keyPressed(int key) {
         // Toggle altitude display
         bDisplayAltitude = !bDisplayAltitude;
         break;
+    case 'i':
+    case 'I':
+        // Toggle spatial index stats display and per-query counters
+        terrainIndex->bCountQueries = !terrainIndex->bCountQueries;
+        terrainIndex->counters.reset();
+        frameCounters.reset();
+        if (terrainIndex->bCountQueries) indexStats = terrainIndex->getStats();
+        break;
+    case 'l':
+    case 'L':
+        // Add AI landers, or remove them
+        if (landers.size() > 0) landers.clear();
+        else spawnLanders();
+        break;
     case 't':
     case 'T':
         // Increase thrust
@@ -841,6 +869,13 @@ void ofApp::keyPressed(int key) {
     }
 }
 
+void ofApp::setIntegrator(IntegratorType type) {
+    integrator = type;
+    lander.settings.integrator = type;
+    emitter.sys->integrator = type;
+    explosion.sys->integrator = type;
+}
+
 void ofApp::toggleWireframeMode() {
     bWireframe = !bWireframe;
 }
@@ -861,38 +896,32 @@ void ofApp::keyReleased(int key) {
         // Stop thrust when keys are released
     case 'w':
     case 'W':
-        bThrust = false;
-        force = glm::vec3(0, 0, 0);
+        lander.setThrust(glm::vec3(0, 0, 0));
         thrustSound.stop();
         break;
     case 's':
     case 'S':
-        bThrust = false;
-        force = glm::vec3(0, 0, 0);
+        lander.setThrust(glm::vec3(0, 0, 0));
         thrustSound.stop();
         break;
     case 'a':
     case 'A':
-        bThrust = false;
-        force = glm::vec3(0, 0, 0);
+        lander.setThrust(glm::vec3(0, 0, 0));
         thrustSound.stop();
         break;
     case 'd':
     case 'D':
-        bThrust = false;
-        force = glm::vec3(0, 0, 0);
+        lander.setThrust(glm::vec3(0, 0, 0));
         thrustSound.stop();
         break;
     case 'q':
     case 'Q':
-        bThrust = false;
-        force = glm::vec3(0, 0, 0);
+        lander.setThrust(glm::vec3(0, 0, 0));
         thrustSound.stop();
         break;
     case 'e':
     case 'E':
-        bThrust = false;
-        force = glm::vec3(0, 0, 0);
+        lander.setThrust(glm::vec3(0, 0, 0));
         thrustSound.stop();
         break;
 
@@ -904,14 +933,14 @@ void ofApp::keyReleased(int key) {
     case 'o':
     case 'O':
         thrustSound.stop();
-        bThrust = false;
-        angularForce = 0;
+        lander.bThrust = false;
+        lander.angularForce = 0;
         break;
     case 'p':
     case 'P':
-        bThrust = false;
+        lander.bThrust = false;
         thrustSound.stop();
-        angularForce = 0;
+        lander.angularForce = 0;
         break;
     default:
         break;
@@ -933,12 +962,13 @@ void ofApp::mousePressed(int x, int y, int button) {
         glm::vec3 origin = cam.getPosition();
         glm::vec3 mouseWorld = cam.screenToWorld(glm::vec3(mouseX, mouseY, 0));
         glm::vec3 mouseDir = glm::normalize(mouseWorld - origin);
+        Ray ray(Vector3(origin.x, origin.y, origin.z), Vector3(mouseDir.x, mouseDir.y, mouseDir.z));
 
-        ofVec3f min = rocket.getSceneMin() + rocket.getPosition();
-        ofVec3f max = rocket.getSceneMax() + rocket.getPosition();
-
-        Box bounds = Box(Vector3(min.x, min.y, min.z), Vector3(max.x, max.y, max.z));
-        bool hit = bounds.intersect(Ray(Vector3(origin.x, origin.y, origin.z), Vector3(mouseDir.x, mouseDir.y, mouseDir.z)), 0, 10000);
+        // The rocket is selected if it is the nearest object along the ray
+        // and is not behind the terrain
+        RayHit objectHit, terrainHit;
+        bool hit = objects.intersect(ray, objectHit) && objectHit.index == rocketId &&
+            !(terrainIndex->intersect(ray, terrainHit) && terrainHit.t < objectHit.t);
         if (hit) {
             bRocketSelected = true;
             mouseDownPos = getMousePointOnPlane(rocket.getPosition(), cam.getZAxis());
@@ -967,10 +997,10 @@ bool ofApp::raySelectWithOctree(ofVec3f& pointRet) {
         Vector3(rayDir.x, rayDir.y, rayDir.z));
 
     // Check intersection with octree
-    pointSelected = octree.intersect(ray, octree.root, selectedNode);
+    pointSelected = terrainIndex->intersect(ray, selectedHit);
 
     if (pointSelected) {
-        pointRet = octree.mesh.getVertex(selectedNode.points[0]);
+        pointRet = selectedHit.point;
         cout << "POINT RET:" << pointRet << endl;
     }
     return pointSelected;
@@ -989,17 +1019,15 @@ void ofApp::mouseDragged(int x, int y, int button) {
 
         rocketPos += delta;
         rocket.setPosition(rocketPos.x, rocketPos.y, rocketPos.z);
-        rocket.setRotation(0, rotation, 0, 1, 0);
+        rocket.setRotation(0, lander.rotation, 0, 1, 0);
         mouseLastPos = mousePos;
 
-        ofVec3f min = rocket.getSceneMin() + rocket.getPosition();
-        ofVec3f max = rocket.getSceneMax() + rocket.getPosition();
-
-        Box rocketBounds = Box(Vector3(min.x, min.y, min.z), Vector3(max.x, max.y, max.z));
+        Box rocketBounds = getRocketBounds();
+        objects.move(rocketId, rocketBounds);
 
         colBoxList.clear();
 
-        octree.intersect(rocketBounds, octree.root, colBoxList);
+        terrainIndex->intersect(rocketBounds, colBoxList);
 
         if (rocketBounds.overlap(testBox)) {
             cout << "overlap" << endl;
@@ -1066,6 +1094,7 @@ void ofApp::dragEvent2(ofDragInfo dragInfo) {
         for (int i = 0; i < rocket.getMeshCount(); i++) {
             bboxList.push_back(Octree::meshBounds(rocket.getMesh(i)));
         }
+        createRocketCollider();
 
         cout << "Mesh Count: " << rocket.getMeshCount() << endl;
     }
@@ -1092,6 +1121,7 @@ void ofApp::dragEvent(ofDragInfo dragInfo) {
         for (int i = 0; i < rocket.getMeshCount(); i++) {
             bboxList.push_back(Octree::meshBounds(rocket.getMesh(i)));
         }
+        createRocketCollider();
 
         glm::vec3 origin = cam.getPosition();
         glm::vec3 camAxis = cam.getZAxis();
@@ -1131,95 +1161,62 @@ glm::vec3 ofApp::getMousePointOnPlane(glm::vec3 planePt, glm::vec3 planeNorm) {
     else return glm::vec3(0, 0, 0);
 }
 
-// Check collisions between rocket and terrain or landing zones
-//Pierce Kyaw, Aye Thwe Tun
-void ofApp::checkCollisions() {
-    ofVec3f min = rocket.getSceneMin() + rocket.getPosition();
-    ofVec3f max = rocket.getSceneMax() + rocket.getPosition();
-    Box rocketBounds = Box(Vector3(min.x, min.y, min.z), Vector3(max.x, max.y, max.z));
-
-    colBoxList.clear();
-
-    if (octree.intersect(rocketBounds, octree.root, colBoxList)) {
-        // Check if rocket is within any landing zone
-        bool inAnyLandingZone = false;
-        for (int i = 0; i < 3; i++) {
-            float distanceToLandingZone = glm::distance(rocket.getPosition(), landingZones[i].center);
-            if (distanceToLandingZone < landingZones[i].radius) {
-                inAnyLandingZone = true;
-                break;
-            }
-        }
+// World space bounding box of the rocket
+Box ofApp::getRocketBounds() {
+    return lander.boundsAt(rocket.getPosition(), lander.rotation);
+}
 
-        float verticalSpeed = velocity.y;
-        float landingSpeedThreshold = 8.0f; // Speed threshold
-        bool gentleVerticalSpeed = fabs(verticalSpeed) < landingSpeedThreshold;
-
-        if (inAnyLandingZone) {
-            // Rocket inside landing zone
-            if (gentleVerticalSpeed && verticalSpeed <= 0) {
-                // Gentle landing = success
-                bgrounded = true;
-                bWin = true;
-                bOver = true;
-                winSound.play();
-
-                // Stop movement
-                velocity = glm::vec3(0);
-                acceleration = glm::vec3(0);
-                force = glm::vec3(0);
-
-                // Add score
-                score += 500;
-            }
-            else {
-                // Crash landing inside LZ
-                explosion.sys->reset();
-                explosion.start();
-                bgrounded = true;
-                bOver = true;
-                velocity = glm::vec3(0);
-                acceleration = glm::vec3(0);
-                force = glm::vec3(0);
-                bCrashInLZ = true;
-                impactForce = (int)(fabs(verticalSpeed));
-
-                score += 250;
-
-                crashSound.play();
-            }
-        }
-        else {
-            // Rocket outside landing zone
-            if (gentleVerticalSpeed) {
-                // Hover scenario: Apply upward force to avoid penetrating terrain
-                Ray downwardRay(Vector3(rocket.getPosition().x, rocket.getPosition().y, rocket.getPosition().z),
-                    Vector3(0, -1, 0));
-                TreeNode groundNode;
-                if (octree.intersect(downwardRay, octree.root, groundNode)) {
-                    glm::vec3 groundPoint = octree.mesh.getVertex(groundNode.points[0]);
-                    force = glm::vec3(0, 10, 0);
-                }
-            }
-            else {
-                // High-speed impact outside LZ = crash
-                explosion.sys->reset();
-                explosion.start();
-                bgrounded = true;
-                bOver = true;
-                bCrashInLZ = false;
-                impactForce = (int)(fabs(verticalSpeed));
-
-                velocity = glm::vec3(0);
-                acceleration = glm::vec3(0);
-                force = glm::vec3(0);
-
-                crashSound.play();
-            }
-        }
+// Add numLanders AI landers above the terrain around the landing zones,
+// each flying to one of them at its own descent speed
+void ofApp::spawnLanders() {
+    landers.clear();
+    landers.terrain = terrainIndex;
+    landers.heightField = &heightField;
+    landers.landingZones = lander.landingZones;
+    landers.localBounds = lander.localBounds;
+    landers.settings = lander.settings;
+    if (landers.landingZones.empty()) return;
+
+    for (int i = 0; i < numLanders; i++) {
+        int zone = (int)ofRandom(0, landers.landingZones.size()) % landers.landingZones.size();
+        glm::vec3 p = landers.landingZones[zone].center;
+        p.x += ofRandom(-40, 40);
+        p.z += ofRandom(-40, 40);
+        GroundHit ground;
+        float groundY = heightField.groundAt(p.x, p.z, ground) ? ground.point.y : p.y;
+        p.y = groundY + ofRandom(15, 60);
+        landers.add(p, zone, ofRandom(1, 12));
     }
 }
 
+// Draw the AI landers as points:  white flying, green landed, red crashed,
+// gray out of fuel
+void ofApp::drawLanders() {
+    static const ofFloatColor stateColors[4] = { ofFloatColor(1, 1, 1), ofFloatColor(0, 1, 0),
+        ofFloatColor(1, 0, 0), ofFloatColor(0.5, 0.5, 0.5) };
+    landerPoints.clear();
+    landerPoints.setMode(OF_PRIMITIVE_POINTS);
+    for (int i = 0; i < landers.size(); i++) {
+        landerPoints.addVertex(landers.position(i));
+        landerPoints.addColor(stateColors[landers.state[i]]);
+    }
+    glPointSize(4);
+    landerPoints.draw();
+}
+
+// Build the rocket's collision hierarchy from its meshes, once per model
+void ofApp::createRocketCollider() {
+    vector<ofMesh> meshes;
+    for (int i = 0; i < rocket.getMeshCount(); i++) {
+        meshes.push_back(rocket.getMesh(i));
+    }
+    uint64_t t1 = ofGetElapsedTimeMicros();
+    rocketCollider.create(meshes);
+    uint64_t t2 = ofGetElapsedTimeMicros();
+    cout << "Rocket collider: " << rocketCollider.bvh.getNumFaces() << " faces in "
+        << (t2 - t1) / 1000.0 << " ms" << endl;
+}
+
 // Draw overlay text (fuel, altitude, fps, score)
 //Pierce Kyaw, Aye Thwe Tun
 void ofApp::drawText()
@@ -1237,8 +1234,8 @@ void ofApp::drawText()
 
     int framerate = ofGetFrameRate();
     string fpsText = "Frame Rate: " + std::to_string(framerate);
-    string timerText = "Fuel Remaining: " + std::to_string(fuel) + " seconds";
-    string scoreText = "Score: " + std::to_string(score);
+    string timerText = "Fuel Remaining: " + std::to_string(lander.fuel) + " seconds";
+    string scoreText = "Score: " + std::to_string(lander.score);
 
     if (bDisplayAltitude) {
         string altitudeMsg = "Altitude: " + std::to_string(altitude);
@@ -1249,6 +1246,26 @@ void ofApp::drawText()
     ofDrawBitmapString(timerText, xPos - timerText.size() * 8, yPos); yPos += lineHeight;
     ofDrawBitmapString(fpsText, xPos - fpsText.size() * 8, yPos); yPos += lineHeight;
     ofDrawBitmapString(scoreText, xPos - scoreText.size() * 8, yPos);
+
+    // Spatial index stats and the query counters of the last frame
+    if (terrainIndex->bCountQueries) {
+        vector<string> lines;
+        string name = terrainIndex->name();
+        lines.push_back(name + ": " + std::to_string(indexStats.numNodes) + " nodes, " +
+            std::to_string(indexStats.numLeaves) + " leaves, depth " +
+            std::to_string((int)indexStats.nodesAtDepth.size() - 1));
+        lines.push_back(name + " memory: " + std::to_string(indexStats.totalBytes() / 1024) + " KB, build " +
+            std::to_string((int)indexStats.buildMillis) + " ms");
+        lines.push_back("Queries/frame: " + std::to_string(frameCounters.queries));
+        lines.push_back("Nodes visited: " + std::to_string(frameCounters.nodesVisited));
+        lines.push_back("Boxes tested: " + std::to_string(frameCounters.boxesTested));
+        lines.push_back("Leaves: " + std::to_string(frameCounters.leavesReached) +
+            "  Primitives: " + std::to_string(frameCounters.primitivesTested));
+        for (int i = 0; i < lines.size(); i++) {
+            yPos += lineHeight;
+            ofDrawBitmapString(lines[i], xPos - lines[i].size() * 8, yPos);
+        }
+    }
 }
 
 // Initialize lighting and materials for the scene
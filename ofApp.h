@@ -4,8 +4,16 @@
 #include "ofxGui.h"
 #include  "ofxAssimpModelLoader.h"
 #include "Octree.h"
+#include "BVH.h"
+#include "CompactOctree.h"
+#include "PagedOctree.h"
+#include "TerrainPack.h"
+#include "HeightField.h"
+#include "DynamicOctree.h"
 #include "Particle.h"
 #include "ParticleEmitter.h"
+#include "LanderSim.h"
+#include "LanderPool.h"
 
 class ofApp : public ofBaseApp {
 
@@ -35,28 +43,26 @@ public:
 	void initLightingAndMaterials();
 	bool mouseIntersectPlane(ofVec3f planePoint, ofVec3f planeNorm, ofVec3f& point);
 	bool raySelectWithOctree(ofVec3f& pointRet);
+	void placeLandingZones();
+	Box getRocketBounds();
 	glm::vec3 ofApp::getMousePointOnPlane(glm::vec3 p, glm::vec3 n);
 
 	ofEasyCam cam;
 	ofCamera bottomCam, TopDownCam, trackingCam, topCam, * currentCam;
 
 
-	float rotation = 0.0;
-	glm::vec3 velocity = glm::vec3(0, 0, 0);
-	glm::vec3 acceleration = glm::vec3(0, 0, 0);
-	glm::vec3 force = glm::vec3(0, 0, 0);
-	glm::vec3 gravitationalForce;
-	float terrainGravity = 1.62;
-	float mass = 1.0;
-	float damping = .99;
+	LanderSim lander;           // the rocket's physics; rocket is its model
+	RocketCollider rocketCollider;  // rocket's meshes, for exact contacts
+	void createRocketCollider();
 
-	float angularForce = 0;
-	float angularVelocity = 0.0;
-	float angularAcceleration = 0.0;
-	bool bThrust = false;
+	// AI landers flown beside the rocket ('l' to add or remove them)
+	LanderPool landers;
+	int numLanders = 1000;
+	void spawnLanders();
+	void drawLanders();
+	ofVboMesh landerPoints;
 
 	bool bStart = false;
-	bool bOver = false;
 
 	ofxAssimpModelLoader terrain, rocket;
 
@@ -66,8 +72,21 @@ public:
 	Box testBox;
 	vector<Box> colBoxList;
 	bool bRocketSelected = false;
+	SpatialIndexType indexType = OctreeIndex;   // set before setup() (main.cpp)
+	TerrainPack terrainPack;     // must outlive octree, which may point into it
 	Octree octree;
-	TreeNode selectedNode;
+	BVH bvh;
+	CompactOctree compactOctree;
+	SpatialIndex* terrainIndex = &octree;   // the one of the three that is built
+	PagedOctree pagedTerrain;               // terrain collisions from disk pages
+	bool bPagedTerrain = false;             // set before setup() (main.cpp)
+	size_t pagedBudget = 64 << 20;          // bytes of pages kept in memory
+	HeightField heightField;                // ground lookups, falls back to terrainIndex
+	DynamicOctree objects;                  // moving objects, by id
+	const int rocketId = 0;
+	IndexStats indexStats;              // taken when stats display is turned on
+	QueryCounters frameCounters;    // spatial index queries of the last frame
+	RayHit selectedHit;
 	glm::vec3 mouseDownPos, mouseLastPos;
 	bool bInDrag = false;
 
@@ -83,17 +102,12 @@ public:
 	bool bDisplayLeafNodes = false;
 	bool bDisplayOctree = false;
 	bool bDisplayBBoxes = false;
-	bool bgrounded = false;
 	bool bRocketLoaded;
-	bool bWin = false;
 	bool bTerrainSelected;
 	bool bWinSoundPlayed = false;
 	bool bCrashSoundPlayed = false;
 	bool bNoFuelSoundPlayed = false;
-	float startFuel;
 	float startThrustTime;
-	float totalThrustTime;
-	float maxThrustTime;
 
 	float distanceToGround = 0.0;
 	float altitude = 0.0;
@@ -120,51 +134,41 @@ public:
 	ofxFloatSlider thrust, camDist, camNearClip, camSetFOV;
 
 
-	glm::vec3 rocketPosition;
-
 	bool rotateX = false;
 	bool rotateY = false;
 	bool rotateZ = false;
-	void ofApp::integrate() {
-		float framerate = 60;
-		float dt = 1.0 / framerate;
-		rocketPosition = rocket.getPosition();
-
-
-		rocketPosition += velocity * dt;
-
-
-		glm::vec3 accel = acceleration;
-		accel += ((force * 1.0) + gravitationalForce / mass);
-		velocity += accel * dt;
-		velocity *= damping;
-
-		rotation += (angularVelocity * dt);
-
-		rocket.setRotation(0, rotation, 0, 1, 0);
-		float a = angularAcceleration;
-		a += (angularForce / mass);
-		angularVelocity += a * dt;
-		angularVelocity *= damping;
 
-		rocket.setPosition(rocketPosition.x, rocketPosition.y, rocketPosition.z);
-	}
+	// Fixed timestep simulation.  update() runs lander.step() at simRate
+	// steps per second of real time, whatever the frame rate:  several steps
+	// in a slow frame, none in a fast one.  Time left over (less than a step)
+	// carries to the next frame.  If a frame would need more than
+	// maxStepsPerFrame steps, the rest of its time is dropped and the
+	// simulation runs slow rather than falling further behind.
+	//
+	// The rocket is drawn between its last two simulated poses, so it moves
+	// smoothly when the frame rate is not a multiple of simRate.
+	//
+	void setRocketPose(const glm::vec3& position, float angle);
+	float simRate = 60;                     // set before setup() (main.cpp)
+	int maxStepsPerFrame = 8;
+
+	// integrator for the rocket and its particles (Integrator.h), set before
+	// setup() (main.cpp) or stepped through with 'g'
+	//
+	void setIntegrator(IntegratorType type);
+	IntegratorType integrator = ExplicitEulerIntegrator;
+	double simAccumulator = 0;              // sec of real time not yet simulated
+	glm::vec3 prevRocketPosition;           // pose before the last step
+	float prevRotation = 0;
+	glm::vec3 simRocketPosition;            // where the last step left the rocket
+	glm::vec3 renderPosition;               // interpolated pose for drawing
+	float renderRotation = 0;
 
-	void checkCollisions();
 	void drawText();
 
-	int impactForce = 0;
-
-	int fuel = 0;
-	bool noFuel = false;
-
 	ParticleEmitter emitter;
 	ParticleEmitter explosion;
 
-	TurbulenceForce* tForce;
-	GravityForce* gForce;
-	ImpulseRadialForce* iForce;
-
 	ofLight keyLight, rimLight, fillLight, dynamicLight;
 	vector<ofLight*> Lights;
 
@@ -185,16 +189,6 @@ public:
 	ofSpherePrimitive sphere;
 	ofTexture spaceTexture;
 
-	struct LandingZone {
-		glm::vec3 center;
-		float radius;
-	};
-
-	LandingZone landingZones[3];
-	bool bCrashInLZ = false;
-
-	int score;
-
 	bool bDisplayAltitude = true;
 
 };
\ No newline at end of file
@@ -20,21 +20,14 @@ class Ray {
       origin = o;
       direction = d;
       inv_direction = Vector3(1/d.x(), 1/d.y(), 1/d.z());
-      sign[0] = (inv_direction.x() < 0);
-      sign[1] = (inv_direction.y() < 0);
-      sign[2] = (inv_direction.z() < 0);
-    }
-    Ray(const Ray &r) {
-      origin = r.origin;
-      direction = r.direction;
-      inv_direction = r.inv_direction;
-      sign[0] = r.sign[0]; sign[1] = r.sign[1]; sign[2] = r.sign[2];
     }
 
+    // 1 if the direction is negative along axis i
+    int sign(int i) const { return inv_direction[i] < 0; }
+
     Vector3 origin;
     Vector3 direction;
     Vector3 inv_direction;
-    int sign[3];
 };
 
 #endif // _RAY_H_
@@ -0,0 +1,196 @@
+#ifndef _SIMD_H_
+#define _SIMD_H_
+
+#include "vector3.h"
+#include "ray.h"
+
+/*
+ * Ray/box and box/box kernels used by Box and the Octree.  With SSE2
+ * (every x64 compiler) they are branchless SSE; otherwise the scalar
+ * versions are used.  The scalar versions are always compiled so they
+ * can be benchmarked against the SSE ones.
+ *
+ * The slab test is the one from:
+ *
+ *      Amy Williams, Steve Barrus, R. Keith Morley, and Peter Shirley
+ *      "An Efficient and Robust Ray-Box Intersection Algorithm"
+ *      Journal of graphics tools, 10(1):49-54, 2005
+ *
+ * computed with min/max instead of the ray's sign.  An axis whose slab
+ * distance is NaN (0 * inf:  a ray parallel to and exactly on a box face)
+ * is ignored, so a ray lying on a face hits the box.
+ */
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE 1
+#include <emmintrin.h>
+#endif
+
+// ray against box [min, max].  (t0, t1) is the interval for valid hits;
+// tEnter is where the ray enters the box, clamped to t0.
+//
+inline bool slabTestScalar(const Ray& r, const Vector3& min, const Vector3& max,
+                           float t0, float t1, float& tEnter) {
+  const Vector3* parameters[2] = { &min, &max };
+  float tmin = t0, tmax = t1;
+  for (int i = 0; i < 3; i++) {
+    int s = r.sign(i);
+    float lo = ((*parameters[s])[i] - r.origin[i]) * r.inv_direction[i];
+    float hi = ((*parameters[1 - s])[i] - r.origin[i]) * r.inv_direction[i];
+    if (lo > tmin) tmin = lo;
+    if (hi < tmax) tmax = hi;
+  }
+  tEnter = tmin;
+  return tmin <= tmax && tmin < t1 && tmax > t0;
+}
+
+inline bool overlapTestScalar(const Vector3& aMin, const Vector3& aMax,
+                              const Vector3& bMin, const Vector3& bMax) {
+  return aMax.x() >= bMin.x() && aMin.x() <= bMax.x() &&
+         aMax.y() >= bMin.y() && aMin.y() <= bMax.y() &&
+         aMax.z() >= bMin.z() && aMin.z() <= bMax.z();
+}
+
+inline bool insideTestScalar(const Vector3& min, const Vector3& max, const Vector3& p) {
+  return p.x() >= min.x() && p.x() <= max.x() &&
+         p.y() >= min.y() && p.y() <= max.y() &&
+         p.z() >= min.z() && p.z() <= max.z();
+}
+
+/*
+ * Up to 8 boxes in structure of arrays form, for testing one ray against
+ * all children of an octree node at once.
+ */
+
+class Box8 {
+  public:
+    void set(int i, const Vector3& min, const Vector3& max) {
+      minX[i] = min.x(); minY[i] = min.y(); minZ[i] = min.z();
+      maxX[i] = max.x(); maxY[i] = max.y(); maxZ[i] = max.z();
+    }
+
+    alignas(16) float minX[8];
+    alignas(16) float minY[8];
+    alignas(16) float minZ[8];
+    alignas(16) float maxX[8];
+    alignas(16) float maxY[8];
+    alignas(16) float maxZ[8];
+};
+
+// ray against the first "count" boxes.  Returns a mask with bit i set if
+// box i is hit, and its entry distance in tEnterRtn[i].
+//
+inline unsigned int slabTest8Scalar(const Ray& r, const Box8& b, int count,
+                                    float t0, float t1, float tEnterRtn[8]) {
+  unsigned int mask = 0;
+  for (int i = 0; i < count; i++) {
+    Vector3 min(b.minX[i], b.minY[i], b.minZ[i]);
+    Vector3 max(b.maxX[i], b.maxY[i], b.maxZ[i]);
+    if (slabTestScalar(r, min, max, t0, t1, tEnterRtn[i])) mask |= 1u << i;
+  }
+  return mask;
+}
+
+#ifdef SIMD_SSE
+
+// the slab [lo, hi] of each lane from the distances a, b to its two
+// planes.  min/max return the second operand when either is NaN, so a lane
+// with a NaN distance is set to (-inf, inf) to ignore it like the scalar
+// test does.
+//
+inline void slabSSE(__m128 a, __m128 b, __m128& lo, __m128& hi) {
+  __m128 nan = _mm_cmpunord_ps(a, b);
+  __m128 inf = _mm_set1_ps(INFINITY);
+  lo = _mm_or_ps(_mm_andnot_ps(nan, _mm_min_ps(a, b)), _mm_and_ps(nan, _mm_sub_ps(_mm_setzero_ps(), inf)));
+  hi = _mm_or_ps(_mm_andnot_ps(nan, _mm_max_ps(a, b)), _mm_and_ps(nan, inf));
+}
+
+inline bool slabTest(const Ray& r, const Vector3& min, const Vector3& max,
+                     float t0, float t1, float& tEnter) {
+  __m128 o = _mm_load_ps(r.origin.data());
+  __m128 inv = _mm_load_ps(r.inv_direction.data());
+  __m128 a = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(min.data()), o), inv);
+  __m128 b = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(max.data()), o), inv);
+  __m128 lo, hi;
+  slabSSE(a, b, lo, hi);
+
+  // reduce x, y, z (not the padding lane)
+  __m128 tmin = _mm_max_ss(lo, _mm_set_ss(t0));
+  tmin = _mm_max_ss(_mm_shuffle_ps(lo, lo, _MM_SHUFFLE(1, 1, 1, 1)), tmin);
+  tmin = _mm_max_ss(_mm_shuffle_ps(lo, lo, _MM_SHUFFLE(2, 2, 2, 2)), tmin);
+  __m128 tmax = _mm_min_ss(hi, _mm_set_ss(t1));
+  tmax = _mm_min_ss(_mm_shuffle_ps(hi, hi, _MM_SHUFFLE(1, 1, 1, 1)), tmax);
+  tmax = _mm_min_ss(_mm_shuffle_ps(hi, hi, _MM_SHUFFLE(2, 2, 2, 2)), tmax);
+
+  tEnter = _mm_cvtss_f32(tmin);
+  return _mm_comile_ss(tmin, tmax) & _mm_comilt_ss(tmin, _mm_set_ss(t1)) &
+         _mm_comigt_ss(tmax, _mm_set_ss(t0));
+}
+
+inline bool overlapTest(const Vector3& aMin, const Vector3& aMax,
+                        const Vector3& bMin, const Vector3& bMax) {
+  __m128 c = _mm_and_ps(_mm_cmpge_ps(_mm_load_ps(aMax.data()), _mm_load_ps(bMin.data())),
+                        _mm_cmple_ps(_mm_load_ps(aMin.data()), _mm_load_ps(bMax.data())));
+  return (_mm_movemask_ps(c) & 7) == 7;
+}
+
+inline bool insideTest(const Vector3& min, const Vector3& max, const Vector3& p) {
+  __m128 v = _mm_load_ps(p.data());
+  __m128 c = _mm_and_ps(_mm_cmpge_ps(v, _mm_load_ps(min.data())),
+                        _mm_cmple_ps(v, _mm_load_ps(max.data())));
+  return (_mm_movemask_ps(c) & 7) == 7;
+}
+
+inline unsigned int slabTest8(const Ray& r, const Box8& b, int count,
+                              float t0, float t1, float tEnterRtn[8]) {
+  __m128 ox = _mm_set1_ps(r.origin.x()), oy = _mm_set1_ps(r.origin.y()), oz = _mm_set1_ps(r.origin.z());
+  __m128 ix = _mm_set1_ps(r.inv_direction.x());
+  __m128 iy = _mm_set1_ps(r.inv_direction.y());
+  __m128 iz = _mm_set1_ps(r.inv_direction.z());
+  __m128 vt0 = _mm_set1_ps(t0), vt1 = _mm_set1_ps(t1);
+  unsigned int mask = 0;
+  for (int i = 0; i < count; i += 4) {
+    __m128 x0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(b.minX + i), ox), ix);
+    __m128 x1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(b.maxX + i), ox), ix);
+    __m128 y0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(b.minY + i), oy), iy);
+    __m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(b.maxY + i), oy), iy);
+    __m128 z0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(b.minZ + i), oz), iz);
+    __m128 z1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(b.maxZ + i), oz), iz);
+    __m128 xlo, xhi, ylo, yhi, zlo, zhi;
+    slabSSE(x0, x1, xlo, xhi);
+    slabSSE(y0, y1, ylo, yhi);
+    slabSSE(z0, z1, zlo, zhi);
+    __m128 tmin = _mm_max_ps(_mm_max_ps(xlo, ylo), _mm_max_ps(zlo, vt0));
+    __m128 tmax = _mm_min_ps(_mm_min_ps(xhi, yhi), _mm_min_ps(zhi, vt1));
+    __m128 hit = _mm_and_ps(_mm_cmple_ps(tmin, tmax),
+                            _mm_and_ps(_mm_cmplt_ps(tmin, vt1), _mm_cmpgt_ps(tmax, vt0)));
+    _mm_storeu_ps(tEnterRtn + i, tmin);
+    mask |= _mm_movemask_ps(hit) << i;
+  }
+  return mask & ((1u << count) - 1);
+}
+
+#else
+
+inline bool slabTest(const Ray& r, const Vector3& min, const Vector3& max,
+                     float t0, float t1, float& tEnter) {
+  return slabTestScalar(r, min, max, t0, t1, tEnter);
+}
+
+inline bool overlapTest(const Vector3& aMin, const Vector3& aMax,
+                        const Vector3& bMin, const Vector3& bMax) {
+  return overlapTestScalar(aMin, aMax, bMin, bMax);
+}
+
+inline bool insideTest(const Vector3& min, const Vector3& max, const Vector3& p) {
+  return insideTestScalar(min, max, p);
+}
+
+inline unsigned int slabTest8(const Ray& r, const Box8& b, int count,
+                              float t0, float t1, float tEnterRtn[8]) {
+  return slabTest8Scalar(r, b, count, t0, t1, tEnterRtn);
+}
+
+#endif
+
+#endif // _SIMD_H_
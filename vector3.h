@@ -3,18 +3,22 @@
 
 #include <math.h>
 
-class Vector3 {
+/*
+ * 16 byte aligned and trivially copyable, so a Vector3 can be loaded into
+ * one SSE register (see simd.h).  The 4th float is padding and is kept 0.
+ */
+
+class alignas(16) Vector3 {
   public:
-    Vector3() { };
-    Vector3(float x, float y, float z) { d[0] = x; d[1] = y; d[2] = z; }
-    Vector3(const Vector3 &v)
-      { d[0] = v.d[0]; d[1] = v.d[1]; d[2] = v.d[2]; }
+    Vector3() { d[3] = 0; };
+    Vector3(float x, float y, float z) { d[0] = x; d[1] = y; d[2] = z; d[3] = 0; }
 
     float x() const { return d[0]; }
     float y() const { return d[1]; }
     float z() const { return d[2]; }
 
     float operator[](int i) const { return d[i]; }
+    const float* data() const { return d; }
     
     float length() const
       { return sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]); }
@@ -74,7 +78,7 @@ class Vector3 {
     }
   
   private:
-    float d[3];
+    float d[4];
 };
 
 #endif // _VECTOR3_H_